@@ -16,6 +16,7 @@
 
 #include "MidiEventList.h"
 
+#include <cstddef>
 #include <fstream>
 #include <istream>
 #include <string>
@@ -41,6 +42,124 @@ class _TickTime {
 };
 
 
+// SmfData == The bytes of a file, memory-mapped when the system allows
+// it, otherwise read into a buffer.  Read-only and not copyable.
+class SmfData {
+	public:
+		               SmfData                     (void);
+		              ~SmfData                     ();
+
+		bool           open                        (const std::string& filename);
+		void           close                       (void);
+		const uchar*   data                        (void) const;
+		size_t         size                        (void) const;
+
+	private:
+		               SmfData                     (const SmfData& other);
+		SmfData&       operator=                   (const SmfData& other);
+
+		const uchar*       m_data    = NULL;
+		size_t             m_size    = 0;
+		bool               m_mapped  = false;
+		std::vector<uchar> m_buffer;          // used when mapping fails
+};
+
+
+// SmfEvent == One event of a Standard MIDI File in memory, as delivered
+// by SmfEventReader.  The message is the command byte followed by the
+// size bytes at data, which point into the file: the same bytes that
+// MidiFile::readSmf() would store in a MidiEvent.
+class SmfEvent {
+	public:
+		int          tick    = 0;     // absolute ticks from the track start
+		int          track   = 0;
+		uchar        command = 0;     // status byte, running status resolved
+		const uchar* data    = NULL;
+		size_t       size    = 0;
+
+		int          getChannel          (void) const;
+		int          getP1               (void) const;
+		int          getP2               (void) const;
+		bool         isNoteOn            (void) const;
+		bool         isNoteOff           (void) const;
+		bool         isController        (void) const;
+		bool         isMeta              (void) const;
+		int          getMetaType         (void) const;
+		bool         isEndOfTrack        (void) const;
+};
+
+
+class SmfEventReader;
+
+class SmfEventIterator {
+	public:
+		                  SmfEventIterator (SmfEventReader* reader = NULL);
+		const SmfEvent&   operator*        (void) const { return m_event; }
+		const SmfEvent*   operator->       (void) const { return &m_event; }
+		SmfEventIterator& operator++       (void);
+		bool              operator==       (const SmfEventIterator& other) const;
+		bool              operator!=       (const SmfEventIterator& other) const;
+
+	private:
+		SmfEventReader* m_reader;
+		SmfEvent        m_event;
+};
+
+
+// SmfEventReader == Pull parser over a Standard MIDI File in memory.  It
+// delivers the events of each track in turn, in file order, without
+// allocating anything; running status and meta/sysex lengths are read as
+// MidiFile::readSmf() reads them.  The data must stay valid while reading.
+class SmfEventReader {
+	public:
+		                 SmfEventReader         (void);
+		                 SmfEventReader         (const uchar* data, size_t size);
+
+		bool             open                   (const uchar* data, size_t size);
+		bool             next                   (SmfEvent& event);
+		SmfEventIterator begin                  (void);
+		SmfEventIterator end                    (void);
+
+		bool             status                 (void) const;
+		const char*      getError               (void) const;
+		size_t           getErrorOffset         (void) const;
+		int              getFormat              (void) const;
+		int              getTrackCount          (void) const;
+		int              getTicksPerQuarterNote (void) const;
+
+	private:
+		bool             fail                   (const char* error, const uchar* p);
+
+		const uchar* m_data   = NULL;
+		const uchar* m_end    = NULL;
+		const uchar* m_pos    = NULL;
+		int          m_format = 0;
+		int          m_tracks = 0;
+		int          m_tpq    = 0;
+		int          m_track  = 0;      // track being read
+		bool         m_intrack = false; // past the MTrk header of m_track
+		int          m_tick   = 0;
+		uchar        m_runningCommand = 0;
+		bool         m_done   = true;
+		const char*  m_error  = NULL;
+		size_t       m_erroroffset = 0;
+};
+
+
+// SmfCheck == Result of MidiFile::validateSmf(): the first structural
+// problem found in the data, if any.
+class SmfCheck {
+	public:
+		const char* reason = NULL;    // NULL if the data is valid
+		size_t      offset = 0;       // byte offset of the problem
+		int         track  = -1;      // track of the problem, -1 for the header
+		int         tracks = 0;       // tracks declared in the header
+		long        events = 0;       // messages checked, end-of-tracks included
+
+		bool        valid  (void) const { return reason == NULL; }
+};
+
+
 class MidiFile {
 	public:
 		               MidiFile                    (void);
@@ -65,6 +184,15 @@ class MidiFile {
 		// Only allow Standard MIDI File input:
 		bool           readSmf                     (const std::string& filename);
 		bool           readSmf                     (std::istream& instream);
+		bool           readSmf                     (const uchar* data, size_t size);
+
+		// Check the chunk and message structure only, storing nothing:
+		static bool    validateSmf                 (const uchar* data, size_t size,
+		                                            SmfCheck* check = NULL,
+		                                            bool strict = false);
+		static bool    validateSmf                 (const std::string& filename,
+		                                            SmfCheck* check = NULL,
+		                                            bool strict = false);
 
 		bool           write                       (const std::string& filename);
 		bool           write                       (std::ostream& out);
@@ -79,6 +207,20 @@ class MidiFile {
 		bool           writeBinascWithComments     (std::ostream& out);
 		bool           status                      (void) const;
 
+		// Decode the tracks of a file on several threads (0 = all cores):
+		void           setReadThreads              (int threads);
+		int            getReadThreads              (void) const;
+
+		// Lazy loading: decode each track when it is first used.  Until
+		// every track is loaded, const accessors such as operator[] and
+		// getEventCount() decode tracks and change the object, so a lazily
+		// read MidiFile must not be used from several threads at once,
+		// even through const references (call loadTracks() first):
+		void           setLazyLoad                 (bool state = true);
+		bool           isLazyLoad                  (void) const;
+		bool           isTrackLoaded               (int aTrack) const;
+		void           loadTracks                  (void) const;
+
 		// track-related functions:
 		const MidiEventList& operator[]            (int aTrack) const;
 		MidiEventList&   operator[]                (int aTrack);
@@ -299,16 +441,47 @@ class MidiFile {
 		std::vector<_TickTime> m_timemap;
 
 		// m_rwstatus == True if last read was successful, false if a problem.
-		bool m_rwstatus = true;
+		// Mutable since a lazily loaded track can fail when first used.
+		mutable bool m_rwstatus = true;
 
 		// m_linkedEventQ == True if link analysis has been done.
 		bool m_linkedEventsQ = false;
 
+		// m_readthreads == Number of threads for decoding the tracks of
+		// a file in readSmf() (0 = one per core).
+		int m_readthreads = 1;
+
+		// m_lazyloadQ == True if readSmf() only indexes the tracks and
+		// leaves decoding each one until it is first used.
+		bool m_lazyloadQ = false;
+
+		// m_lazy* == The file data and track index after a lazy read.
+		// m_lazyoffsets[i] is the offset of the first event of track i in
+		// m_lazydata, or 0 once the track has been decoded.  m_lazyevents[i]
+		// is the number of events in the track, or -1 if not counted yet.
+		// m_lazyfile owns the data when the file was opened by name.
+		mutable SmfData*            m_lazyfile  = NULL;
+		mutable const uchar*        m_lazydata  = NULL;
+		mutable size_t              m_lazysize  = 0;
+		mutable std::vector<size_t> m_lazyoffsets;
+		mutable std::vector<int>    m_lazyevents;
+		mutable int                 m_lazycount = 0;
+
 	private:
 		int         extractMidiData                 (std::istream& inputfile,
 		                                             std::vector<uchar>& array,
 		                                             uchar& runningCommand);
 		ulong       readVLValue                     (std::istream& inputfile);
+		static const char* decodeTrack              (const uchar* data, size_t size,
+		                                             size_t& offset, int track,
+		                                             MidiEventList& events);
+		bool        decodeTracks                    (const uchar* data, size_t size,
+		                                             size_t offset, int tracks);
+		bool        indexTracks                     (const uchar* data, size_t size,
+		                                             size_t offset, int tracks);
+		void        loadTrack                       (int aTrack) const;
+		int         lazyEventCount                  (int aTrack) const;
+		void        clearLazyIndex                  (void) const;
 		ulong       unpackVLV                       (uchar a = 0, uchar b = 0,
 		                                             uchar c = 0, uchar d = 0,
 		                                             uchar e = 0);
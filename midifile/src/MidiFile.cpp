@@ -16,14 +16,26 @@
 #include "Binasc.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <iterator>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
 
 namespace smf {
 
@@ -142,6 +154,7 @@ MidiFile& MidiFile::operator=(const MidiFile& other) {
 	if (this == &other) {
 		return *this;
 	}
+	other.loadTracks();
 	m_events.reserve(other.m_events.size());
 	auto it = other.m_events.begin();
 	std::generate_n(std::back_inserter(m_events), other.m_events.size(),
@@ -156,6 +169,8 @@ MidiFile& MidiFile::operator=(const MidiFile& other) {
 	m_timemapvalid        = other.m_timemapvalid;
 	m_timemap             = other.m_timemap;
 	m_rwstatus            = other.m_rwstatus;
+	m_readthreads         = other.m_readthreads;
+	m_lazyloadQ           = other.m_lazyloadQ;
 	if (other.m_linkedEventsQ) {
 		linkEventPairs();
 	}
@@ -164,6 +179,7 @@ MidiFile& MidiFile::operator=(const MidiFile& other) {
 
 
 MidiFile& MidiFile::operator=(MidiFile&& other) {
+	other.loadTracks();
 	m_events = std::move(other.m_events);
 	m_linkedEventsQ = other.m_linkedEventsQ;
 	other.m_linkedEventsQ = false;
@@ -176,6 +192,8 @@ MidiFile& MidiFile::operator=(MidiFile&& other) {
 	m_timemapvalid        = other.m_timemapvalid;
 	m_timemap             = other.m_timemap;
 	m_rwstatus            = other.m_rwstatus;
+	m_readthreads         = other.m_readthreads;
+	m_lazyloadQ           = other.m_lazyloadQ;
 	return *this;
 }
 
@@ -197,6 +215,16 @@ bool MidiFile::read(const std::string& filename) {
 	setFilename(filename);
 	m_rwstatus = true;
 
+	// Standard MIDI Files are parsed directly from the mapped file;
+	// anything else goes through the stream reader for binasc decoding.
+	SmfData smfdata;
+	if (smfdata.open(filename) && smfdata.size() > 0 && smfdata.data()[0] == 'M') {
+		smfdata.close();
+		m_rwstatus = readSmf(filename);
+		return m_rwstatus;
+	}
+	smfdata.close();
+
 	std::fstream input;
 	input.open(filename.c_str(), std::ios::binary | std::ios::in);
 
@@ -273,15 +301,20 @@ bool MidiFile::readSmf(const std::string& filename) {
 	setFilename(filename);
 	m_rwstatus = true;
 
-	std::fstream input;
-	input.open(filename.c_str(), std::ios::binary | std::ios::in);
-
-	if (!input.is_open()) {
+	SmfData* smfdata = new SmfData;
+	if (!smfdata->open(filename)) {
+		delete smfdata;
 		m_rwstatus = false;
 		return m_rwstatus;
 	}
 
-	m_rwstatus = readSmf(input);
+	m_rwstatus = readSmf(smfdata->data(), smfdata->size());
+	if (m_lazycount > 0) {
+		// keep the data until the last track has been decoded
+		m_lazyfile = smfdata;
+	} else {
+		delete smfdata;
+	}
 	return m_rwstatus;
 }
 
@@ -549,457 +582,651 @@ bool MidiFile::readSmf(std::istream& input) {
 
 //////////////////////////////
 //
-// MidiFile::write -- write a standard MIDI file to a file or an output
-//    stream.
+// readBigEndian2, readBigEndian4 -- Numbers in MIDI file chunk headers.
 //
 
-bool MidiFile::write(const std::string& filename) {
-	std::fstream output(filename.c_str(), std::ios::binary | std::ios::out);
-
-	if (!output.is_open()) {
-		std::cerr << "Error: could not write: " << filename << std::endl;
-		return false;
-	}
-	m_rwstatus = write(output);
-	output.close();
-	return m_rwstatus;
+static ushort readBigEndian2(const uchar* p) {
+	return (ushort)((p[0] << 8) | p[1]);
 }
 
-//
-// ostream version of MidiFile::write().
-//
-
-bool MidiFile::write(std::ostream& out) {
-	int oldTimeState = getTickState();
-	if (oldTimeState == TIME_STATE_ABSOLUTE) {
-		makeDeltaTicks();
-	}
-
-	// write the header of the Standard MIDI File
-	char ch;
-	// 1. The characters "MThd"
-	ch = 'M'; out << ch;
-	ch = 'T'; out << ch;
-	ch = 'h'; out << ch;
-	ch = 'd'; out << ch;
 
-	// 2. write the size of the header (always a "6" stored in unsigned long
-	//    (4 bytes).
-	ulong longdata = 6;
-	writeBigEndianULong(out, longdata);
+static ulong readBigEndian4(const uchar* p) {
+	return ((ulong)p[0] << 24) | ((ulong)p[1] << 16) | ((ulong)p[2] << 8) | p[3];
+}
 
-	// 3. MIDI file format, type 0, 1, or 2
-	ushort shortdata;
-	shortdata = static_cast<ushort>(getNumTracks() == 1 ? 0 : 1);
-	writeBigEndianUShort(out,shortdata);
 
-	// 4. write out the number of tracks.
-	shortdata = static_cast<ushort>(getNumTracks());
-	writeBigEndianUShort(out, shortdata);
 
-	// 5. write out the number of ticks per quarternote. (avoiding SMPTE for now)
-	shortdata = static_cast<ushort>(getTicksPerQuarterNote());
-	writeBigEndianUShort(out, shortdata);
+//////////////////////////////
+//
+// scanVLV -- Read a VLV value at p (at most 5 bytes, as readVLValue()
+//     allows) and advance p past it.  Returns NULL, or an error message.
+//
 
-	// now write each track.
-	std::vector<uchar> trackdata;
-	uchar endoftrack[4] = {0, 0xff, 0x2f, 0x00};
-	int i, j, k;
-	int size;
-	for (i=0; i<getNumTracks(); i++) {
-		trackdata.reserve(123456);   // make the track data larger than
-		                             // expected data input
-		trackdata.clear();
-		for (j=0; j<(int)m_events[i]->size(); j++) {
-			if ((*m_events[i])[j].empty()) {
-				// Don't write empty m_events (probably a delete message).
-				continue;
-			}
-			if ((*m_events[i])[j].isEndOfTrack()) {
-				// Suppress end-of-track meta messages (one will be added
-				// automatically after all track data has been written).
-				continue;
-			}
-			writeVLValue((*m_events[i])[j].tick, trackdata);
-			if (((*m_events[i])[j].getCommandByte() == 0xf0) ||
-					((*m_events[i])[j].getCommandByte() == 0xf7)) {
-				// 0xf0 == Complete sysex message (0xf0 is part of the raw MIDI).
-				// 0xf7 == Raw byte message (0xf7 not part of the raw MIDI).
-				// Print the first byte of the message (0xf0 or 0xf7), then
-				// print a VLV length for the rest of the bytes in the message.
-				// In other words, when creating a 0xf0 or 0xf7 MIDI message,
-				// do not insert the VLV byte length yourself, as this code will
-				// do it for you automatically.
-				trackdata.push_back((*m_events[i])[j][0]); // 0xf0 or 0xf7;
-				writeVLValue(((int)(*m_events[i])[j].size())-1, trackdata);
-				for (k=1; k<(int)(*m_events[i])[j].size(); k++) {
-					trackdata.push_back((*m_events[i])[j][k]);
-				}
-			} else {
-				// non-sysex type of message, so just output the
-				// bytes of the message:
-				for (k=0; k<(int)(*m_events[i])[j].size(); k++) {
-					trackdata.push_back((*m_events[i])[j][k]);
-				}
-			}
+static const char* scanVLV(const uchar*& p, const uchar* end, ulong& value) {
+	value = 0;
+	for (int i=0; i<5; i++) {
+		if (p >= end) {
+			return "unexpected end of file";
 		}
-		size = (int)trackdata.size();
-		if ((size < 3) || !((trackdata[size-3] == 0xff)
-				&& (trackdata[size-2] == 0x2f))) {
-			trackdata.push_back(endoftrack[0]);
-			trackdata.push_back(endoftrack[1]);
-			trackdata.push_back(endoftrack[2]);
-			trackdata.push_back(endoftrack[3]);
+		uchar byte = *p++;
+		value = (value << 7) | (byte & 0x7f);
+		if (byte < 0x80) {
+			return NULL;
 		}
-
-		// now ready to write to MIDI file.
-
-		// first write the track ID marker "MTrk":
-		ch = 'M'; out << ch;
-		ch = 'T'; out << ch;
-		ch = 'r'; out << ch;
-		ch = 'k'; out << ch;
-
-		// A. write the size of the MIDI data to follow:
-		longdata = (int)trackdata.size();
-		writeBigEndianULong(out, longdata);
-
-		// B. write the actual data
-		out.write((char*)trackdata.data(), trackdata.size());
 	}
-
-	if (oldTimeState == TIME_STATE_ABSOLUTE) {
-		makeAbsoluteTicks();
-	}
-
-	return true;
+	return "VLV number is too large";
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::writeBase64 -- Write Standard MIDI file with base64 encoding.
-//    The width parameter can be used to add line breaks.  Zero or negative
-//    width will prevent linebreaks from being added to the data.
-//    Default value: width = 0
+// scanMessage -- Read the MIDI message at p in a track and advance p past
+//     it, following the rules of MidiFile::extractMidiData(): the message
+//     is runningCommand followed by bodysize bytes at body.  For running
+//     status body starts at the first data byte; for meta messages it
+//     holds the type, length VLV and data; for sysex (0xf0) and raw byte
+//     (0xf7) messages it holds the data after the length VLV.  Returns
+//     NULL, or an error message.
 //
 
-bool MidiFile::writeBase64(const std::string& filename, int width) {
-	std::fstream output(filename.c_str(), std::ios::binary | std::ios::out);
-
-	if (!output.is_open()) {
-		std::cerr << "Error: could not write: " << filename << std::endl;
-		return false;
+static const char* scanMessage(const uchar*& p, const uchar* end,
+		uchar& runningCommand, const uchar*& body, size_t& bodysize) {
+	if (p >= end) {
+		return "unexpected end of file";
 	}
-	m_rwstatus = writeBase64(output, width);
-	output.close();
-	return m_rwstatus;
-}
-
+	int runningQ = 0;
+	if (*p < 0x80) {
+		if (runningCommand == 0) {
+			return "running command with no previous command";
+		}
+		if (runningCommand >= 0xf0) {
+			return "running status not permitted with meta and sysex event";
+		}
+		runningQ = 1;
+	} else {
+		runningCommand = *p++;
+	}
+	body = p;
 
-bool MidiFile::writeBase64(std::ostream& out, int width) {
-	std::stringstream raw;
-	bool status = MidiFile::write(raw);
-	if (!status) {
-		return status;
+	switch (runningCommand & 0xf0) {
+		case 0x80:        // note off (2 more bytes)
+		case 0x90:        // note on (2 more bytes)
+		case 0xA0:        // aftertouch (2 more bytes)
+		case 0xB0:        // cont. controller (2 more bytes)
+		case 0xE0:        // pitch wheel (2 more bytes)
+			bodysize = 2;
+			break;
+		case 0xC0:        // patch change (1 more byte)
+		case 0xD0:        // channel pressure (1 more byte)
+			bodysize = 1;
+			break;
+		default:
+			bodysize = 0;
+			if (runningCommand == 0xff) {
+				// meta event: type, then a data length VLV of up to 4 bytes
+				if (p >= end) {
+					return "unexpected end of file";
+				}
+				const uchar* q = p + 1;
+				ulong length = 0;
+				int count = 0;
+				uchar byte;
+				do {
+					if (q >= end) {
+						return "unexpected end of file";
+					}
+					byte = *q++;
+					length = (length << 7) | (byte & 0x7f);
+				} while ((byte >= 0x80) && (++count < 4));
+				if (byte >= 0x80) {
+					return "cannot handle large VLVs";
+				}
+				if (length > (size_t)(end - q)) {
+					return "unexpected end of file";
+				}
+				bodysize = (q - p) + length;
+			} else if ((runningCommand == 0xf0) || (runningCommand == 0xf7)) {
+				// sysex or raw bytes: the length VLV is not stored
+				ulong length;
+				const char* error = scanVLV(p, end, length);
+				if (error) {
+					return error;
+				}
+				if (length > (size_t)(end - p)) {
+					return "unexpected end of file";
+				}
+				body = p;
+				bodysize = length;
+			}
+			p += bodysize;
+			return NULL;
 	}
-	std::string encoded = MidiFile::base64Encode(raw.str());
-	if (width <= 0) {
-		out << encoded;
-		return status;
+
+	if (bodysize > (size_t)(end - p)) {
+		return "unexpected end of file";
 	}
-	int length = (int)encoded.size();
-	for (int i=0; i<length; i++) {
-		out << encoded[i];
-		if ((i + 1) % width == 0) {
-			out << "\n";
+	for (size_t i=runningQ; i<bodysize; i++) {
+		if (p[i] > 0x7f) {
+			return "MIDI data byte too large";
 		}
 	}
-	if ((length + 1) % width != 0) {
-		out << "\n";
-	}
-	return status;
+	p += bodysize;
+	return NULL;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::getBase64 -- Convert the MIDI contents to a base-64 string.
-//     Default value: width = 0
+// findTracks -- Follow the MTrk chunk sizes from offset and store where
+//     the data of each track starts and how long its chunk claims to be.
+//     Returns false if a chunk header is missing or runs past the end.
 //
 
-std::string MidiFile::getBase64(int width) {
-	std::stringstream output;
-	bool status = MidiFile::writeBase64(output, width);
-	if (!status) {
-		return "";
-	} else {
-		return output.str();
+static bool findTracks(const uchar* data, size_t size, size_t offset,
+		int tracks, std::vector<size_t>& starts, std::vector<size_t>& lengths) {
+	starts.resize(tracks);
+	lengths.resize(tracks);
+	for (int i=0; i<tracks; i++) {
+		if ((size - offset < 8) || (memcmp(data + offset, "MTrk", 4) != 0)) {
+			return false;
+		}
+		lengths[i] = readBigEndian4(data + offset + 4);
+		offset += 8;
+		if (lengths[i] > size - offset) {
+			return false;
+		}
+		starts[i] = offset;
+		offset += lengths[i];
 	}
+	return true;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::writeHex -- print the Standard MIDI file as a list of
-//    ASCII Hex bytes, formatted 25 to a line by default, and
-//    two digits for each hex byte code.  If the input width is 0,
-//    then don't wrap lines.
-//
-//  default value: width=25
+// MidiFile::readSmf -- Parse a Standard MIDI File held in memory.  The
+//    bytes are read in place with bounds checks instead of one stream
+//    call per byte, giving the same events as the istream version.
+//    In lazy-load mode the data must stay valid until every track has
+//    been used (or loadTracks() has been called).
 //
 
-bool MidiFile::writeHex(const std::string& filename, int width) {
-	std::fstream output(filename.c_str(), std::ios::out);
-	if (!output.is_open()) {
-		std::cerr << "Error: could not write: " << filename << std::endl;
-		return false;
-	}
-	m_rwstatus = writeHex(output, width);
-	output.close();
-	return m_rwstatus;
-}
+bool MidiFile::readSmf(const uchar* data, size_t size) {
+	m_rwstatus = true;
 
-//
-// ostream version of MidiFile::writeHex().
-//
+	std::string filename = getFilename();
 
-bool MidiFile::writeHex(std::ostream& out, int width) {
-	std::stringstream tempstream;
-	MidiFile::write(tempstream);
-	int len = (int)tempstream.str().length();
-	int wordcount = 1;
-	int linewidth = width >= 0 ? width : 25;
-	for (int i=0; i<len; i++) {
-		int value = (uchar)tempstream.str()[i];
-		out << std::hex << std::setw(2) << std::setfill('0') << value;
-		if (linewidth) {
-			if (i < len - 1) {
-				out << ((wordcount % linewidth) ? ' ' : '\n');
-			}
-			wordcount++;
-		} else {
-			// print with no line breaks
-			if (i < len - 1) {
-				out << ' ';
-			}
-		}
+	if (size < 4 || memcmp(data, "MThd", 4) != 0) {
+		std::cerr << "File " << filename << " is not a MIDI file" << std::endl;
+		std::cerr << "Expecting 'MThd' at the start of the file." << std::endl;
+		m_rwstatus = false; return m_rwstatus;
 	}
-	if (linewidth) {
-		out << '\n';
+	if (size < 14) {
+		std::cerr << "In file " << filename << ": unexpected end of file." << std::endl;
+		std::cerr << "The MIDI header is incomplete." << std::endl;
+		m_rwstatus = false; return m_rwstatus;
 	}
-	return true;
-}
 
+	// read header size (allow larger header size?)
+	ulong longdata = readBigEndian4(data + 4);
+	if (longdata != 6) {
+		std::cerr << "File " << filename
+		     << " is not a MIDI 1.0 Standard MIDI file." << std::endl;
+		std::cerr << "The header size is " << longdata << " bytes." << std::endl;
+		m_rwstatus = false; return m_rwstatus;
+	}
 
+	// Header parameter #1: format type (type-2 files are not handled)
+	ushort shortdata = readBigEndian2(data + 8);
+	if (shortdata > 1) {
+		std::cerr << "Error: cannot handle a type-" << shortdata
+		     << " MIDI file" << std::endl;
+		m_rwstatus = false; return m_rwstatus;
+	}
+	int type = shortdata;
 
-//////////////////////////////
-//
-// MidiFile::writeBinasc -- write a standard MIDI file from data into
-//    the binasc format (ASCII version of the MIDI file).
-//
+	// Header parameter #2: track count
+	shortdata = readBigEndian2(data + 10);
+	if (type == 0 && shortdata != 1) {
+		std::cerr << "Error: Type 0 MIDI file can only contain one track" << std::endl;
+		std::cerr << "Instead track count is: " << shortdata << std::endl;
+		m_rwstatus = false; return m_rwstatus;
+	}
+	int tracks = shortdata;
+	clear();
+	if (m_events[0] != NULL) {
+		delete m_events[0];
+	}
+	m_events.resize(tracks);
+	for (int z=0; z<tracks; z++) {
+		m_events[z] = new MidiEventList;
+	}
 
-bool MidiFile::writeBinasc(const std::string& filename) {
-	std::fstream output(filename.c_str(), std::ios::out);
+	// Header parameter #3: Ticks per quarter note
+	shortdata = readBigEndian2(data + 12);
+	if (shortdata >= 0x8000) {
+		int framespersecond = 255 - ((shortdata >> 8) & 0x00ff) + 1;
+		int subframes       = shortdata & 0x00ff;
+		switch (framespersecond) {
+			case 25: case 24: case 29: case 30:
+				break;
+			default:
+				std::cerr << "Warning: unknown FPS: " << framespersecond << std::endl;
+				std::cerr << "Using non-standard FPS: " << framespersecond << std::endl;
+		}
+		m_ticksPerQuarterNote = framespersecond * subframes;
+	} else {
+		m_ticksPerQuarterNote = shortdata;
+	}
 
-	if (!output.is_open()) {
-		std::cerr << "Error: could not write: " << filename << std::endl;
-		return false;
+	// In lazy-load mode only the chunk headers are read here, and each
+	// track is decoded by loadTrack() when it is first used.
+	if (m_lazyloadQ && indexTracks(data, size, 14, tracks)) {
+		m_theTimeState = TIME_STATE_ABSOLUTE;
+		return m_rwstatus;
 	}
-	m_rwstatus = writeBinasc(output);
-	output.close();
-	return m_rwstatus;
-}
 
-//
-// ostream version of MidiFile::writeBinasc().
-//
+	// Tracks are independent once their chunks are found, so they can
+	// be decoded on several threads (see setReadThreads()).
+	if ((m_readthreads != 1) && (tracks > 1) && decodeTracks(data, size, 14, tracks)) {
+		m_theTimeState = TIME_STATE_ABSOLUTE;
+		markSequence();
+		return m_rwstatus;
+	}
 
-bool MidiFile::writeBinasc(std::ostream& output) {
-	std::stringstream binarydata;
-	m_rwstatus = write(binarydata);
-	if (m_rwstatus == false) {
-		return false;
+	// now read individual tracks:
+	size_t offset = 14;
+	for (int i=0; i<tracks; i++) {
+		if (size - offset < 8) {
+			std::cerr << "In file " << filename << ": unexpected end of file." << std::endl;
+			std::cerr << "Expecting track " << i + 1 << " of " << tracks
+			     << ", but found nothing." << std::endl;
+			m_rwstatus = false; return m_rwstatus;
+		}
+		if (memcmp(data + offset, "MTrk", 4) != 0) {
+			std::cerr << "File " << filename << " is not a MIDI file" << std::endl;
+			std::cerr << "Expecting 'MTrk' at byte " << offset << std::endl;
+			m_rwstatus = false; return m_rwstatus;
+		}
+
+		// As in the istream reader, the chunk size is only a hint for
+		// the allocation: the track ends with its end-of-track message.
+		longdata = readBigEndian4(data + offset + 4);
+		offset += 8;
+		m_events[i]->reserve((int)(std::min((size_t)longdata, size - offset) / 2));
+
+		const char* error = decodeTrack(data, size, offset, i, *m_events[i]);
+		if (error) {
+			std::cerr << "In file " << filename << ", track " << i + 1
+			     << ", byte " << offset << ": " << error << std::endl;
+			m_rwstatus = false; return m_rwstatus;
+		}
 	}
 
-	Binasc binasc;
-	binasc.setMidiOn();
-	binarydata.seekg(0, std::ios_base::beg);
-	binasc.readFromBinary(output, binarydata);
-	return true;
+	m_theTimeState = TIME_STATE_ABSOLUTE;
+
+	// The original order of the MIDI events is marked with an enumeration which
+	// allows for reconstruction of the order when merging/splitting tracks to/from
+	// a type-0 configuration.
+	markSequence();
+
+	return m_rwstatus;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::writeBinascWithComments -- write a standard MIDI
-//    file from data into the binasc format (ASCII version
-//    of the MIDI file), including commentary about the MIDI messages.
-//
+// MidiFile::validateSmf -- Check that data holds a Standard MIDI File
+//    that readSmf() would read without an error, by walking its chunk
+//    headers, VLVs and message lengths in place.  Nothing is allocated
+//    and nothing is printed: the first problem found is described in
+//    check (if given) with its byte offset and track.  In strict mode
+//    each track must also fit in its MTrk chunk and end exactly where
+//    the chunk size says, which readSmf() does not require.
+//
+
+bool MidiFile::validateSmf(const uchar* data, size_t size, SmfCheck* check,
+		bool strict) {
+	SmfCheck local;
+	SmfCheck& result = check ? *check : local;
+	result = SmfCheck();
+
+	SmfEventReader header;
+	if (!header.open(data, size)) {
+		result.reason = header.getError();
+		result.offset = header.getErrorOffset();
+		return false;
+	}
+	result.tracks = header.getTrackCount();
 
-bool MidiFile::writeBinascWithComments(const std::string& filename) {
-	std::fstream output(filename.c_str(), std::ios::out);
+	const uchar* p   = data + 14;
+	const uchar* end = data + size;
+	const char* error = NULL;
+	for (int i=0; i<result.tracks; i++) {
+		result.track = i;
+		if (end - p < 8) {
+			p = end;
+			error = "unexpected end of file";
+			break;
+		}
+		if (memcmp(p, "MTrk", 4) != 0) {
+			error = "expecting 'MTrk'";
+			break;
+		}
+		ulong length = readBigEndian4(p + 4);
+		p += 8;
+		const uchar* limit = end;
+		if (strict) {
+			if (length > (size_t)(end - p)) {
+				p -= 4;
+				error = "track chunk runs past the end of the file";
+				break;
+			}
+			limit = p + length;
+		}
 
-	if (!output.is_open()) {
-		std::cerr << "Error: could not write: " << filename << std::endl;
-		return 0;
+		uchar runningCommand = 0;
+		const uchar* body;
+		size_t bodysize;
+		ulong delta;
+		while (true) {
+			error = scanVLV(p, limit, delta);
+			if (!error) {
+				error = scanMessage(p, limit, runningCommand, body, bodysize);
+			}
+			if (error) {
+				break;
+			}
+			result.events++;
+			if ((runningCommand == 0xff) && (body[0] == 0x2f)) {
+				break;
+			}
+		}
+		if (error) {
+			if ((limit != end) && (strcmp(error, "unexpected end of file") == 0)) {
+				error = "unexpected end of track chunk";
+			}
+			break;
+		}
+		if (strict && (p != limit)) {
+			error = "end-of-track before the end of the track chunk";
+			break;
+		}
 	}
-	m_rwstatus = writeBinascWithComments(output);
-	output.close();
-	return m_rwstatus;
+
+	if (error) {
+		result.reason = error;
+		result.offset = p - data;
+		return false;
+	}
+	result.track = -1;
+	return true;
 }
 
-//
-// ostream version of MidiFile::writeBinascWithComments().
-//
 
-bool MidiFile::writeBinascWithComments(std::ostream& output) {
-	std::stringstream binarydata;
-	m_rwstatus = write(binarydata);
-	if (m_rwstatus == false) {
+bool MidiFile::validateSmf(const std::string& filename, SmfCheck* check,
+		bool strict) {
+	SmfData file;
+	if (!file.open(filename)) {
+		if (check) {
+			*check = SmfCheck();
+			check->reason = "cannot open file";
+		}
 		return false;
 	}
-
-	Binasc binasc;
-	binasc.setMidiOn();
-	binasc.setCommentsOn();
-	binarydata.seekg(0, std::ios_base::beg);
-	binasc.readFromBinary(output, binarydata);
-	return true;
+	return validateSmf(file.data(), file.size(), check, strict);
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::status -- return the success flag from the last read or
-//    write (writeHex, writeBinasc).
-//
+// MidiFile::decodeTrack -- Decode the events of the track whose data
+//    starts at data[offset] into the event list, with absolute ticks,
+//    up to and including its end-of-track message.  On return offset
+//    points after the last byte read.  Returns NULL on success, or a
+//    description of the problem at offset.  Only touches its arguments,
+//    so separate tracks may be decoded at the same time.
+//
+
+const char* MidiFile::decodeTrack(const uchar* data, size_t size,
+		size_t& offset, int track, MidiEventList& events) {
+	const uchar* p   = data + offset;
+	const uchar* end = data + size;
+	uchar runningCommand = 0;
+	int absticks = 0;
+
+	while (true) {
+		ulong delta;
+		const uchar* body;
+		size_t bodysize;
+		const char* error = scanVLV(p, end, delta);
+		if (!error) {
+			error = scanMessage(p, end, runningCommand, body, bodysize);
+		}
+		if (error) {
+			offset = p - data;
+			return error;
+		}
+		absticks += delta;
+
+		MidiEvent* event = new MidiEvent;
+		event->resize(bodysize + 1);
+		(*event)[0] = runningCommand;
+		std::copy(body, body + bodysize, event->begin() + 1);
+		event->tick  = absticks;
+		event->track = track;
+		events.push_back_no_copy(event);
+
+		if (runningCommand == 0xff && bodysize > 0 && body[0] == 0x2f) {
+			// end-of-track message
+			break;
+		}
+	}
 
-bool MidiFile::status(void) const {
-	return m_rwstatus;
+	offset = p - data;
+	return NULL;
 }
 
 
-///////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////
 //
-// track-related functions --
+// MidiFile::setReadThreads -- Number of threads that readSmf() may use to
+//    decode the tracks of a multi-track file from memory or a file.
+//    1 (the default) decodes them one after another, 0 uses all cores.
+//    The events are identical either way.
 //
 
+void MidiFile::setReadThreads(int threads) {
+	m_readthreads = threads < 0 ? 1 : threads;
+}
+
+
+
 //////////////////////////////
 //
-// MidiFile::operator[] -- return the event list for the specified track.
+// MidiFile::getReadThreads -- Returns the number of threads readSmf() may
+//    use to decode tracks (0: all cores).
 //
 
-MidiEventList& MidiFile::operator[](int aTrack) {
-	return *m_events[aTrack];
+int MidiFile::getReadThreads(void) const {
+	return m_readthreads;
 }
 
-const MidiEventList& MidiFile::operator[](int aTrack) const {
-	return *m_events[aTrack];
-}
 
 
 //////////////////////////////
 //
-// MidiFile::getTrackCount -- return the number of tracks in
-//   the Midi File.
+// MidiFile::decodeTracks -- Decode all tracks concurrently, each into its
+//    own event list.  Returns false, with the event lists emptied, if a
+//    track has an error or does not end where the next chunk starts; the
+//    serial reader then reads the file and reports any problem exactly
+//    as it would have anyway.
 //
 
-int MidiFile::getTrackCount(void) const {
-	return (int)m_events.size();
+bool MidiFile::decodeTracks(const uchar* data, size_t size, size_t offset,
+		int tracks) {
+	std::vector<size_t> starts;
+	std::vector<size_t> lengths;
+	if (!findTracks(data, size, offset, tracks, starts, lengths)) {
+		return false;
+	}
+
+	int threads = m_readthreads;
+	if (threads == 0) {
+		threads = (int)std::thread::hardware_concurrency();
+	}
+	threads = std::max(1, std::min(threads, tracks));
+
+	std::vector<size_t> ends(starts);
+	std::vector<char> failed(tracks, 0);
+	std::atomic<int> next(0);
+	auto work = [&]() {
+		int i;
+		while ((i = next++) < tracks) {
+			m_events[i]->reserve((int)lengths[i] / 2);
+			failed[i] = decodeTrack(data, size, ends[i], i, *m_events[i]) != NULL;
+		}
+	};
+	std::vector<std::thread> workers;
+	for (int t=1; t<threads; t++) {
+		workers.emplace_back(work);
+	}
+	work();
+	for (auto& worker : workers) {
+		worker.join();
+	}
+
+	for (int i=0; i<tracks; i++) {
+		if (failed[i] || ((i < tracks - 1) && (ends[i] + 8 != starts[i+1]))) {
+			for (int j=0; j<tracks; j++) {
+				m_events[j]->clear();
+			}
+			return false;
+		}
+	}
+	return true;
 }
 
+
+
+//////////////////////////////
 //
-// Alias for getTrackCount()
+// MidiFile::setLazyLoad -- Only index the tracks when reading a Standard
+//    MIDI File, and decode each track the first time it is accessed.
+//    Reading the tempo track of a large multi-track file then costs
+//    little more than opening it.  Errors in a track are reported when
+//    the track is decoded.  Streams are always read completely.
 //
 
-int MidiFile::getNumTracks(void) const {
-	return getTrackCount();
+void MidiFile::setLazyLoad(bool state) {
+	m_lazyloadQ = state;
 }
 
+
+
+//////////////////////////////
 //
-// Alias for getTrackCount()
+// MidiFile::isLazyLoad -- Returns true if tracks are decoded on first use.
 //
 
-int MidiFile::size(void) const {
-	return getTrackCount();
+bool MidiFile::isLazyLoad(void) const {
+	return m_lazyloadQ;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::removeEmpties -- Remove any MIDI message that
-//     contains no bytes.
+// MidiFile::isTrackLoaded -- Returns false if the track has not been
+//    decoded yet after a lazy read.
 //
 
-void MidiFile::removeEmpties(void) {
-	for (auto &event : m_events) {
-		event->removeEmpties();
+bool MidiFile::isTrackLoaded(int aTrack) const {
+	if ((aTrack < 0) || (aTrack >= (int)m_lazyoffsets.size())) {
+		return true;
 	}
+	return m_lazyoffsets[aTrack] == 0;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::markSequence -- Assign a sequence serial number to
-//   every MidiEvent in every track in the MIDI file.  This is
-//   useful if you want to preseve the order of MIDI messages in
-//   a track when they occur at the same tick time.  Particularly
-//   for use with joinTracks() or sortTracks().  markSequence will
-//   be done automatically when a MIDI file is read, in case the
-//   ordering of m_events occurring at the same time is important.
-//   Use clearSequence() to use the default sorting behavior of
-//   sortTracks().
+// MidiFile::loadTracks -- Decode all tracks not decoded yet after a
+//    lazy read.
 //
 
-void MidiFile::markSequence(void) {
-	int sequence = 1;
-	for (int i=0; i<getTrackCount(); i++) {
-		sequence = operator[](i).markSequence(sequence);
+void MidiFile::loadTracks(void) const {
+	for (int i=0; (m_lazycount > 0) && (i<(int)m_lazyoffsets.size()); i++) {
+		loadTrack(i);
 	}
 }
 
+
+
+//////////////////////////////
 //
-// MidiFile::markSequence -- default value: sequence = 1.
+// MidiFile::indexTracks -- Record where the events of each track start,
+//    following the MTrk chunk sizes from offset.  Returns false, leaving
+//    nothing indexed, if the chunks do not line up with the file (the
+//    tracks are then read in full, which also reports the problem).
 //
 
-void MidiFile::markSequence(int track, int sequence) {
-	if ((track >= 0) && (track < getTrackCount())) {
-		operator[](track).markSequence(sequence);
-	} else {
-		std::cerr << "Warning: track " << track << " does not exist." << std::endl;
+bool MidiFile::indexTracks(const uchar* data, size_t size, size_t offset,
+		int tracks) {
+	clearLazyIndex();
+	std::vector<size_t> offsets;
+	std::vector<size_t> lengths;
+	if (!findTracks(data, size, offset, tracks, offsets, lengths)) {
+		return false;
 	}
+	m_lazydata = data;
+	m_lazysize = size;
+	m_lazyoffsets.swap(offsets);
+	m_lazyevents.assign(tracks, -1);
+	m_lazycount = tracks;
+	return true;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::clearSequence -- Remove any sequence serial numbers from
-//   MidiEvents in the MidiFile.  This will cause the default ordering by
-//   sortTracks() to be used, in which case the ordering of MidiEvents
-//   occurring at the same tick may switch their ordering.
+// MidiFile::loadTrack -- Decode a track if it has not been decoded yet
+//    after a lazy read.  Sequence numbers continue from the events of
+//    the earlier tracks, as markSequence() numbers a fully read file.
 //
 
-void MidiFile::clearSequence(void) {
-	for (int i=0; i<getTrackCount(); i++) {
-		operator[](i).clearSequence();
+void MidiFile::loadTrack(int aTrack) const {
+	if ((m_lazycount == 0) || isTrackLoaded(aTrack)) {
+		return;
 	}
-}
 
+	int sequence = 1;
+	for (int i=0; i<aTrack; i++) {
+		sequence += lazyEventCount(i);
+	}
 
-void MidiFile::clearSequence(int track) {
-	if ((track >= 0) && (track < getTrackCount())) {
-		operator[](track).clearSequence();
-	} else {
-		std::cerr << "Warning: track " << track << " does not exist." << std::endl;
+	size_t offset = m_lazyoffsets[aTrack];
+	MidiEventList& events = *m_events[aTrack];
+	const char* error = decodeTrack(m_lazydata, m_lazysize, offset, aTrack, events);
+	if (error) {
+		std::cerr << "In file " << getFilename() << ", track " << aTrack + 1
+		     << ", byte " << offset << ": " << error << std::endl;
+		m_rwstatus = false;
+	}
+	events.markSequence(sequence);
+	m_lazyevents[aTrack] = events.size();
+	m_lazyoffsets[aTrack] = 0;
+
+	if (--m_lazycount == 0) {
+		clearLazyIndex();
 	}
 }
 
@@ -1007,2030 +1234,2990 @@ void MidiFile::clearSequence(int track) {
 
 //////////////////////////////
 //
-// MidiFile::joinTracks -- Interleave the data from all tracks,
-//   but keeping the identity of the tracks unique so that
-//   the function splitTracks can be called to split the
-//   tracks into separate units again.  The style of the
-//   MidiFile when read from a file is with tracks split.
-//   The original track index is stored in the MidiEvent::track
-//   variable.
+// MidiFile::lazyEventCount -- Number of events in a track after a lazy
+//    read, counted without decoding them if the track is not loaded.
 //
 
-void MidiFile::joinTracks(void) {
-	if (getTrackState() == TRACK_STATE_JOINED) {
-		return;
+int MidiFile::lazyEventCount(int aTrack) const {
+	if (m_lazyevents[aTrack] >= 0) {
+		return m_lazyevents[aTrack];
 	}
-	if (getNumTracks() == 1) {
-		m_theTrackState = TRACK_STATE_JOINED;
-		return;
+	const uchar* p   = m_lazydata + m_lazyoffsets[aTrack];
+	const uchar* end = m_lazydata + m_lazysize;
+	uchar runningCommand = 0;
+	int count = 0;
+	while (true) {
+		ulong delta;
+		const uchar* body;
+		size_t bodysize;
+		if (scanVLV(p, end, delta) ||
+				scanMessage(p, end, runningCommand, body, bodysize)) {
+			break;
+		}
+		count++;
+		if (runningCommand == 0xff && bodysize > 0 && body[0] == 0x2f) {
+			break;
+		}
 	}
+	m_lazyevents[aTrack] = count;
+	return count;
+}
 
-	MidiEventList* joinedTrack;
-	joinedTrack = new MidiEventList;
 
-	int messagesum = 0;
-	int length = getNumTracks();
-	int i, j;
-	for (i=0; i<length; i++) {
-		messagesum += (*m_events[i]).size();
-	}
-	joinedTrack->reserve((int)(messagesum + 32 + messagesum * 0.1));
-
-	int oldTimeState = getTickState();
-	if (oldTimeState == TIME_STATE_DELTA) {
-		makeAbsoluteTicks();
-	}
-	for (i=0; i<length; i++) {
-		for (j=0; j<(int)m_events[i]->size(); j++) {
-			joinedTrack->push_back_no_copy(&(*m_events[i])[j]);
-		}
-	}
-
-	clear_no_deallocate();
 
-	delete m_events[0];
-	m_events.resize(0);
-	m_events.push_back(joinedTrack);
-	sortTracks();
-	if (oldTimeState == TIME_STATE_DELTA) {
-		makeDeltaTicks();
-	}
+//////////////////////////////
+//
+// MidiFile::clearLazyIndex -- Forget the tracks still to be decoded and
+//    release the file data held for them.
+//
 
-	m_theTrackState = TRACK_STATE_JOINED;
+void MidiFile::clearLazyIndex(void) const {
+	delete m_lazyfile;
+	m_lazyfile  = NULL;
+	m_lazydata  = NULL;
+	m_lazysize  = 0;
+	m_lazycount = 0;
+	m_lazyoffsets.clear();
+	m_lazyevents.clear();
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::splitTracks -- Take the joined tracks and split them
-//   back into their separate track identities.
+// MidiFile::write -- write a standard MIDI file to a file or an output
+//    stream.
 //
 
-void MidiFile::splitTracks(void) {
-	if (getTrackState() == TRACK_STATE_SPLIT) {
-		return;
+bool MidiFile::write(const std::string& filename) {
+	std::fstream output(filename.c_str(), std::ios::binary | std::ios::out);
+
+	if (!output.is_open()) {
+		std::cerr << "Error: could not write: " << filename << std::endl;
+		return false;
 	}
+	m_rwstatus = write(output);
+	output.close();
+	return m_rwstatus;
+}
+
+//
+// ostream version of MidiFile::write().
+//
+
+bool MidiFile::write(std::ostream& out) {
+	loadTracks();
 	int oldTimeState = getTickState();
-	if (oldTimeState == TIME_STATE_DELTA) {
-		makeAbsoluteTicks();
+	if (oldTimeState == TIME_STATE_ABSOLUTE) {
+		makeDeltaTicks();
 	}
 
-	int maxTrack = 0;
-	int i;
-	int length = m_events[0]->size();
-	for (i=0; i<length; i++) {
-		if ((*m_events[0])[i].track > maxTrack) {
-			maxTrack = (*m_events[0])[i].track;
+	// write the header of the Standard MIDI File
+	char ch;
+	// 1. The characters "MThd"
+	ch = 'M'; out << ch;
+	ch = 'T'; out << ch;
+	ch = 'h'; out << ch;
+	ch = 'd'; out << ch;
+
+	// 2. write the size of the header (always a "6" stored in unsigned long
+	//    (4 bytes).
+	ulong longdata = 6;
+	writeBigEndianULong(out, longdata);
+
+	// 3. MIDI file format, type 0, 1, or 2
+	ushort shortdata;
+	shortdata = static_cast<ushort>(getNumTracks() == 1 ? 0 : 1);
+	writeBigEndianUShort(out,shortdata);
+
+	// 4. write out the number of tracks.
+	shortdata = static_cast<ushort>(getNumTracks());
+	writeBigEndianUShort(out, shortdata);
+
+	// 5. write out the number of ticks per quarternote. (avoiding SMPTE for now)
+	shortdata = static_cast<ushort>(getTicksPerQuarterNote());
+	writeBigEndianUShort(out, shortdata);
+
+	// now write each track.
+	std::vector<uchar> trackdata;
+	uchar endoftrack[4] = {0, 0xff, 0x2f, 0x00};
+	int i, j, k;
+	int size;
+	for (i=0; i<getNumTracks(); i++) {
+		trackdata.reserve(123456);   // make the track data larger than
+		                             // expected data input
+		trackdata.clear();
+		for (j=0; j<(int)m_events[i]->size(); j++) {
+			if ((*m_events[i])[j].empty()) {
+				// Don't write empty m_events (probably a delete message).
+				continue;
+			}
+			if ((*m_events[i])[j].isEndOfTrack()) {
+				// Suppress end-of-track meta messages (one will be added
+				// automatically after all track data has been written).
+				continue;
+			}
+			writeVLValue((*m_events[i])[j].tick, trackdata);
+			if (((*m_events[i])[j].getCommandByte() == 0xf0) ||
+					((*m_events[i])[j].getCommandByte() == 0xf7)) {
+				// 0xf0 == Complete sysex message (0xf0 is part of the raw MIDI).
+				// 0xf7 == Raw byte message (0xf7 not part of the raw MIDI).
+				// Print the first byte of the message (0xf0 or 0xf7), then
+				// print a VLV length for the rest of the bytes in the message.
+				// In other words, when creating a 0xf0 or 0xf7 MIDI message,
+				// do not insert the VLV byte length yourself, as this code will
+				// do it for you automatically.
+				trackdata.push_back((*m_events[i])[j][0]); // 0xf0 or 0xf7;
+				writeVLValue(((int)(*m_events[i])[j].size())-1, trackdata);
+				for (k=1; k<(int)(*m_events[i])[j].size(); k++) {
+					trackdata.push_back((*m_events[i])[j][k]);
+				}
+			} else {
+				// non-sysex type of message, so just output the
+				// bytes of the message:
+				for (k=0; k<(int)(*m_events[i])[j].size(); k++) {
+					trackdata.push_back((*m_events[i])[j][k]);
+				}
+			}
+		}
+		size = (int)trackdata.size();
+		if ((size < 3) || !((trackdata[size-3] == 0xff)
+				&& (trackdata[size-2] == 0x2f))) {
+			trackdata.push_back(endoftrack[0]);
+			trackdata.push_back(endoftrack[1]);
+			trackdata.push_back(endoftrack[2]);
+			trackdata.push_back(endoftrack[3]);
 		}
-	}
-	int trackCount = maxTrack + 1;
 
-	if (trackCount <= 1) {
-		return;
-	}
+		// now ready to write to MIDI file.
 
-	MidiEventList* olddata = m_events[0];
-	m_events[0] = NULL;
-	m_events.resize(trackCount);
-	for (i=0; i<trackCount; i++) {
-		m_events[i] = new MidiEventList;
-	}
+		// first write the track ID marker "MTrk":
+		ch = 'M'; out << ch;
+		ch = 'T'; out << ch;
+		ch = 'r'; out << ch;
+		ch = 'k'; out << ch;
 
-	for (i=0; i<length; i++) {
-		int trackValue = (*olddata)[i].track;
-		m_events[trackValue]->push_back_no_copy(&(*olddata)[i]);
-	}
+		// A. write the size of the MIDI data to follow:
+		longdata = (int)trackdata.size();
+		writeBigEndianULong(out, longdata);
 
-	olddata->detach();
-	delete olddata;
+		// B. write the actual data
+		out.write((char*)trackdata.data(), trackdata.size());
+	}
 
-	if (oldTimeState == TIME_STATE_DELTA) {
-		makeDeltaTicks();
+	if (oldTimeState == TIME_STATE_ABSOLUTE) {
+		makeAbsoluteTicks();
 	}
 
-	m_theTrackState = TRACK_STATE_SPLIT;
+	return true;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::splitTracksByChannel -- Take the joined tracks and split them
-//   back into their separate track identities.
+// MidiFile::writeBase64 -- Write Standard MIDI file with base64 encoding.
+//    The width parameter can be used to add line breaks.  Zero or negative
+//    width will prevent linebreaks from being added to the data.
+//    Default value: width = 0
 //
 
-void MidiFile::splitTracksByChannel(void) {
-	joinTracks();
-	if (getTrackState() == TRACK_STATE_SPLIT) {
-		return;
-	}
+bool MidiFile::writeBase64(const std::string& filename, int width) {
+	std::fstream output(filename.c_str(), std::ios::binary | std::ios::out);
 
-	int oldTimeState = getTickState();
-	if (oldTimeState == TIME_STATE_DELTA) {
-		makeAbsoluteTicks();
+	if (!output.is_open()) {
+		std::cerr << "Error: could not write: " << filename << std::endl;
+		return false;
 	}
+	m_rwstatus = writeBase64(output, width);
+	output.close();
+	return m_rwstatus;
+}
 
-	int maxTrack = 0;
-	int i;
-	MidiEventList& eventlist = *m_events[0];
-	MidiEventList* olddata = &eventlist;
-	int length = eventlist.size();
-	for (i=0; i<length; i++) {
-		if (eventlist[i].size() == 0) {
-			continue;
-		}
-		if ((eventlist[i][0] & 0xf0) == 0xf0) {
-			// ignore system and meta messages.
-			continue;
-		}
-		if (maxTrack < (eventlist[i][0] & 0x0f)) {
-			maxTrack = eventlist[i][0] & 0x0f;
-		}
-	}
-	int trackCount = maxTrack + 2; // + 1 for expression track
 
-	if (trackCount <= 1) {
-		// only one channel, so don't do anything (leave as Type-0 file).
-		return;
+bool MidiFile::writeBase64(std::ostream& out, int width) {
+	std::stringstream raw;
+	bool status = MidiFile::write(raw);
+	if (!status) {
+		return status;
 	}
-
-	m_events[0] = NULL;
-	m_events.resize(trackCount);
-	for (i=0; i<trackCount; i++) {
-		m_events[i] = new MidiEventList;
+	std::string encoded = MidiFile::base64Encode(raw.str());
+	if (width <= 0) {
+		out << encoded;
+		return status;
 	}
-
-	for (i=0; i<length; i++) {
-		int trackValue = 0;
-		if ((eventlist[i][0] & 0xf0) == 0xf0) {
-			trackValue = 0;
-		} else if (eventlist[i].size() > 0) {
-			trackValue = (eventlist[i][0] & 0x0f) + 1;
+	int length = (int)encoded.size();
+	for (int i=0; i<length; i++) {
+		out << encoded[i];
+		if ((i + 1) % width == 0) {
+			out << "\n";
 		}
-		m_events[trackValue]->push_back_no_copy(&eventlist[i]);
 	}
-
-	olddata->detach();
-	delete olddata;
-
-	if (oldTimeState == TIME_STATE_DELTA) {
-		makeDeltaTicks();
+	if ((length + 1) % width != 0) {
+		out << "\n";
 	}
-
-	m_theTrackState = TRACK_STATE_SPLIT;
+	return status;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::getTrackState -- returns what type of track method
-//     is being used: either TRACK_STATE_JOINED or TRACK_STATE_SPLIT.
+// MidiFile::getBase64 -- Convert the MIDI contents to a base-64 string.
+//     Default value: width = 0
 //
 
-int MidiFile::getTrackState(void) const {
-	return m_theTrackState;
+std::string MidiFile::getBase64(int width) {
+	std::stringstream output;
+	bool status = MidiFile::writeBase64(output, width);
+	if (!status) {
+		return "";
+	} else {
+		return output.str();
+	}
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::hasJoinedTracks -- Returns true if the MidiFile tracks
-//    are in a joined state.
+// MidiFile::writeHex -- print the Standard MIDI file as a list of
+//    ASCII Hex bytes, formatted 25 to a line by default, and
+//    two digits for each hex byte code.  If the input width is 0,
+//    then don't wrap lines.
+//
+//  default value: width=25
 //
 
-int MidiFile::hasJoinedTracks(void) const {
-	return m_theTrackState == TRACK_STATE_JOINED;
+bool MidiFile::writeHex(const std::string& filename, int width) {
+	std::fstream output(filename.c_str(), std::ios::out);
+	if (!output.is_open()) {
+		std::cerr << "Error: could not write: " << filename << std::endl;
+		return false;
+	}
+	m_rwstatus = writeHex(output, width);
+	output.close();
+	return m_rwstatus;
 }
 
-
-
-//////////////////////////////
 //
-// MidiFile::hasSplitTracks -- Returns true if the MidiFile tracks
-//     are in a split state.
+// ostream version of MidiFile::writeHex().
 //
 
-int MidiFile::hasSplitTracks(void) const {
-	return m_theTrackState == TRACK_STATE_SPLIT;
+bool MidiFile::writeHex(std::ostream& out, int width) {
+	std::stringstream tempstream;
+	MidiFile::write(tempstream);
+	int len = (int)tempstream.str().length();
+	int wordcount = 1;
+	int linewidth = width >= 0 ? width : 25;
+	for (int i=0; i<len; i++) {
+		int value = (uchar)tempstream.str()[i];
+		out << std::hex << std::setw(2) << std::setfill('0') << value;
+		if (linewidth) {
+			if (i < len - 1) {
+				out << ((wordcount % linewidth) ? ' ' : '\n');
+			}
+			wordcount++;
+		} else {
+			// print with no line breaks
+			if (i < len - 1) {
+				out << ' ';
+			}
+		}
+	}
+	if (linewidth) {
+		out << '\n';
+	}
+	return true;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::getSplitTrack --  Return the track index when the MidiFile
-//   is in the split state.  This function returns the original track
-//   when the MidiFile is in the joined state.  The MidiEvent::track
-//   variable is used to store the original track index when the
-//   MidiFile is converted to the joined-track state.
+// MidiFile::writeBinasc -- write a standard MIDI file from data into
+//    the binasc format (ASCII version of the MIDI file).
 //
 
-int MidiFile::getSplitTrack(int track, int index) const {
-	if (hasSplitTracks()) {
-		return track;
-	} else {
-		return getEvent(track, index).track;
+bool MidiFile::writeBinasc(const std::string& filename) {
+	std::fstream output(filename.c_str(), std::ios::out);
+
+	if (!output.is_open()) {
+		std::cerr << "Error: could not write: " << filename << std::endl;
+		return false;
 	}
+	m_rwstatus = writeBinasc(output);
+	output.close();
+	return m_rwstatus;
 }
 
 //
-// When the parameter is void, assume track 0:
+// ostream version of MidiFile::writeBinasc().
 //
 
-int MidiFile::getSplitTrack(int index) const {
-	if (hasSplitTracks()) {
-		return 0;
-	} else {
-		return getEvent(0, index).track;
+bool MidiFile::writeBinasc(std::ostream& output) {
+	std::stringstream binarydata;
+	m_rwstatus = write(binarydata);
+	if (m_rwstatus == false) {
+		return false;
 	}
-}
 
+	Binasc binasc;
+	binasc.setMidiOn();
+	binarydata.seekg(0, std::ios_base::beg);
+	binasc.readFromBinary(output, binarydata);
+	return true;
+}
 
 
-///////////////////////////////////////////////////////////////////////////
-//
-// tick-related functions --
-//
 
 //////////////////////////////
 //
-// MidiFile::makeDeltaTicks -- convert the time data to
-//     delta time, which means that the time field
-//     in the MidiEvent struct represents the time
-//     since the last event was played. When a MIDI file
-//     is read from a file, this is the default setting.
+// MidiFile::writeBinascWithComments -- write a standard MIDI
+//    file from data into the binasc format (ASCII version
+//    of the MIDI file), including commentary about the MIDI messages.
 //
 
-void MidiFile::makeDeltaTicks(void) {
-	if (getTickState() == TIME_STATE_DELTA) {
-		return;
-	}
-	int i, j;
-	int temp;
-	int length = getNumTracks();
-	int *timedata = new int[length];
-	for (i=0; i<length; i++) {
-		timedata[i] = 0;
-		if (m_events[i]->size() > 0) {
-			timedata[i] = (*m_events[i])[0].tick;
-		} else {
-			continue;
-		}
-		for (j=1; j<(int)m_events[i]->size(); j++) {
-			temp = (*m_events[i])[j].tick;
-			int deltatick = temp - timedata[i];
-			if (deltatick < 0) {
-				std::cerr << "Error: negative delta tick value: " << deltatick << std::endl
-				     << "Timestamps must be sorted first"
-				     << " (use MidiFile::sortTracks() before writing)." << std::endl;
-			}
-			(*m_events[i])[j].tick = deltatick;
-			timedata[i] = temp;
-		}
+bool MidiFile::writeBinascWithComments(const std::string& filename) {
+	std::fstream output(filename.c_str(), std::ios::out);
+
+	if (!output.is_open()) {
+		std::cerr << "Error: could not write: " << filename << std::endl;
+		return 0;
 	}
-	m_theTimeState = TIME_STATE_DELTA;
-	delete [] timedata;
+	m_rwstatus = writeBinascWithComments(output);
+	output.close();
+	return m_rwstatus;
 }
 
 //
-// MidiFile::deltaTicks -- Alias for MidiFile::makeDeltaTicks().
+// ostream version of MidiFile::writeBinascWithComments().
 //
 
-void MidiFile::deltaTicks(void) {
-	makeDeltaTicks();
+bool MidiFile::writeBinascWithComments(std::ostream& output) {
+	std::stringstream binarydata;
+	m_rwstatus = write(binarydata);
+	if (m_rwstatus == false) {
+		return false;
+	}
+
+	Binasc binasc;
+	binasc.setMidiOn();
+	binasc.setCommentsOn();
+	binarydata.seekg(0, std::ios_base::beg);
+	binasc.readFromBinary(output, binarydata);
+	return true;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::makeAbsoluteTicks -- convert the time data to
-//    absolute time, which means that the time field
-//    in the MidiEvent struct represents the exact tick
-//    time to play the event rather than the time since
-//    the last event to wait until playing the current
-//    event.
+// MidiFile::status -- return the success flag from the last read or
+//    write (writeHex, writeBinasc).
 //
 
-void MidiFile::makeAbsoluteTicks(void) {
-	if (getTickState() == TIME_STATE_ABSOLUTE) {
-		return;
-	}
-	int i, j;
-	int length = getNumTracks();
-	int* timedata = new int[length];
-	for (i=0; i<length; i++) {
-		timedata[i] = 0;
-		if (m_events[i]->size() > 0) {
-			timedata[i] = (*m_events[i])[0].tick;
-		} else {
-			continue;
-		}
-		for (j=1; j<(int)m_events[i]->size(); j++) {
-			timedata[i] += (*m_events[i])[j].tick;
-			(*m_events[i])[j].tick = timedata[i];
-		}
-	}
-	m_theTimeState = TIME_STATE_ABSOLUTE;
-	delete [] timedata;
+bool MidiFile::status(void) const {
+	return m_rwstatus;
 }
 
+
+///////////////////////////////////////////////////////////////////////////
 //
-// MidiFile::absoluteTicks -- Alias for MidiFile::makeAbsoluteTicks().
+// track-related functions --
 //
 
-void MidiFile::absoluteTicks(void) {
-	makeAbsoluteTicks();
+//////////////////////////////
+//
+// MidiFile::operator[] -- return the event list for the specified track.
+//
+
+MidiEventList& MidiFile::operator[](int aTrack) {
+	loadTrack(aTrack);
+	return *m_events[aTrack];
 }
 
+const MidiEventList& MidiFile::operator[](int aTrack) const {
+	loadTrack(aTrack);
+	return *m_events[aTrack];
+}
 
 
 //////////////////////////////
 //
-// MidiFile::getTickState -- returns what type of time method is
-//   being used: either TIME_STATE_ABSOLUTE or TIME_STATE_DELTA.
+// MidiFile::getTrackCount -- return the number of tracks in
+//   the Midi File.
 //
 
-int MidiFile::getTickState(void) const {
-	return m_theTimeState;
+int MidiFile::getTrackCount(void) const {
+	return (int)m_events.size();
 }
 
+//
+// Alias for getTrackCount()
+//
 
+int MidiFile::getNumTracks(void) const {
+	return getTrackCount();
+}
 
-//////////////////////////////
 //
-// MidiFile::isDeltaTicks -- Returns true if MidiEvent .tick
-//    variables are in delta time mode.
+// Alias for getTrackCount()
 //
 
-bool MidiFile::isDeltaTicks(void) const {
-	return m_theTimeState == TIME_STATE_DELTA ? true : false;
+int MidiFile::size(void) const {
+	return getTrackCount();
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::isAbsoluteTicks -- Returns true if MidiEvent .tick
-//    variables are in absolute time mode.
+// MidiFile::removeEmpties -- Remove any MIDI message that
+//     contains no bytes.
 //
 
-bool MidiFile::isAbsoluteTicks(void) const {
-	return m_theTimeState == TIME_STATE_ABSOLUTE ? true : false;
+void MidiFile::removeEmpties(void) {
+	loadTracks();
+	for (auto &event : m_events) {
+		event->removeEmpties();
+	}
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::getFileDurationInTicks -- Returns the largest
-//    tick value in any track.  The tracks must be sorted
-//    before calling this function, since this function
-//    assumes that the last MidiEvent in the track has the
-//    highest tick timestamp.  The file state can be in delta
-//    ticks since this function will temporarily go to absolute
-//    tick mode for the calculation of the max tick.
-//
-
-int MidiFile::getFileDurationInTicks(void) {
-	bool revertToDelta = false;
-	if (isDeltaTicks()) {
-		makeAbsoluteTicks();
-		revertToDelta = true;
-	}
-	const MidiFile& mf = *this;
-	int output = 0;
-	for (int i=0; i<mf.getTrackCount(); i++) {
-		if (mf[i].back().tick > output) {
-			output = mf[i].back().tick;
-		}
-	}
-	if (revertToDelta) {
-		deltaTicks();
+// MidiFile::markSequence -- Assign a sequence serial number to
+//   every MidiEvent in every track in the MIDI file.  This is
+//   useful if you want to preseve the order of MIDI messages in
+//   a track when they occur at the same tick time.  Particularly
+//   for use with joinTracks() or sortTracks().  markSequence will
+//   be done automatically when a MIDI file is read, in case the
+//   ordering of m_events occurring at the same time is important.
+//   Use clearSequence() to use the default sorting behavior of
+//   sortTracks().
+//
+
+void MidiFile::markSequence(void) {
+	int sequence = 1;
+	for (int i=0; i<getTrackCount(); i++) {
+		sequence = operator[](i).markSequence(sequence);
 	}
-	return output;
 }
 
-
-
-///////////////////////////////
 //
-// MidiFile::getFileDurationInQuarters -- Returns the Duration of the MidiFile
-//    in units of quarter notes.  If the MidiFile is in delta tick mode,
-//    then temporarily got into absolute tick mode to do the calculations.
-//    Note that this is expensive, so you should normally call this function
-//    while in absolute tick (default) mode.
+// MidiFile::markSequence -- default value: sequence = 1.
 //
 
-double MidiFile::getFileDurationInQuarters(void) {
-	return (double)getFileDurationInTicks() / (double)getTicksPerQuarterNote();
+void MidiFile::markSequence(int track, int sequence) {
+	if ((track >= 0) && (track < getTrackCount())) {
+		operator[](track).markSequence(sequence);
+	} else {
+		std::cerr << "Warning: track " << track << " does not exist." << std::endl;
+	}
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::getFileDurationInSeconds -- returns the duration of the
-//    longest track in the file.  The tracks must be sorted before
-//    calling this function, since this function assumes that the
-//    last MidiEvent in the track has the highest timestamp.
-//    The file state can be in delta ticks since this function
-//    will temporarily go to absolute tick mode for the calculation
-//    of the max time.
+// MidiFile::clearSequence -- Remove any sequence serial numbers from
+//   MidiEvents in the MidiFile.  This will cause the default ordering by
+//   sortTracks() to be used, in which case the ordering of MidiEvents
+//   occurring at the same tick may switch their ordering.
+//
 
-double MidiFile::getFileDurationInSeconds(void) {
-	if (m_timemapvalid == 0) {
-		buildTimeMap();
-		if (m_timemapvalid == 0) {
-			return -1.0;    // something went wrong
-		}
-	}
-	bool revertToDelta = false;
-	if (isDeltaTicks()) {
-		makeAbsoluteTicks();
-		revertToDelta = true;
-	}
-	const MidiFile& mf = *this;
-	double output = 0.0;
-	for (int i=0; i<mf.getTrackCount(); i++) {
-		if (mf[i].back().seconds > output) {
-			output = mf[i].back().seconds;
-		}
-	}
-	if (revertToDelta) {
-		deltaTicks();
+void MidiFile::clearSequence(void) {
+	for (int i=0; i<getTrackCount(); i++) {
+		operator[](i).clearSequence();
 	}
-	return output;
 }
 
 
-///////////////////////////////////////////////////////////////////////////
-//
-// physical-time analysis functions --
-//
-
-//////////////////////////////
-//
-// MidiFile::doTimeAnalysis -- Identify the real-time position of
-//    all events by monitoring the tempo in relations to the tick
-//    times in the file.
-//
-
-void MidiFile::doTimeAnalysis(void) {
-	buildTimeMap();
+void MidiFile::clearSequence(int track) {
+	if ((track >= 0) && (track < getTrackCount())) {
+		operator[](track).clearSequence();
+	} else {
+		std::cerr << "Warning: track " << track << " does not exist." << std::endl;
+	}
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::getTimeInSeconds -- return the time in seconds for
-//     the current message.
+// MidiFile::joinTracks -- Interleave the data from all tracks,
+//   but keeping the identity of the tracks unique so that
+//   the function splitTracks can be called to split the
+//   tracks into separate units again.  The style of the
+//   MidiFile when read from a file is with tracks split.
+//   The original track index is stored in the MidiEvent::track
+//   variable.
 //
 
-double MidiFile::getTimeInSeconds(int aTrack, int anIndex) {
-	return getTimeInSeconds(getEvent(aTrack, anIndex).tick);
-}
+void MidiFile::joinTracks(void) {
+	loadTracks();
+	if (getTrackState() == TRACK_STATE_JOINED) {
+		return;
+	}
+	if (getNumTracks() == 1) {
+		m_theTrackState = TRACK_STATE_JOINED;
+		return;
+	}
 
+	MidiEventList* joinedTrack;
+	joinedTrack = new MidiEventList;
 
-double MidiFile::getTimeInSeconds(int tickvalue) {
-	if (m_timemapvalid == 0) {
-		buildTimeMap();
-		if (m_timemapvalid == 0) {
-			return -1.0;    // something went wrong
-		}
+	int messagesum = 0;
+	int length = getNumTracks();
+	int i, j;
+	for (i=0; i<length; i++) {
+		messagesum += (*m_events[i]).size();
 	}
+	joinedTrack->reserve((int)(messagesum + 32 + messagesum * 0.1));
 
-	_TickTime key;
-	key.tick    = tickvalue;
-	key.seconds = -1;
+	int oldTimeState = getTickState();
+	if (oldTimeState == TIME_STATE_DELTA) {
+		makeAbsoluteTicks();
+	}
+	for (i=0; i<length; i++) {
+		for (j=0; j<(int)m_events[i]->size(); j++) {
+			joinedTrack->push_back_no_copy(&(*m_events[i])[j]);
+		}
+	}
 
-	void* ptr = bsearch(&key, m_timemap.data(), m_timemap.size(),
-			sizeof(_TickTime), ticksearch);
+	clear_no_deallocate();
 
-	if (ptr == NULL) {
-		// The specific tick value was not found, so do a linear
-		// search for the two tick values which occur before and
-		// after the tick value, and do a linear interpolation of
-		// the time in seconds values to figure out the final
-		// time in seconds.
-		// Since the code is not yet written, kill the program at this point:
-		return linearSecondInterpolationAtTick(tickvalue);
-	} else {
-		return ((_TickTime*)ptr)->seconds;
+	delete m_events[0];
+	m_events.resize(0);
+	m_events.push_back(joinedTrack);
+	sortTracks();
+	if (oldTimeState == TIME_STATE_DELTA) {
+		makeDeltaTicks();
 	}
+
+	m_theTrackState = TRACK_STATE_JOINED;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::getAbsoluteTickTime -- return the tick value represented
-//    by the input time in seconds.  If there is not tick entry at
-//    the given time in seconds, then interpolate between two values.
+// MidiFile::splitTracks -- Take the joined tracks and split them
+//   back into their separate track identities.
 //
 
-double MidiFile::getAbsoluteTickTime(double starttime) {
-	if (m_timemapvalid == 0) {
-		buildTimeMap();
-		if (m_timemapvalid == 0) {
-			return -1.0;    // something went wrong
+void MidiFile::splitTracks(void) {
+	loadTracks();
+	if (getTrackState() == TRACK_STATE_SPLIT) {
+		return;
+	}
+	int oldTimeState = getTickState();
+	if (oldTimeState == TIME_STATE_DELTA) {
+		makeAbsoluteTicks();
+	}
+
+	int maxTrack = 0;
+	int i;
+	int length = m_events[0]->size();
+	for (i=0; i<length; i++) {
+		if ((*m_events[0])[i].track > maxTrack) {
+			maxTrack = (*m_events[0])[i].track;
 		}
 	}
+	int trackCount = maxTrack + 1;
 
-	_TickTime key;
-	key.tick    = -1;
-	key.seconds = starttime;
+	if (trackCount <= 1) {
+		return;
+	}
 
-	void* ptr = bsearch(&key, m_timemap.data(), m_timemap.size(),
-			sizeof(_TickTime), secondsearch);
+	MidiEventList* olddata = m_events[0];
+	m_events[0] = NULL;
+	m_events.resize(trackCount);
+	for (i=0; i<trackCount; i++) {
+		m_events[i] = new MidiEventList;
+	}
 
-	if (ptr == NULL) {
-		// The specific seconds value was not found, so do a linear
-		// search for the two time values which occur before and
-		// after the given time value, and do a linear interpolation of
-		// the time in tick values to figure out the final time in ticks.
-		return linearTickInterpolationAtSecond(starttime);
-	} else {
-		return ((_TickTime*)ptr)->tick;
+	for (i=0; i<length; i++) {
+		int trackValue = (*olddata)[i].track;
+		m_events[trackValue]->push_back_no_copy(&(*olddata)[i]);
 	}
 
-}
+	olddata->detach();
+	delete olddata;
 
+	if (oldTimeState == TIME_STATE_DELTA) {
+		makeDeltaTicks();
+	}
+
+	m_theTrackState = TRACK_STATE_SPLIT;
+}
 
 
-///////////////////////////////////////////////////////////////////////////
-//
-// note-analysis functions --
-//
 
 //////////////////////////////
 //
-// MidiFile::linkNotePairs --  Link note-ons to note-offs separately
-//     for each track.  Returns the total number of note message pairs
-//     that were linked.
+// MidiFile::splitTracksByChannel -- Take the joined tracks and split them
+//   back into their separate track identities.
 //
 
-int MidiFile::linkNotePairsFIFO(void) {
-	int i;
-	int sum = 0;
-	for (i=0; i<getTrackCount(); i++) {
-		if (m_events[i] == NULL) {
-			continue;
-		}
-		sum += m_events[i]->linkNotePairsFIFO();
+void MidiFile::splitTracksByChannel(void) {
+	loadTracks();
+	joinTracks();
+	if (getTrackState() == TRACK_STATE_SPLIT) {
+		return;
 	}
-	m_linkedEventsQ = true;
-	return sum;
-}
-
 
-int MidiFile::linkNotePairsLIFO(void) {
+	int oldTimeState = getTickState();
+	if (oldTimeState == TIME_STATE_DELTA) {
+		makeAbsoluteTicks();
+	}
+
+	int maxTrack = 0;
 	int i;
-	int sum = 0;
-	for (i=0; i<getTrackCount(); i++) {
-		if (m_events[i] == NULL) {
+	MidiEventList& eventlist = *m_events[0];
+	MidiEventList* olddata = &eventlist;
+	int length = eventlist.size();
+	for (i=0; i<length; i++) {
+		if (eventlist[i].size() == 0) {
 			continue;
 		}
-		sum += m_events[i]->linkNotePairsLIFO();
+		if ((eventlist[i][0] & 0xf0) == 0xf0) {
+			// ignore system and meta messages.
+			continue;
+		}
+		if (maxTrack < (eventlist[i][0] & 0x0f)) {
+			maxTrack = eventlist[i][0] & 0x0f;
+		}
 	}
-	m_linkedEventsQ = true;
-	return sum;
-}
+	int trackCount = maxTrack + 2; // + 1 for expression track
 
-//
-// MidiFile::linkEventPairs -- Alias for MidiFile::linkNotePairs().
-//
+	if (trackCount <= 1) {
+		// only one channel, so don't do anything (leave as Type-0 file).
+		return;
+	}
 
-int MidiFile::linkEventPairs(void) {
-	return linkNotePairsFIFO();
+	m_events[0] = NULL;
+	m_events.resize(trackCount);
+	for (i=0; i<trackCount; i++) {
+		m_events[i] = new MidiEventList;
+	}
+
+	for (i=0; i<length; i++) {
+		int trackValue = 0;
+		if ((eventlist[i][0] & 0xf0) == 0xf0) {
+			trackValue = 0;
+		} else if (eventlist[i].size() > 0) {
+			trackValue = (eventlist[i][0] & 0x0f) + 1;
+		}
+		m_events[trackValue]->push_back_no_copy(&eventlist[i]);
+	}
+
+	olddata->detach();
+	delete olddata;
+
+	if (oldTimeState == TIME_STATE_DELTA) {
+		makeDeltaTicks();
+	}
+
+	m_theTrackState = TRACK_STATE_SPLIT;
 }
 
 
-///////////////////////////////////////////////////////////////////////////
-//
-// filename functions --
-//
 
 //////////////////////////////
 //
-// MidiFile::setFilename -- sets the filename of the MIDI file.
-//      Currently removed any directory path.
+// MidiFile::getTrackState -- returns what type of track method
+//     is being used: either TRACK_STATE_JOINED or TRACK_STATE_SPLIT.
 //
 
-void MidiFile::setFilename(const std::string& aname) {
-	auto loc = aname.rfind('/');
-	if (loc != std::string::npos) {
-		m_readFileName = aname.substr(loc+1);
-	} else {
-		m_readFileName = aname;
-	}
+int MidiFile::getTrackState(void) const {
+	return m_theTrackState;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::getFilename -- returns the name of the file read into the
-//    structure (if the data was read from a file).
+// MidiFile::hasJoinedTracks -- Returns true if the MidiFile tracks
+//    are in a joined state.
 //
 
-const char* MidiFile::getFilename(void) const {
-	return m_readFileName.c_str();
+int MidiFile::hasJoinedTracks(void) const {
+	return m_theTrackState == TRACK_STATE_JOINED;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::addEvent --
+// MidiFile::hasSplitTracks -- Returns true if the MidiFile tracks
+//     are in a split state.
 //
 
-MidiEvent* MidiFile::addEvent(int aTrack, int aTick,
-		std::vector<uchar>& midiData) {
-	m_timemapvalid = 0;
-	MidiEvent* me = new MidiEvent;
-	me->tick = aTick;
-	me->track = aTrack;
-	me->setMessage(midiData);
-	m_events[aTrack]->push_back_no_copy(me);
-	return me;
+int MidiFile::hasSplitTracks(void) const {
+	return m_theTrackState == TRACK_STATE_SPLIT;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::addEvent -- Some bug here when joinedTracks(), but track==1...
+// MidiFile::getSplitTrack --  Return the track index when the MidiFile
+//   is in the split state.  This function returns the original track
+//   when the MidiFile is in the joined state.  The MidiEvent::track
+//   variable is used to store the original track index when the
+//   MidiFile is converted to the joined-track state.
 //
 
-MidiEvent* MidiFile::addEvent(MidiEvent& mfevent) {
-	if (getTrackState() == TRACK_STATE_JOINED) {
-		m_events[0]->push_back(mfevent);
-		return &m_events[0]->back();
+int MidiFile::getSplitTrack(int track, int index) const {
+	if (hasSplitTracks()) {
+		return track;
 	} else {
-		m_events.at(mfevent.track)->push_back(mfevent);
-		return &m_events.at(mfevent.track)->back();
+		return getEvent(track, index).track;
 	}
 }
 
 //
-// Variant where the track is an input parameter:
+// When the parameter is void, assume track 0:
 //
 
-MidiEvent* MidiFile::addEvent(int aTrack, MidiEvent& mfevent) {
-	if (getTrackState() == TRACK_STATE_JOINED) {
-		m_events[0]->push_back(mfevent);
-      m_events[0]->back().track = aTrack;
-		return &m_events[0]->back();
+int MidiFile::getSplitTrack(int index) const {
+	if (hasSplitTracks()) {
+		return 0;
 	} else {
-		m_events.at(aTrack)->push_back(mfevent);
-		m_events.at(aTrack)->back().track = aTrack;
-		return &m_events.at(aTrack)->back();
+		return getEvent(0, index).track;
 	}
 }
 
 
 
-///////////////////////////////
+///////////////////////////////////////////////////////////////////////////
 //
-// MidiFile::addMetaEvent --
+// tick-related functions --
 //
 
-MidiEvent* MidiFile::addMetaEvent(int aTrack, int aTick, int aType,
-		std::vector<uchar>& metaData) {
-	m_timemapvalid = 0;
-	int i;
-	int length = (int)metaData.size();
-	std::vector<uchar> fulldata;
-	uchar size[23] = {0};
-	int lengthsize = makeVLV(size, length);
+//////////////////////////////
+//
+// MidiFile::makeDeltaTicks -- convert the time data to
+//     delta time, which means that the time field
+//     in the MidiEvent struct represents the time
+//     since the last event was played. When a MIDI file
+//     is read from a file, this is the default setting.
+//
 
-	fulldata.resize(2+lengthsize+length);
-	fulldata[0] = 0xff;
-	fulldata[1] = aType & 0x7F;
-	for (i=0; i<lengthsize; i++) {
-		fulldata[2+i] = size[i];
+void MidiFile::makeDeltaTicks(void) {
+	loadTracks();
+	if (getTickState() == TIME_STATE_DELTA) {
+		return;
 	}
+	int i, j;
+	int temp;
+	int length = getNumTracks();
+	int *timedata = new int[length];
 	for (i=0; i<length; i++) {
-		fulldata[2+lengthsize+i] = metaData[i];
+		timedata[i] = 0;
+		if (m_events[i]->size() > 0) {
+			timedata[i] = (*m_events[i])[0].tick;
+		} else {
+			continue;
+		}
+		for (j=1; j<(int)m_events[i]->size(); j++) {
+			temp = (*m_events[i])[j].tick;
+			int deltatick = temp - timedata[i];
+			if (deltatick < 0) {
+				std::cerr << "Error: negative delta tick value: " << deltatick << std::endl
+				     << "Timestamps must be sorted first"
+				     << " (use MidiFile::sortTracks() before writing)." << std::endl;
+			}
+			(*m_events[i])[j].tick = deltatick;
+			timedata[i] = temp;
+		}
 	}
-
-	return addEvent(aTrack, aTick, fulldata);
+	m_theTimeState = TIME_STATE_DELTA;
+	delete [] timedata;
 }
 
+//
+// MidiFile::deltaTicks -- Alias for MidiFile::makeDeltaTicks().
+//
 
-MidiEvent* MidiFile::addMetaEvent(int aTrack, int aTick, int aType,
-		const std::string& metaData) {
-	int length = (int)metaData.size();
-	std::vector<uchar> buffer;
-	buffer.resize(length);
-	int i;
-	for (i=0; i<length; i++) {
-		buffer[i] = (uchar)metaData[i];
-	}
-	return addMetaEvent(aTrack, aTick, aType, buffer);
+void MidiFile::deltaTicks(void) {
+	makeDeltaTicks();
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::addText --  Add a text meta-message (#1).
+// MidiFile::makeAbsoluteTicks -- convert the time data to
+//    absolute time, which means that the time field
+//    in the MidiEvent struct represents the exact tick
+//    time to play the event rather than the time since
+//    the last event to wait until playing the current
+//    event.
 //
 
-MidiEvent* MidiFile::addText(int aTrack, int aTick, const std::string& text) {
-	MidiEvent* me = new MidiEvent;
-	me->makeText(text);
-	me->tick = aTick;
-	m_events[aTrack]->push_back_no_copy(me);
-	return me;
+void MidiFile::makeAbsoluteTicks(void) {
+	if (getTickState() == TIME_STATE_ABSOLUTE) {
+		return;
+	}
+	int i, j;
+	int length = getNumTracks();
+	int* timedata = new int[length];
+	for (i=0; i<length; i++) {
+		timedata[i] = 0;
+		if (m_events[i]->size() > 0) {
+			timedata[i] = (*m_events[i])[0].tick;
+		} else {
+			continue;
+		}
+		for (j=1; j<(int)m_events[i]->size(); j++) {
+			timedata[i] += (*m_events[i])[j].tick;
+			(*m_events[i])[j].tick = timedata[i];
+		}
+	}
+	m_theTimeState = TIME_STATE_ABSOLUTE;
+	delete [] timedata;
 }
 
-
-
-//////////////////////////////
 //
-// MidiFile::addCopyright --  Add a copyright notice meta-message (#2).
+// MidiFile::absoluteTicks -- Alias for MidiFile::makeAbsoluteTicks().
 //
 
-MidiEvent* MidiFile::addCopyright(int aTrack, int aTick, const std::string& text) {
-	MidiEvent* me = new MidiEvent;
-	me->makeCopyright(text);
-	me->tick = aTick;
-	m_events[aTrack]->push_back_no_copy(me);
-	return me;
+void MidiFile::absoluteTicks(void) {
+	makeAbsoluteTicks();
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::addTrackName --  Add an track name meta-message (#3).
+// MidiFile::getTickState -- returns what type of time method is
+//   being used: either TIME_STATE_ABSOLUTE or TIME_STATE_DELTA.
 //
 
-MidiEvent* MidiFile::addTrackName(int aTrack, int aTick, const std::string& name) {
-	MidiEvent* me = new MidiEvent;
-	me->makeTrackName(name);
-	me->tick = aTick;
-	m_events[aTrack]->push_back_no_copy(me);
-	return me;
+int MidiFile::getTickState(void) const {
+	return m_theTimeState;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::addInstrumentName --  Add an instrument name meta-message (#4).
+// MidiFile::isDeltaTicks -- Returns true if MidiEvent .tick
+//    variables are in delta time mode.
 //
 
-MidiEvent* MidiFile::addInstrumentName(int aTrack, int aTick,
-		const std::string& name) {
-	MidiEvent* me = new MidiEvent;
-	me->makeInstrumentName(name);
-	me->tick = aTick;
-	m_events[aTrack]->push_back_no_copy(me);
-	return me;
+bool MidiFile::isDeltaTicks(void) const {
+	return m_theTimeState == TIME_STATE_DELTA ? true : false;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::addLyric -- Add a lyric meta-message (meta #5).
+// MidiFile::isAbsoluteTicks -- Returns true if MidiEvent .tick
+//    variables are in absolute time mode.
 //
 
-MidiEvent* MidiFile::addLyric(int aTrack, int aTick, const std::string& text) {
-	MidiEvent* me = new MidiEvent;
-	me->makeLyric(text);
-	me->tick = aTick;
-	m_events[aTrack]->push_back_no_copy(me);
-	return me;
+bool MidiFile::isAbsoluteTicks(void) const {
+	return m_theTimeState == TIME_STATE_ABSOLUTE ? true : false;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::addMarker -- Add a marker meta-message (meta #6).
+// MidiFile::getFileDurationInTicks -- Returns the largest
+//    tick value in any track.  The tracks must be sorted
+//    before calling this function, since this function
+//    assumes that the last MidiEvent in the track has the
+//    highest tick timestamp.  The file state can be in delta
+//    ticks since this function will temporarily go to absolute
+//    tick mode for the calculation of the max tick.
 //
 
-MidiEvent* MidiFile::addMarker(int aTrack, int aTick, const std::string& text) {
-	MidiEvent* me = new MidiEvent;
-	me->makeMarker(text);
-	me->tick = aTick;
-	m_events[aTrack]->push_back_no_copy(me);
-	return me;
+int MidiFile::getFileDurationInTicks(void) {
+	bool revertToDelta = false;
+	if (isDeltaTicks()) {
+		makeAbsoluteTicks();
+		revertToDelta = true;
+	}
+	const MidiFile& mf = *this;
+	int output = 0;
+	for (int i=0; i<mf.getTrackCount(); i++) {
+		if (mf[i].back().tick > output) {
+			output = mf[i].back().tick;
+		}
+	}
+	if (revertToDelta) {
+		deltaTicks();
+	}
+	return output;
 }
 
 
 
-//////////////////////////////
+///////////////////////////////
 //
-// MidiFile::addCue -- Add a cue-point meta-message (meta #7).
+// MidiFile::getFileDurationInQuarters -- Returns the Duration of the MidiFile
+//    in units of quarter notes.  If the MidiFile is in delta tick mode,
+//    then temporarily got into absolute tick mode to do the calculations.
+//    Note that this is expensive, so you should normally call this function
+//    while in absolute tick (default) mode.
 //
 
-MidiEvent* MidiFile::addCue(int aTrack, int aTick, const std::string& text) {
-	MidiEvent* me = new MidiEvent;
-	me->makeCue(text);
-	me->tick = aTick;
-	m_events[aTrack]->push_back_no_copy(me);
-	return me;
+double MidiFile::getFileDurationInQuarters(void) {
+	return (double)getFileDurationInTicks() / (double)getTicksPerQuarterNote();
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::addTempo -- Add a tempo meta message (meta #0x51).
-//
+// MidiFile::getFileDurationInSeconds -- returns the duration of the
+//    longest track in the file.  The tracks must be sorted before
+//    calling this function, since this function assumes that the
+//    last MidiEvent in the track has the highest timestamp.
+//    The file state can be in delta ticks since this function
+//    will temporarily go to absolute tick mode for the calculation
+//    of the max time.
 
-MidiEvent* MidiFile::addTempo(int aTrack, int aTick, double aTempo) {
-	MidiEvent* me = new MidiEvent;
-	me->makeTempo(aTempo);
-	me->tick = aTick;
-	m_events[aTrack]->push_back_no_copy(me);
-	return me;
+double MidiFile::getFileDurationInSeconds(void) {
+	if (m_timemapvalid == 0) {
+		buildTimeMap();
+		if (m_timemapvalid == 0) {
+			return -1.0;    // something went wrong
+		}
+	}
+	bool revertToDelta = false;
+	if (isDeltaTicks()) {
+		makeAbsoluteTicks();
+		revertToDelta = true;
+	}
+	const MidiFile& mf = *this;
+	double output = 0.0;
+	for (int i=0; i<mf.getTrackCount(); i++) {
+		if (mf[i].back().seconds > output) {
+			output = mf[i].back().seconds;
+		}
+	}
+	if (revertToDelta) {
+		deltaTicks();
+	}
+	return output;
 }
 
 
-
-//////////////////////////////
-//
-// MidiFile::addKeySignature -- Add a key signature meta message
-//      (meta #0x59).
-//
-// Default values:
-//      fifths ==  0 (C)
-//      mode   ==  0 (major)
+///////////////////////////////////////////////////////////////////////////
 //
-// Key signature of b minor would be:
-//      fifths = 2
-//      mode   = 1
+// physical-time analysis functions --
 //
 
-MidiEvent* MidiFile::addKeySignature (int aTrack, int aTick, int fifths, bool mode) {
-    MidiEvent* me = new MidiEvent;
-    me->makeKeySignature(fifths, mode);
-    me->tick = aTick;
-    m_events[aTrack]->push_back_no_copy(me);
-    return me;
-}
-
-
-
 //////////////////////////////
 //
-// MidiFile::addTimeSignature -- Add a time signature meta message
-//      (meta #0x58).  The "bottom" parameter must be a power of two;
-//      otherwise, it will be set to the next highest power of two.
-//
-// Default values:
-//     clocksPerClick     == 24 (quarter note)
-//     num32ndsPerQuarter ==  8 (8 32nds per quarter note)
-//
-// Time signature of 4/4 would be:
-//    top    = 4
-//    bottom = 4 (converted to 2 in the MIDI file for 2nd power of 2).
-//    clocksPerClick = 24 (2 eighth notes based on num32ndsPerQuarter)
-//    num32ndsPerQuarter = 8
-//
-// Time signature of 6/8 would be:
-//    top    = 6
-//    bottom = 8 (converted to 3 in the MIDI file for 3rd power of 2).
-//    clocksPerClick = 36 (3 eighth notes based on num32ndsPerQuarter)
-//    num32ndsPerQuarter = 8
+// MidiFile::doTimeAnalysis -- Identify the real-time position of
+//    all events by monitoring the tempo in relations to the tick
+//    times in the file.
 //
 
-MidiEvent* MidiFile::addTimeSignature(int aTrack, int aTick, int top, int bottom,
-		int clocksPerClick, int num32ndsPerQuarter) {
-	MidiEvent* me = new MidiEvent;
-	me->makeTimeSignature(top, bottom, clocksPerClick, num32ndsPerQuarter);
-	me->tick = aTick;
-	m_events[aTrack]->push_back_no_copy(me);
-	return me;
+void MidiFile::doTimeAnalysis(void) {
+	buildTimeMap();
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::addCompoundTimeSignature -- Add a time signature meta message
-//      (meta #0x58), where the clocksPerClick parameter is set to three
-//      eighth notes for compound meters such as 6/8 which represents
-//      two beats per measure.
-//
-// Default values:
-//     clocksPerClick     == 36 (quarter note)
-//     num32ndsPerQuarter ==  8 (8 32nds per quarter note)
+// MidiFile::getTimeInSeconds -- return the time in seconds for
+//     the current message.
 //
 
-MidiEvent* MidiFile::addCompoundTimeSignature(int aTrack, int aTick, int top,
-		int bottom, int clocksPerClick, int num32ndsPerQuarter) {
-	return addTimeSignature(aTrack, aTick, top, bottom, clocksPerClick,
-		num32ndsPerQuarter);
+double MidiFile::getTimeInSeconds(int aTrack, int anIndex) {
+	return getTimeInSeconds(getEvent(aTrack, anIndex).tick);
 }
 
 
-
-//////////////////////////////
-//
-// MidiFile::makeVLV --  This function is used to create
-//   size byte(s) for meta-messages.  If the size of the data
-//   in the meta-message is greater than 127, then the size
-//   should (?) be specified as a VLV.
-//
-
-int MidiFile::makeVLV(uchar *buffer, int number) {
-
-	unsigned long value = (unsigned long)number;
-
-	if (value >= (1 << 28)) {
-		std::cerr << "Error: Meta-message size too large to handle" << std::endl;
-		buffer[0] = 0;
-		buffer[1] = 0;
-		buffer[2] = 0;
-		buffer[3] = 0;
-		return 1;
-	}
-
-	buffer[0] = (value >> 21) & 0x7f;
-	buffer[1] = (value >> 14) & 0x7f;
-	buffer[2] = (value >>  7) & 0x7f;
-	buffer[3] = (value >>  0) & 0x7f;
-
-	int i;
-	int flag = 0;
-	int length = -1;
-	for (i=0; i<3; i++) {
-		if (buffer[i] != 0) {
-			flag = 1;
-		}
-		if (flag) {
-			buffer[i] |= 0x80;
-		}
-		if (length == -1 && buffer[i] >= 0x80) {
-			length = 4-i;
+double MidiFile::getTimeInSeconds(int tickvalue) {
+	if (m_timemapvalid == 0) {
+		buildTimeMap();
+		if (m_timemapvalid == 0) {
+			return -1.0;    // something went wrong
 		}
 	}
 
-	if (length == -1) {
-		length = 1;
-	}
+	_TickTime key;
+	key.tick    = tickvalue;
+	key.seconds = -1;
 
-	if (length < 4) {
-		for (i=0; i<length; i++) {
-			buffer[i] = buffer[4-length+i];
-		}
-	}
+	void* ptr = bsearch(&key, m_timemap.data(), m_timemap.size(),
+			sizeof(_TickTime), ticksearch);
 
-	return length;
+	if (ptr == NULL) {
+		// The specific tick value was not found, so do a linear
+		// search for the two tick values which occur before and
+		// after the tick value, and do a linear interpolation of
+		// the time in seconds values to figure out the final
+		// time in seconds.
+		// Since the code is not yet written, kill the program at this point:
+		return linearSecondInterpolationAtTick(tickvalue);
+	} else {
+		return ((_TickTime*)ptr)->seconds;
+	}
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::addNoteOn -- Add a note-on message to the given track at the
-//    given time in the given channel.
+// MidiFile::getAbsoluteTickTime -- return the tick value represented
+//    by the input time in seconds.  If there is not tick entry at
+//    the given time in seconds, then interpolate between two values.
 //
 
-MidiEvent* MidiFile::addNoteOn(int aTrack, int aTick, int aChannel, int key, int vel) {
-	MidiEvent* me = new MidiEvent;
-	me->makeNoteOn(aChannel, key, vel);
-	me->tick = aTick;
-	m_events[aTrack]->push_back_no_copy(me);
-	return me;
+double MidiFile::getAbsoluteTickTime(double starttime) {
+	if (m_timemapvalid == 0) {
+		buildTimeMap();
+		if (m_timemapvalid == 0) {
+			return -1.0;    // something went wrong
+		}
+	}
+
+	_TickTime key;
+	key.tick    = -1;
+	key.seconds = starttime;
+
+	void* ptr = bsearch(&key, m_timemap.data(), m_timemap.size(),
+			sizeof(_TickTime), secondsearch);
+
+	if (ptr == NULL) {
+		// The specific seconds value was not found, so do a linear
+		// search for the two time values which occur before and
+		// after the given time value, and do a linear interpolation of
+		// the time in tick values to figure out the final time in ticks.
+		return linearTickInterpolationAtSecond(starttime);
+	} else {
+		return ((_TickTime*)ptr)->tick;
+	}
+
 }
 
 
 
+///////////////////////////////////////////////////////////////////////////
+//
+// note-analysis functions --
+//
+
 //////////////////////////////
 //
-// MidiFile::addNoteOff -- Add a note-off message (using 0x80 messages).
+// MidiFile::linkNotePairs --  Link note-ons to note-offs separately
+//     for each track.  Returns the total number of note message pairs
+//     that were linked.
 //
 
-MidiEvent* MidiFile::addNoteOff(int aTrack, int aTick, int aChannel, int key,
-		int vel) {
-	MidiEvent* me = new MidiEvent;
-	me->makeNoteOff(aChannel, key, vel);
-	me->tick = aTick;
-	m_events[aTrack]->push_back_no_copy(me);
-	return me;
+int MidiFile::linkNotePairsFIFO(void) {
+	loadTracks();
+	int i;
+	int sum = 0;
+	for (i=0; i<getTrackCount(); i++) {
+		if (m_events[i] == NULL) {
+			continue;
+		}
+		sum += m_events[i]->linkNotePairsFIFO();
+	}
+	m_linkedEventsQ = true;
+	return sum;
 }
 
 
+int MidiFile::linkNotePairsLIFO(void) {
+	loadTracks();
+	int i;
+	int sum = 0;
+	for (i=0; i<getTrackCount(); i++) {
+		if (m_events[i] == NULL) {
+			continue;
+		}
+		sum += m_events[i]->linkNotePairsLIFO();
+	}
+	m_linkedEventsQ = true;
+	return sum;
+}
 
-//////////////////////////////
 //
-// MidiFile::addNoteOff -- Add a note-off message (using 0x90 messages with
-//   zero attack velocity).
+// MidiFile::linkEventPairs -- Alias for MidiFile::linkNotePairs().
 //
 
-MidiEvent* MidiFile::addNoteOff(int aTrack, int aTick, int aChannel, int key) {
-	MidiEvent* me = new MidiEvent;
-	me->makeNoteOff(aChannel, key);
-	me->tick = aTick;
-	m_events[aTrack]->push_back_no_copy(me);
-	return me;
+int MidiFile::linkEventPairs(void) {
+	return linkNotePairsFIFO();
 }
 
 
+///////////////////////////////////////////////////////////////////////////
+//
+// filename functions --
+//
 
 //////////////////////////////
 //
-// MidiFile::addController -- Add a controller message in the given
-//    track at the given tick time in the given channel.
+// MidiFile::setFilename -- sets the filename of the MIDI file.
+//      Currently removed any directory path.
 //
 
-MidiEvent* MidiFile::addController(int aTrack, int aTick, int aChannel,
-		int num, int value) {
-	MidiEvent* me = new MidiEvent;
-	me->makeController(aChannel, num, value);
-	me->tick = aTick;
-	m_events[aTrack]->push_back_no_copy(me);
-	return me;
+void MidiFile::setFilename(const std::string& aname) {
+	auto loc = aname.rfind('/');
+	if (loc != std::string::npos) {
+		m_readFileName = aname.substr(loc+1);
+	} else {
+		m_readFileName = aname;
+	}
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::addPatchChange -- Add a patch-change message in the given
-//    track at the given tick time in the given channel.
+// MidiFile::getFilename -- returns the name of the file read into the
+//    structure (if the data was read from a file).
 //
 
-MidiEvent* MidiFile::addPatchChange(int aTrack, int aTick, int aChannel,
-		int patchnum) {
-	MidiEvent* me = new MidiEvent;
-	me->makePatchChange(aChannel, patchnum);
-	me->tick = aTick;
-	m_events[aTrack]->push_back_no_copy(me);
-	return me;
+const char* MidiFile::getFilename(void) const {
+	return m_readFileName.c_str();
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::addTimbre -- Add a patch-change message in the given
-//    track at the given tick time in the given channel.  Alias for
-//    MidiFile::addPatchChange().
+// MidiFile::addEvent --
 //
 
-MidiEvent* MidiFile::addTimbre(int aTrack, int aTick, int aChannel, int patchnum) {
-	return addPatchChange(aTrack, aTick, aChannel, patchnum);
+MidiEvent* MidiFile::addEvent(int aTrack, int aTick,
+		std::vector<uchar>& midiData) {
+	m_timemapvalid = 0;
+	MidiEvent* me = new MidiEvent;
+	me->tick = aTick;
+	me->track = aTrack;
+	me->setMessage(midiData);
+	loadTrack(aTrack);
+	m_events[aTrack]->push_back_no_copy(me);
+	return me;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::addPitchBend -- convert  number in the range from -1 to +1
-//     into two 7-bit numbers (smallest piece first)
-//
-//   -1.0 maps to 0 (0x0000)
-//    0.0 maps to 8192 (0x2000 --> 0x40 0x00)
-//   +1.0 maps to 16383 (0x3FFF --> 0x7F 0x7F)
+// MidiFile::addEvent -- Some bug here when joinedTracks(), but track==1...
 //
 
-MidiEvent* MidiFile::addPitchBend(int aTrack, int aTick, int aChannel, double amount) {
-	m_timemapvalid = 0;
-	amount += 1.0;
-	int value = int(amount * 8192 + 0.5);
-
-	// prevent any wrap-around in case of round-off errors
-	if (value > 0x3fff) {
-		value = 0x3fff;
-	}
-	if (value < 0) {
-		value = 0;
+MidiEvent* MidiFile::addEvent(MidiEvent& mfevent) {
+	if (getTrackState() == TRACK_STATE_JOINED) {
+		m_events[0]->push_back(mfevent);
+		return &m_events[0]->back();
+	} else {
+		loadTrack(mfevent.track);
+		m_events.at(mfevent.track)->push_back(mfevent);
+		return &m_events.at(mfevent.track)->back();
 	}
+}
 
-	int lsbint = 0x7f & value;
-	int msbint = 0x7f & (value  >> 7);
+//
+// Variant where the track is an input parameter:
+//
 
-	std::vector<uchar> mididata;
-	mididata.resize(3);
-	if (aChannel < 0) {
-		aChannel = 0;
-	} else if (aChannel > 15) {
-		aChannel = 15;
+MidiEvent* MidiFile::addEvent(int aTrack, MidiEvent& mfevent) {
+	if (getTrackState() == TRACK_STATE_JOINED) {
+		m_events[0]->push_back(mfevent);
+      m_events[0]->back().track = aTrack;
+		return &m_events[0]->back();
+	} else {
+		loadTrack(aTrack);
+		m_events.at(aTrack)->push_back(mfevent);
+		m_events.at(aTrack)->back().track = aTrack;
+		return &m_events.at(aTrack)->back();
 	}
-	mididata[0] = uchar(0xe0 | aChannel);
-	mididata[1] = uchar(lsbint);
-	mididata[2] = uchar(msbint);
-
-	return addEvent(aTrack, aTick, mididata);
 }
 
 
 
-///////////////////////////////////////////////////////////////////////////
+///////////////////////////////
 //
-// RPN convenience functions:
+// MidiFile::addMetaEvent --
 //
 
-//////////////////////////////
-//
-// MidiFile::setPitchBendRange -- Set the range for the min/max pitch bend
-//   alteration of a note.  Default is 2.0 (meaning +/- 2 semitones from given pitch).
-//   Fractional values are cents, so 2.5 means a range of two semitones plus 50 cents,
-//   which is two semitones plus a quarter tone.
-//
+MidiEvent* MidiFile::addMetaEvent(int aTrack, int aTick, int aType,
+		std::vector<uchar>& metaData) {
+	m_timemapvalid = 0;
+	int i;
+	int length = (int)metaData.size();
+	std::vector<uchar> fulldata;
+	uchar size[23] = {0};
+	int lengthsize = makeVLV(size, length);
 
-void MidiFile::setPitchBendRange(int aTrack, int aTick, int aChannel, double range) {
-	if (range < 0.0) {
-		range = -range;
+	fulldata.resize(2+lengthsize+length);
+	fulldata[0] = 0xff;
+	fulldata[1] = aType & 0x7F;
+	for (i=0; i<lengthsize; i++) {
+		fulldata[2+i] = size[i];
 	}
-	if (range > 24.0) {
-		std::cerr << "Warning: pitch bend range is too large: " << range << std::endl;
-		std::cerr << "Setting to 24." << std::endl;
-		range = 24.0;
+	for (i=0; i<length; i++) {
+		fulldata[2+lengthsize+i] = metaData[i];
 	}
-	int irange = int(range);
-	int cents = int((range - irange) * 100.0 + 0.5);
-
-	// Select pitch bend RPN:
-	addController(aTrack, aTick, aChannel, 101, 0);  // RPN selector (byte 1)
-	addController(aTrack, aTick, aChannel, 100, 0);  // RPN selector (byte 2)
 
-	// Set the semitone range (will be +/-range above/below a note):
-	addController(aTrack, aTick, aChannel,  6,  irange);  // coarse: number of semitones
-	addController(aTrack, aTick, aChannel, 38,  cents);   // fine: cents (1/100ths of semitone)
+	return addEvent(aTrack, aTick, fulldata);
 }
 
 
+MidiEvent* MidiFile::addMetaEvent(int aTrack, int aTick, int aType,
+		const std::string& metaData) {
+	int length = (int)metaData.size();
+	std::vector<uchar> buffer;
+	buffer.resize(length);
+	int i;
+	for (i=0; i<length; i++) {
+		buffer[i] = (uchar)metaData[i];
+	}
+	return addMetaEvent(aTrack, aTick, aType, buffer);
+}
+
 
-///////////////////////////////////////////////////////////////////////////
-//
-// Controller message adding convenience functions:
-//
 
 //////////////////////////////
 //
-// MidiFile::addSustain -- Add a continuous controller message for the sustain pedal.
+// MidiFile::addText --  Add a text meta-message (#1).
 //
 
-MidiEvent* MidiFile::addSustain(int aTrack, int aTick, int aChannel, int value) {
-	return addController(aTrack, aTick, aChannel, 64, value);
+MidiEvent* MidiFile::addText(int aTrack, int aTick, const std::string& text) {
+	MidiEvent* me = new MidiEvent;
+	me->makeText(text);
+	me->tick = aTick;
+	loadTrack(aTrack);
+	m_events[aTrack]->push_back_no_copy(me);
+	return me;
 }
 
+
+
+//////////////////////////////
 //
-// MidiFile::addSustainPedal -- Alias for MidiFile::addSustain().
+// MidiFile::addCopyright --  Add a copyright notice meta-message (#2).
 //
 
-MidiEvent* MidiFile::addSustainPedal(int aTrack, int aTick, int aChannel, int value) {
-	return addSustain(aTrack, aTick, aChannel, value);
+MidiEvent* MidiFile::addCopyright(int aTrack, int aTick, const std::string& text) {
+	MidiEvent* me = new MidiEvent;
+	me->makeCopyright(text);
+	me->tick = aTick;
+	loadTrack(aTrack);
+	m_events[aTrack]->push_back_no_copy(me);
+	return me;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::addSustainOn -- Add a continuous controller message for the sustain pedal on.
-//
-
-MidiEvent* MidiFile::addSustainOn(int aTrack, int aTick, int aChannel) {
-	return addSustain(aTrack, aTick, aChannel, 127);
-}
-
-//
-// MidiFile::addSustainPedalOn -- Alias for MidiFile::addSustainOn().
+// MidiFile::addTrackName --  Add an track name meta-message (#3).
 //
 
-MidiEvent* MidiFile::addSustainPedalOn(int aTrack, int aTick, int aChannel) {
-	return addSustainOn(aTrack, aTick, aChannel);
+MidiEvent* MidiFile::addTrackName(int aTrack, int aTick, const std::string& name) {
+	MidiEvent* me = new MidiEvent;
+	me->makeTrackName(name);
+	me->tick = aTick;
+	loadTrack(aTrack);
+	m_events[aTrack]->push_back_no_copy(me);
+	return me;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::addSustainOff -- Add a continuous controller message for the sustain pedal off.
-//
-
-MidiEvent* MidiFile::addSustainOff(int aTrack, int aTick, int aChannel) {
-	return addSustain(aTrack, aTick, aChannel, 0);
-}
-
-//
-// MidiFile::addSustainPedalOff -- Alias for MidiFile::addSustainOff().
+// MidiFile::addInstrumentName --  Add an instrument name meta-message (#4).
 //
 
-MidiEvent* MidiFile::addSustainPedalOff(int aTrack, int aTick, int aChannel) {
-	return addSustainOff(aTrack, aTick, aChannel);
+MidiEvent* MidiFile::addInstrumentName(int aTrack, int aTick,
+		const std::string& name) {
+	MidiEvent* me = new MidiEvent;
+	me->makeInstrumentName(name);
+	me->tick = aTick;
+	loadTrack(aTrack);
+	m_events[aTrack]->push_back_no_copy(me);
+	return me;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::addTrack -- adds a blank track at end of the
-//    track list.  Returns the track number of the added
-//    track.
+// MidiFile::addLyric -- Add a lyric meta-message (meta #5).
 //
 
-int MidiFile::addTrack(void) {
-	int length = getNumTracks();
-	m_events.resize(length+1);
-	m_events[length] = new MidiEventList;
-	m_events[length]->reserve(10000);
-	m_events[length]->clear();
-	return length;
+MidiEvent* MidiFile::addLyric(int aTrack, int aTick, const std::string& text) {
+	MidiEvent* me = new MidiEvent;
+	me->makeLyric(text);
+	me->tick = aTick;
+	loadTrack(aTrack);
+	m_events[aTrack]->push_back_no_copy(me);
+	return me;
 }
 
-int MidiFile::addTrack(int count) {
-	int length = getNumTracks();
-	m_events.resize(length+count);
-	int i;
-	for (i=0; i<count; i++) {
-		m_events[length + i] = new MidiEventList;
-		m_events[length + i]->reserve(10000);
-		m_events[length + i]->clear();
-	}
-	return length + count - 1;
-}
 
+
+//////////////////////////////
 //
-// MidiFile::addTracks -- Alias for MidiFile::addTrack().
+// MidiFile::addMarker -- Add a marker meta-message (meta #6).
 //
 
-int MidiFile::addTracks(int count) {
-	return addTrack(count);
+MidiEvent* MidiFile::addMarker(int aTrack, int aTick, const std::string& text) {
+	MidiEvent* me = new MidiEvent;
+	me->makeMarker(text);
+	me->tick = aTick;
+	loadTrack(aTrack);
+	m_events[aTrack]->push_back_no_copy(me);
+	return me;
 }
 
 
 
-
 //////////////////////////////
 //
-// MidiFile::allocateEvents --
+// MidiFile::addCue -- Add a cue-point meta-message (meta #7).
 //
 
-void MidiFile::allocateEvents(int track, int aSize) {
-	int oldsize = m_events[track]->size();
-	if (oldsize < aSize) {
-		m_events[track]->reserve(aSize);
-	}
+MidiEvent* MidiFile::addCue(int aTrack, int aTick, const std::string& text) {
+	MidiEvent* me = new MidiEvent;
+	me->makeCue(text);
+	me->tick = aTick;
+	loadTrack(aTrack);
+	m_events[aTrack]->push_back_no_copy(me);
+	return me;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::deleteTrack -- remove a track from the MidiFile.
-//   Tracks are numbered starting at track 0.
+// MidiFile::addTempo -- Add a tempo meta message (meta #0x51).
 //
 
-void MidiFile::deleteTrack(int aTrack) {
-	int length = getNumTracks();
-	if (aTrack < 0 || aTrack >= length) {
-		return;
-	}
-	if (length == 1) {
-		return;
-	}
-	delete m_events[aTrack];
-	for (int i=aTrack; i<length-1; i++) {
-		m_events[i] = m_events[i+1];
-	}
-
-	m_events[length-1] = NULL;
-	m_events.resize(length-1);
+MidiEvent* MidiFile::addTempo(int aTrack, int aTick, double aTempo) {
+	MidiEvent* me = new MidiEvent;
+	me->makeTempo(aTempo);
+	me->tick = aTick;
+	loadTrack(aTrack);
+	m_events[aTrack]->push_back_no_copy(me);
+	return me;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::clear -- make the MIDI file empty with one
-//     track with no data in it.
+// MidiFile::addKeySignature -- Add a key signature meta message
+//      (meta #0x59).
+//
+// Default values:
+//      fifths ==  0 (C)
+//      mode   ==  0 (major)
+//
+// Key signature of b minor would be:
+//      fifths = 2
+//      mode   = 1
 //
 
-void MidiFile::clear(void) {
-	int length = getNumTracks();
-	for (int i=0; i<length; i++) {
-		delete m_events[i];
-		m_events[i] = NULL;
-	}
-	m_events.resize(1);
-	m_events[0] = new MidiEventList;
-	m_timemapvalid=0;
-	m_timemap.clear();
-	m_theTrackState = TRACK_STATE_SPLIT;
-	m_theTimeState = TIME_STATE_ABSOLUTE;
-}
-
-
-void MidiFile::erase(void) {
-	clear();
+MidiEvent* MidiFile::addKeySignature (int aTrack, int aTick, int fifths, bool mode) {
+    MidiEvent* me = new MidiEvent;
+    me->makeKeySignature(fifths, mode);
+    me->tick = aTick;
+    loadTrack(aTrack);
+    m_events[aTrack]->push_back_no_copy(me);
+    return me;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::getEvent -- return the event at the given index in the
-//    specified track.
+// MidiFile::addTimeSignature -- Add a time signature meta message
+//      (meta #0x58).  The "bottom" parameter must be a power of two;
+//      otherwise, it will be set to the next highest power of two.
+//
+// Default values:
+//     clocksPerClick     == 24 (quarter note)
+//     num32ndsPerQuarter ==  8 (8 32nds per quarter note)
+//
+// Time signature of 4/4 would be:
+//    top    = 4
+//    bottom = 4 (converted to 2 in the MIDI file for 2nd power of 2).
+//    clocksPerClick = 24 (2 eighth notes based on num32ndsPerQuarter)
+//    num32ndsPerQuarter = 8
+//
+// Time signature of 6/8 would be:
+//    top    = 6
+//    bottom = 8 (converted to 3 in the MIDI file for 3rd power of 2).
+//    clocksPerClick = 36 (3 eighth notes based on num32ndsPerQuarter)
+//    num32ndsPerQuarter = 8
 //
 
-MidiEvent& MidiFile::getEvent(int aTrack, int anIndex) {
-	return (*m_events[aTrack])[anIndex];
-}
-
-
-const MidiEvent& MidiFile::getEvent(int aTrack, int anIndex) const {
-	return (*m_events[aTrack])[anIndex];
+MidiEvent* MidiFile::addTimeSignature(int aTrack, int aTick, int top, int bottom,
+		int clocksPerClick, int num32ndsPerQuarter) {
+	MidiEvent* me = new MidiEvent;
+	me->makeTimeSignature(top, bottom, clocksPerClick, num32ndsPerQuarter);
+	me->tick = aTick;
+	loadTrack(aTrack);
+	m_events[aTrack]->push_back_no_copy(me);
+	return me;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::getTicksPerQuarterNote -- returns the number of
-//   time units that are supposed to occur during a quarternote.
-//
-
-int MidiFile::getTicksPerQuarterNote(void) const {
-	if (m_ticksPerQuarterNote == 0xE728) {
-		// this is a special case which is the SMPTE time code
-		// setting for 25 frames a second with 40 subframes
-		// which means one tick per millisecond.  When SMPTE is
-		// being used, there is no real concept of the quarter note,
-		// so presume 60 bpm as a simplification here.
-		// return 1000;
-	}
-	return m_ticksPerQuarterNote;
-}
-
+// MidiFile::addCompoundTimeSignature -- Add a time signature meta message
+//      (meta #0x58), where the clocksPerClick parameter is set to three
+//      eighth notes for compound meters such as 6/8 which represents
+//      two beats per measure.
 //
-// Alias for getTicksPerQuarterNote:
+// Default values:
+//     clocksPerClick     == 36 (quarter note)
+//     num32ndsPerQuarter ==  8 (8 32nds per quarter note)
 //
 
-int MidiFile::getTPQ(void) const {
-	return getTicksPerQuarterNote();
+MidiEvent* MidiFile::addCompoundTimeSignature(int aTrack, int aTick, int top,
+		int bottom, int clocksPerClick, int num32ndsPerQuarter) {
+	return addTimeSignature(aTrack, aTick, top, bottom, clocksPerClick,
+		num32ndsPerQuarter);
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::getEventCount -- returns the number of events
-//   in a given track.
+// MidiFile::makeVLV --  This function is used to create
+//   size byte(s) for meta-messages.  If the size of the data
+//   in the meta-message is greater than 127, then the size
+//   should (?) be specified as a VLV.
 //
 
-int MidiFile::getEventCount(int aTrack) const {
-	return m_events[aTrack]->size();
-}
-
+int MidiFile::makeVLV(uchar *buffer, int number) {
 
-int MidiFile::getNumEvents(int aTrack) const {
-	return m_events[aTrack]->size();
-}
+	unsigned long value = (unsigned long)number;
 
+	if (value >= (1 << 28)) {
+		std::cerr << "Error: Meta-message size too large to handle" << std::endl;
+		buffer[0] = 0;
+		buffer[1] = 0;
+		buffer[2] = 0;
+		buffer[3] = 0;
+		return 1;
+	}
 
+	buffer[0] = (value >> 21) & 0x7f;
+	buffer[1] = (value >> 14) & 0x7f;
+	buffer[2] = (value >>  7) & 0x7f;
+	buffer[3] = (value >>  0) & 0x7f;
 
-//////////////////////////////
-//
-// MidiFile::mergeTracks -- combine the data from two
-//   tracks into one.  Placing the data in the first
-//   track location listed, and Moving the other tracks
-//   in the file around to fill in the spot where Track2
-//   used to be.  The results of this function call cannot
-//   be reversed.
-//
-
-void MidiFile::mergeTracks(int aTrack1, int aTrack2) {
-	MidiEventList* mergedTrack;
-	mergedTrack = new MidiEventList;
-	int oldTimeState = getTickState();
-	if (oldTimeState == TIME_STATE_DELTA) {
-		makeAbsoluteTicks();
-	}
-	int length = getNumTracks();
-	for (int i=0; i<(int)m_events[aTrack1]->size(); i++) {
-		mergedTrack->push_back((*m_events[aTrack1])[i]);
-	}
-	for (int j=0; j<(int)m_events[aTrack2]->size(); j++) {
-		(*m_events[aTrack2])[j].track = aTrack1;
-		mergedTrack->push_back((*m_events[aTrack2])[j]);
+	int i;
+	int flag = 0;
+	int length = -1;
+	for (i=0; i<3; i++) {
+		if (buffer[i] != 0) {
+			flag = 1;
+		}
+		if (flag) {
+			buffer[i] |= 0x80;
+		}
+		if (length == -1 && buffer[i] >= 0x80) {
+			length = 4-i;
+		}
 	}
 
-	mergedTrack->sort();
-
-	delete m_events[aTrack1];
-
-	m_events[aTrack1] = mergedTrack;
+	if (length == -1) {
+		length = 1;
+	}
 
-	for (int i=aTrack2; i<length-1; i++) {
-		m_events[i] = m_events[i+1];
-		for (int j=0; j<(int)m_events[i]->size(); j++) {
-			(*m_events[i])[j].track = i;
+	if (length < 4) {
+		for (i=0; i<length; i++) {
+			buffer[i] = buffer[4-length+i];
 		}
 	}
 
-	m_events[length-1] = NULL;
-	m_events.resize(length-1);
-
-	if (oldTimeState == TIME_STATE_DELTA) {
-		deltaTicks();
-	}
+	return length;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::setTicksPerQuarterNote --
+// MidiFile::addNoteOn -- Add a note-on message to the given track at the
+//    given time in the given channel.
 //
 
-void MidiFile::setTicksPerQuarterNote(int ticks) {
-	m_ticksPerQuarterNote = ticks;
+MidiEvent* MidiFile::addNoteOn(int aTrack, int aTick, int aChannel, int key, int vel) {
+	MidiEvent* me = new MidiEvent;
+	me->makeNoteOn(aChannel, key, vel);
+	me->tick = aTick;
+	loadTrack(aTrack);
+	m_events[aTrack]->push_back_no_copy(me);
+	return me;
 }
 
+
+
+//////////////////////////////
 //
-// Alias for setTicksPerQuarterNote:
+// MidiFile::addNoteOff -- Add a note-off message (using 0x80 messages).
 //
 
-void MidiFile::setTPQ(int ticks) {
-	setTicksPerQuarterNote(ticks);
+MidiEvent* MidiFile::addNoteOff(int aTrack, int aTick, int aChannel, int key,
+		int vel) {
+	MidiEvent* me = new MidiEvent;
+	me->makeNoteOff(aChannel, key, vel);
+	me->tick = aTick;
+	loadTrack(aTrack);
+	m_events[aTrack]->push_back_no_copy(me);
+	return me;
 }
 
 
+
 //////////////////////////////
 //
-// MidiFile::setMillisecondTicks -- set the ticks per quarter note
-//   value to milliseconds.  The format for this specification is
-//   highest 8-bits: SMPTE Frame rate (as a negative 2's compliment value).
-//   lowest 8-bits: divisions per frame (as a positive number).
-//   for millisecond resolution, the SMPTE value is -25, and the
-//   frame rate is 40 frame per division.  In hexadecimal, these
-//   values are: -25 = 1110,0111 = 0xE7 and 40 = 0010,1000 = 0x28
-//   So setting the ticks per quarter note value to 0xE728 will cause
-//   delta times in the MIDI file to represent milliseconds.  Calling
-//   this function will not change any exiting timestamps, it will
-//   only change the meaning of the timestamps.
+// MidiFile::addNoteOff -- Add a note-off message (using 0x90 messages with
+//   zero attack velocity).
 //
 
-void MidiFile::setMillisecondTicks(void) {
-	m_ticksPerQuarterNote = 0xE728;
+MidiEvent* MidiFile::addNoteOff(int aTrack, int aTick, int aChannel, int key) {
+	MidiEvent* me = new MidiEvent;
+	me->makeNoteOff(aChannel, key);
+	me->tick = aTick;
+	loadTrack(aTrack);
+	m_events[aTrack]->push_back_no_copy(me);
+	return me;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::sortTrack -- Sort the specified track in tick order.
-//    If the MidiEvent::seq variables have been filled in with
-//    a sequence value, this will preserve the order of the
-//    events that occur at the same tick time before the sort
-//    was done.
+// MidiFile::addController -- Add a controller message in the given
+//    track at the given tick time in the given channel.
 //
 
-
-void MidiFile::sortTrackNoteOnsBeforeOffs(int track) {
-	if ((track >= 0) && (track < getTrackCount())) {
-		m_events.at(track)->sortNoteOnsBeforeOffs();
-	} else {
-		std::cerr << "Warning: track " << track << " does not exist." << std::endl;
-	}
-}
-
-void MidiFile::sortTrackNoteOffsBeforeOns(int track) {
-	if ((track >= 0) && (track < getTrackCount())) {
-		m_events.at(track)->sortNoteOffsBeforeOns();
-	} else {
-		std::cerr << "Warning: track " << track << " does not exist." << std::endl;
-	}
+MidiEvent* MidiFile::addController(int aTrack, int aTick, int aChannel,
+		int num, int value) {
+	MidiEvent* me = new MidiEvent;
+	me->makeController(aChannel, num, value);
+	me->tick = aTick;
+	loadTrack(aTrack);
+	m_events[aTrack]->push_back_no_copy(me);
+	return me;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::sortTracks -- sort all tracks in the MidiFile.
+// MidiFile::addPatchChange -- Add a patch-change message in the given
+//    track at the given tick time in the given channel.
 //
 
-void MidiFile::sortTracksNoteOnsBeforeOffs(void) {
-	if (m_theTimeState == TIME_STATE_ABSOLUTE) {
-		for (int i=0; i<getTrackCount(); i++) {
-			m_events.at(i)->sortNoteOnsBeforeOffs();
-		}
-	} else {
-		std::cerr << "Warning: Sorting only allowed in absolute tick mode.";
-	}
-}
-
-void MidiFile::sortTracksNoteOffsBeforeOns(void) {
-	if (m_theTimeState == TIME_STATE_ABSOLUTE) {
-		for (int i=0; i<getTrackCount(); i++) {
-			m_events.at(i)->sortNoteOffsBeforeOns();
-		}
-	} else {
-		std::cerr << "Warning: Sorting only allowed in absolute tick mode.";
-	}
+MidiEvent* MidiFile::addPatchChange(int aTrack, int aTick, int aChannel,
+		int patchnum) {
+	MidiEvent* me = new MidiEvent;
+	me->makePatchChange(aChannel, patchnum);
+	me->tick = aTick;
+	loadTrack(aTrack);
+	m_events[aTrack]->push_back_no_copy(me);
+	return me;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::getTrackCountAsType1 --  Return the number of tracks in the
-//    MIDI file.  Returns the size of the events if not in joined state.
-//    If in joined state, reads track 0 to find the maximum track
-//    value from the original unjoined tracks.
+// MidiFile::addTimbre -- Add a patch-change message in the given
+//    track at the given tick time in the given channel.  Alias for
+//    MidiFile::addPatchChange().
 //
 
-int MidiFile::getTrackCountAsType1(void) {
-	if (getTrackState() == TRACK_STATE_JOINED) {
-		int output = 0;
-		int i;
-		for (i=0; i<(int)m_events[0]->size(); i++) {
-			if (getEvent(0,i).track > output) {
-				output = getEvent(0,i).track;
-			}
-		}
-		return output+1;  // I think the track values are 0 offset...
-	} else {
-		return (int)m_events.size();
-	}
+MidiEvent* MidiFile::addTimbre(int aTrack, int aTick, int aChannel, int patchnum) {
+	return addPatchChange(aTrack, aTick, aChannel, patchnum);
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::clearLinks --
+// MidiFile::addPitchBend -- convert  number in the range from -1 to +1
+//     into two 7-bit numbers (smallest piece first)
+//
+//   -1.0 maps to 0 (0x0000)
+//    0.0 maps to 8192 (0x2000 --> 0x40 0x00)
+//   +1.0 maps to 16383 (0x3FFF --> 0x7F 0x7F)
 //
 
-void MidiFile::clearLinks(void) {
-	for (int i=0; i<getTrackCount(); i++) {
-		if (m_events[i] == NULL) {
-			continue;
-		}
-		m_events[i]->clearLinks();
+MidiEvent* MidiFile::addPitchBend(int aTrack, int aTick, int aChannel, double amount) {
+	m_timemapvalid = 0;
+	amount += 1.0;
+	int value = int(amount * 8192 + 0.5);
+
+	// prevent any wrap-around in case of round-off errors
+	if (value > 0x3fff) {
+		value = 0x3fff;
 	}
-	m_linkedEventsQ = false;
+	if (value < 0) {
+		value = 0;
+	}
+
+	int lsbint = 0x7f & value;
+	int msbint = 0x7f & (value  >> 7);
+
+	std::vector<uchar> mididata;
+	mididata.resize(3);
+	if (aChannel < 0) {
+		aChannel = 0;
+	} else if (aChannel > 15) {
+		aChannel = 15;
+	}
+	mididata[0] = uchar(0xe0 | aChannel);
+	mididata[1] = uchar(lsbint);
+	mididata[2] = uchar(msbint);
+
+	return addEvent(aTrack, aTick, mididata);
 }
 
 
 
 ///////////////////////////////////////////////////////////////////////////
 //
-// private functions
+// RPN convenience functions:
 //
 
 //////////////////////////////
 //
-// MidiFile::linearTickInterpolationAtSecond -- return the tick value at the
-//    given input time.
+// MidiFile::setPitchBendRange -- Set the range for the min/max pitch bend
+//   alteration of a note.  Default is 2.0 (meaning +/- 2 semitones from given pitch).
+//   Fractional values are cents, so 2.5 means a range of two semitones plus 50 cents,
+//   which is two semitones plus a quarter tone.
 //
 
-double MidiFile::linearTickInterpolationAtSecond(double seconds) {
-	if (m_timemapvalid == 0) {
-		buildTimeMap();
-		if (m_timemapvalid == 0) {
-			return -1.0;    // something went wrong
-		}
-	}
-
-	int i;
-	double lasttime = m_timemap[m_timemap.size()-1].seconds;
-	// give an error value of -1 if time is out of range of data.
-	if (seconds < 0.0) {
-		return -1.0;
+void MidiFile::setPitchBendRange(int aTrack, int aTick, int aChannel, double range) {
+	if (range < 0.0) {
+		range = -range;
 	}
-	if (seconds > m_timemap[m_timemap.size()-1].seconds) {
-		return -1.0;
+	if (range > 24.0) {
+		std::cerr << "Warning: pitch bend range is too large: " << range << std::endl;
+		std::cerr << "Setting to 24." << std::endl;
+		range = 24.0;
 	}
+	int irange = int(range);
+	int cents = int((range - irange) * 100.0 + 0.5);
 
-	// Guess which side of the list is closest to target:
-	// Could do a more efficient algorithm since time values are sorted,
-	// but good enough for now...
-	int startindex = -1;
-	if (seconds < lasttime / 2) {
-		for (i=0; i<(int)m_timemap.size(); i++) {
-			if (m_timemap[i].seconds > seconds) {
-				startindex = i-1;
-				break;
-			} else if (m_timemap[i].seconds == seconds) {
-				startindex = i;
-				break;
-			}
-		}
-	} else {
-		for (i=(int)m_timemap.size()-1; i>0; i--) {
-			if (m_timemap[i].seconds < seconds) {
-				startindex = i+1;
-				break;
-			} else if (m_timemap[i].seconds == seconds) {
-				startindex = i;
-				break;
-			}
-		}
-	}
-
-	if (startindex < 0) {
-		return -1.0;
-	}
-	if (startindex >= (int)m_timemap.size()-1) {
-		return -1.0;
-	}
-
-	double x1 = m_timemap[startindex].seconds;
-	double x2 = m_timemap[startindex+1].seconds;
-	double y1 = m_timemap[startindex].tick;
-	double y2 = m_timemap[startindex+1].tick;
-	double xi = seconds;
+	// Select pitch bend RPN:
+	addController(aTrack, aTick, aChannel, 101, 0);  // RPN selector (byte 1)
+	addController(aTrack, aTick, aChannel, 100, 0);  // RPN selector (byte 2)
 
-	return (xi-x1) * ((y2-y1)/(x2-x1)) + y1;
+	// Set the semitone range (will be +/-range above/below a note):
+	addController(aTrack, aTick, aChannel,  6,  irange);  // coarse: number of semitones
+	addController(aTrack, aTick, aChannel, 38,  cents);   // fine: cents (1/100ths of semitone)
 }
 
 
 
+///////////////////////////////////////////////////////////////////////////
+//
+// Controller message adding convenience functions:
+//
+
 //////////////////////////////
 //
-// MidiFile::linearSecondInterpolationAtTick -- return the time in seconds
-//    value at the given input tick time. (Ticks input could be made double).
+// MidiFile::addSustain -- Add a continuous controller message for the sustain pedal.
 //
 
-double MidiFile::linearSecondInterpolationAtTick(int ticktime) {
-	if (m_timemapvalid == 0) {
-		buildTimeMap();
-		if (m_timemapvalid == 0) {
-			return -1.0;    // something went wrong
-		}
-	}
+MidiEvent* MidiFile::addSustain(int aTrack, int aTick, int aChannel, int value) {
+	return addController(aTrack, aTick, aChannel, 64, value);
+}
 
-	int i;
-	double lasttick = m_timemap[m_timemap.size()-1].tick;
-	// give an error value of -1 if time is out of range of data.
-	if (ticktime < 0.0) {
-		return -1;
-	}
-	if (ticktime > m_timemap.back().tick) {
-		return -1;  // don't try to extrapolate
-	}
+//
+// MidiFile::addSustainPedal -- Alias for MidiFile::addSustain().
+//
 
-	// Guess which side of the list is closest to target:
-	// Could do a more efficient algorithm since time values are sorted,
-	// but good enough for now...
-	int startindex = -1;
-	if (ticktime < lasttick / 2) {
-		for (i=0; i<(int)m_timemap.size(); i++) {
-			if (m_timemap[i].tick > ticktime) {
-				startindex = i-1;
-				break;
-			} else if (m_timemap[i].tick == ticktime) {
-				startindex = i;
-				break;
-			}
-		}
-	} else {
-		for (i=(int)m_timemap.size()-1; i>0; i--) {
-			if (m_timemap[i].tick < ticktime) {
-				startindex = i;
-				break;
-			} else if (m_timemap[i].tick == ticktime) {
-				startindex = i;
-				break;
-			}
-		}
-	}
+MidiEvent* MidiFile::addSustainPedal(int aTrack, int aTick, int aChannel, int value) {
+	return addSustain(aTrack, aTick, aChannel, value);
+}
 
-	if (startindex < 0) {
-		return -1;
-	}
-	if (startindex >= (int)m_timemap.size()-1) {
-		return -1;
-	}
 
-	if (m_timemap[startindex].tick == ticktime) {
-		return m_timemap[startindex].seconds;
-	}
 
-	double x1 = m_timemap[startindex].tick;
-	double x2 = m_timemap[startindex+1].tick;
-	double y1 = m_timemap[startindex].seconds;
-	double y2 = m_timemap[startindex+1].seconds;
-	double xi = ticktime;
+//////////////////////////////
+//
+// MidiFile::addSustainOn -- Add a continuous controller message for the sustain pedal on.
+//
 
-	return (xi-x1) * ((y2-y1)/(x2-x1)) + y1;
+MidiEvent* MidiFile::addSustainOn(int aTrack, int aTick, int aChannel) {
+	return addSustain(aTrack, aTick, aChannel, 127);
+}
+
+//
+// MidiFile::addSustainPedalOn -- Alias for MidiFile::addSustainOn().
+//
+
+MidiEvent* MidiFile::addSustainPedalOn(int aTrack, int aTick, int aChannel) {
+	return addSustainOn(aTrack, aTick, aChannel);
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::buildTimeMap -- build an index of the absolute tick values
-//      found in a MIDI file, and their corresponding time values in
-//      seconds, taking into consideration tempo change messages.  If no
-//      tempo messages are given (or until they are given, then the
-//      tempo is set to 120 beats per minute).  If SMPTE time code is
-//      used, then ticks are actually time values.  So don't build
-//      a time map for SMPTE ticks, and just calculate the time in
-//      seconds from the tick value (1000 ticks per second SMPTE
-//      is the only mode tested (25 frames per second and 40 subframes
-//      per frame).
+// MidiFile::addSustainOff -- Add a continuous controller message for the sustain pedal off.
 //
 
-void MidiFile::buildTimeMap(void) {
+MidiEvent* MidiFile::addSustainOff(int aTrack, int aTick, int aChannel) {
+	return addSustain(aTrack, aTick, aChannel, 0);
+}
 
-	// convert the MIDI file to absolute time representation
-	// in single track mode (and undo if the MIDI file was not
-	// in that state when this function was called.
-	//
-	int trackstate = getTrackState();
-	int timestate  = getTickState();
+//
+// MidiFile::addSustainPedalOff -- Alias for MidiFile::addSustainOff().
+//
 
-	makeAbsoluteTicks();
-	joinTracks();
+MidiEvent* MidiFile::addSustainPedalOff(int aTrack, int aTick, int aChannel) {
+	return addSustainOff(aTrack, aTick, aChannel);
+}
 
-	int allocsize = getNumEvents(0);
-	m_timemap.reserve(allocsize+10);
-	m_timemap.clear();
 
-	_TickTime value;
 
-	int lasttick = 0;
-	int tickinit = 0;
+//////////////////////////////
+//
+// MidiFile::addTrack -- adds a blank track at end of the
+//    track list.  Returns the track number of the added
+//    track.
+//
 
-	int i;
-	int tpq = getTicksPerQuarterNote();
-	double defaultTempo = 120.0;
-	double secondsPerTick = 60.0 / (defaultTempo * tpq);
+int MidiFile::addTrack(void) {
+	int length = getNumTracks();
+	m_events.resize(length+1);
+	m_events[length] = new MidiEventList;
+	m_events[length]->reserve(10000);
+	m_events[length]->clear();
+	return length;
+}
 
-	double lastsec = 0.0;
-	double cursec = 0.0;
+int MidiFile::addTrack(int count) {
+	int length = getNumTracks();
+	m_events.resize(length+count);
+	int i;
+	for (i=0; i<count; i++) {
+		m_events[length + i] = new MidiEventList;
+		m_events[length + i]->reserve(10000);
+		m_events[length + i]->clear();
+	}
+	return length + count - 1;
+}
 
-	for (i=0; i<getNumEvents(0); i++) {
-		int curtick = getEvent(0, i).tick;
-		getEvent(0, i).seconds = cursec;
-		if ((curtick > lasttick) || !tickinit) {
-			tickinit = 1;
+//
+// MidiFile::addTracks -- Alias for MidiFile::addTrack().
+//
 
-			// calculate the current time in seconds:
-			cursec = lastsec + (curtick - lasttick) * secondsPerTick;
-			getEvent(0, i).seconds = cursec;
+int MidiFile::addTracks(int count) {
+	return addTrack(count);
+}
 
-			// store the new tick to second mapping
-			value.tick = curtick;
-			value.seconds = cursec;
-			m_timemap.push_back(value);
-			lasttick   = curtick;
-			lastsec    = cursec;
-		}
 
-		// update the tempo if needed:
-		if (getEvent(0,i).isTempo()) {
-			secondsPerTick = getEvent(0,i).getTempoSPT(getTicksPerQuarterNote());
-		}
-	}
 
-	// reset the states of the tracks or time values if necessary here:
-	if (timestate == TIME_STATE_DELTA) {
-		deltaTicks();
-	}
-	if (trackstate == TRACK_STATE_SPLIT) {
-		splitTracks();
-	}
 
-	m_timemapvalid = 1;
+//////////////////////////////
+//
+// MidiFile::allocateEvents --
+//
 
+void MidiFile::allocateEvents(int track, int aSize) {
+	loadTrack(track);
+	int oldsize = m_events[track]->size();
+	if (oldsize < aSize) {
+		m_events[track]->reserve(aSize);
+	}
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::extractMidiData -- Extract MIDI data from input
-//    stream.  Return value is 0 if failure; otherwise, returns 1.
+// MidiFile::deleteTrack -- remove a track from the MidiFile.
+//   Tracks are numbered starting at track 0.
 //
 
-int MidiFile::extractMidiData(std::istream& input, std::vector<uchar>& array,
-	uchar& runningCommand) {
+void MidiFile::deleteTrack(int aTrack) {
+	loadTracks();
+	int length = getNumTracks();
+	if (aTrack < 0 || aTrack >= length) {
+		return;
+	}
+	if (length == 1) {
+		return;
+	}
+	delete m_events[aTrack];
+	for (int i=aTrack; i<length-1; i++) {
+		m_events[i] = m_events[i+1];
+	}
 
-	int character;
-	uchar byte;
-	array.clear();
-	int runningQ;
+	m_events[length-1] = NULL;
+	m_events.resize(length-1);
+}
 
-	character = input.get();
-	if (character == EOF) {
-		std::cerr << "Error: unexpected end of file." << std::endl;
-		return 0;
-	} else {
-		byte = (uchar)character;
+
+
+//////////////////////////////
+//
+// MidiFile::clear -- make the MIDI file empty with one
+//     track with no data in it.
+//
+
+void MidiFile::clear(void) {
+	clearLazyIndex();
+	int length = getNumTracks();
+	for (int i=0; i<length; i++) {
+		delete m_events[i];
+		m_events[i] = NULL;
 	}
+	m_events.resize(1);
+	m_events[0] = new MidiEventList;
+	m_timemapvalid=0;
+	m_timemap.clear();
+	m_theTrackState = TRACK_STATE_SPLIT;
+	m_theTimeState = TIME_STATE_ABSOLUTE;
+}
 
-	if (byte < 0x80) {
-		runningQ = 1;
-		if (runningCommand == 0) {
-			std::cerr << "Error: running command with no previous command" << std::endl;
-			return 0;
+
+void MidiFile::erase(void) {
+	clear();
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::getEvent -- return the event at the given index in the
+//    specified track.
+//
+
+MidiEvent& MidiFile::getEvent(int aTrack, int anIndex) {
+	loadTrack(aTrack);
+	return (*m_events[aTrack])[anIndex];
+}
+
+
+const MidiEvent& MidiFile::getEvent(int aTrack, int anIndex) const {
+	loadTrack(aTrack);
+	return (*m_events[aTrack])[anIndex];
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::getTicksPerQuarterNote -- returns the number of
+//   time units that are supposed to occur during a quarternote.
+//
+
+int MidiFile::getTicksPerQuarterNote(void) const {
+	if (m_ticksPerQuarterNote == 0xE728) {
+		// this is a special case which is the SMPTE time code
+		// setting for 25 frames a second with 40 subframes
+		// which means one tick per millisecond.  When SMPTE is
+		// being used, there is no real concept of the quarter note,
+		// so presume 60 bpm as a simplification here.
+		// return 1000;
+	}
+	return m_ticksPerQuarterNote;
+}
+
+//
+// Alias for getTicksPerQuarterNote:
+//
+
+int MidiFile::getTPQ(void) const {
+	return getTicksPerQuarterNote();
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::getEventCount -- returns the number of events
+//   in a given track.
+//
+
+int MidiFile::getEventCount(int aTrack) const {
+	loadTrack(aTrack);
+	return m_events[aTrack]->size();
+}
+
+
+int MidiFile::getNumEvents(int aTrack) const {
+	loadTrack(aTrack);
+	return m_events[aTrack]->size();
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::mergeTracks -- combine the data from two
+//   tracks into one.  Placing the data in the first
+//   track location listed, and Moving the other tracks
+//   in the file around to fill in the spot where Track2
+//   used to be.  The results of this function call cannot
+//   be reversed.
+//
+
+void MidiFile::mergeTracks(int aTrack1, int aTrack2) {
+	loadTracks();
+	MidiEventList* mergedTrack;
+	mergedTrack = new MidiEventList;
+	int oldTimeState = getTickState();
+	if (oldTimeState == TIME_STATE_DELTA) {
+		makeAbsoluteTicks();
+	}
+	int length = getNumTracks();
+	for (int i=0; i<(int)m_events[aTrack1]->size(); i++) {
+		mergedTrack->push_back((*m_events[aTrack1])[i]);
+	}
+	for (int j=0; j<(int)m_events[aTrack2]->size(); j++) {
+		(*m_events[aTrack2])[j].track = aTrack1;
+		mergedTrack->push_back((*m_events[aTrack2])[j]);
+	}
+
+	mergedTrack->sort();
+
+	delete m_events[aTrack1];
+
+	m_events[aTrack1] = mergedTrack;
+
+	for (int i=aTrack2; i<length-1; i++) {
+		m_events[i] = m_events[i+1];
+		for (int j=0; j<(int)m_events[i]->size(); j++) {
+			(*m_events[i])[j].track = i;
 		}
-		if (runningCommand >= 0xf0) {
-			std::cerr << "Error: running status not permitted with meta and sysex"
-			     << " event." << std::endl;
-			std::cerr << "Byte is 0x" << std::hex << (int)byte << std::dec << std::endl;
-			return 0;
+	}
+
+	m_events[length-1] = NULL;
+	m_events.resize(length-1);
+
+	if (oldTimeState == TIME_STATE_DELTA) {
+		deltaTicks();
+	}
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::setTicksPerQuarterNote --
+//
+
+void MidiFile::setTicksPerQuarterNote(int ticks) {
+	m_ticksPerQuarterNote = ticks;
+}
+
+//
+// Alias for setTicksPerQuarterNote:
+//
+
+void MidiFile::setTPQ(int ticks) {
+	setTicksPerQuarterNote(ticks);
+}
+
+
+//////////////////////////////
+//
+// MidiFile::setMillisecondTicks -- set the ticks per quarter note
+//   value to milliseconds.  The format for this specification is
+//   highest 8-bits: SMPTE Frame rate (as a negative 2's compliment value).
+//   lowest 8-bits: divisions per frame (as a positive number).
+//   for millisecond resolution, the SMPTE value is -25, and the
+//   frame rate is 40 frame per division.  In hexadecimal, these
+//   values are: -25 = 1110,0111 = 0xE7 and 40 = 0010,1000 = 0x28
+//   So setting the ticks per quarter note value to 0xE728 will cause
+//   delta times in the MIDI file to represent milliseconds.  Calling
+//   this function will not change any exiting timestamps, it will
+//   only change the meaning of the timestamps.
+//
+
+void MidiFile::setMillisecondTicks(void) {
+	m_ticksPerQuarterNote = 0xE728;
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::sortTrack -- Sort the specified track in tick order.
+//    If the MidiEvent::seq variables have been filled in with
+//    a sequence value, this will preserve the order of the
+//    events that occur at the same tick time before the sort
+//    was done.
+//
+
+
+void MidiFile::sortTrackNoteOnsBeforeOffs(int track) {
+	loadTrack(track);
+	if ((track >= 0) && (track < getTrackCount())) {
+		m_events.at(track)->sortNoteOnsBeforeOffs();
+	} else {
+		std::cerr << "Warning: track " << track << " does not exist." << std::endl;
+	}
+}
+
+void MidiFile::sortTrackNoteOffsBeforeOns(int track) {
+	loadTrack(track);
+	if ((track >= 0) && (track < getTrackCount())) {
+		m_events.at(track)->sortNoteOffsBeforeOns();
+	} else {
+		std::cerr << "Warning: track " << track << " does not exist." << std::endl;
+	}
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::sortTracks -- sort all tracks in the MidiFile.
+//
+
+void MidiFile::sortTracksNoteOnsBeforeOffs(void) {
+	loadTracks();
+	if (m_theTimeState == TIME_STATE_ABSOLUTE) {
+		for (int i=0; i<getTrackCount(); i++) {
+			m_events.at(i)->sortNoteOnsBeforeOffs();
 		}
 	} else {
-		runningCommand = byte;
-		runningQ = 0;
+		std::cerr << "Warning: Sorting only allowed in absolute tick mode.";
 	}
+}
 
-	array.push_back(runningCommand);
-	if (runningQ) {
-		array.push_back(byte);
+void MidiFile::sortTracksNoteOffsBeforeOns(void) {
+	loadTracks();
+	if (m_theTimeState == TIME_STATE_ABSOLUTE) {
+		for (int i=0; i<getTrackCount(); i++) {
+			m_events.at(i)->sortNoteOffsBeforeOns();
+		}
+	} else {
+		std::cerr << "Warning: Sorting only allowed in absolute tick mode.";
 	}
+}
 
-	switch (runningCommand & 0xf0) {
-		case 0x80:        // note off (2 more bytes)
-		case 0x90:        // note on (2 more bytes)
-		case 0xA0:        // aftertouch (2 more bytes)
-		case 0xB0:        // cont. controller (2 more bytes)
-		case 0xE0:        // pitch wheel (2 more bytes)
-			byte = readByte(input);
-			if (!status()) { return m_rwstatus; }
-			if (byte > 0x7f) {
-				std::cerr << "MIDI data byte too large: " << (int)byte << std::endl;
-				m_rwstatus = false; return m_rwstatus;
+
+
+//////////////////////////////
+//
+// MidiFile::getTrackCountAsType1 --  Return the number of tracks in the
+//    MIDI file.  Returns the size of the events if not in joined state.
+//    If in joined state, reads track 0 to find the maximum track
+//    value from the original unjoined tracks.
+//
+
+int MidiFile::getTrackCountAsType1(void) {
+	if (getTrackState() == TRACK_STATE_JOINED) {
+		int output = 0;
+		int i;
+		for (i=0; i<(int)m_events[0]->size(); i++) {
+			if (getEvent(0,i).track > output) {
+				output = getEvent(0,i).track;
 			}
-			array.push_back(byte);
-			if (!runningQ) {
-				byte = readByte(input);
-				if (!status()) { return m_rwstatus; }
-				if (byte > 0x7f) {
-					std::cerr << "MIDI data byte too large: " << (int)byte << std::endl;
-					m_rwstatus = false; return m_rwstatus;
-				}
-				array.push_back(byte);
+		}
+		return output+1;  // I think the track values are 0 offset...
+	} else {
+		return (int)m_events.size();
+	}
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::clearLinks --
+//
+
+void MidiFile::clearLinks(void) {
+	for (int i=0; i<getTrackCount(); i++) {
+		if (m_events[i] == NULL) {
+			continue;
+		}
+		m_events[i]->clearLinks();
+	}
+	m_linkedEventsQ = false;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// private functions
+//
+
+//////////////////////////////
+//
+// MidiFile::linearTickInterpolationAtSecond -- return the tick value at the
+//    given input time.
+//
+
+double MidiFile::linearTickInterpolationAtSecond(double seconds) {
+	if (m_timemapvalid == 0) {
+		buildTimeMap();
+		if (m_timemapvalid == 0) {
+			return -1.0;    // something went wrong
+		}
+	}
+
+	int i;
+	double lasttime = m_timemap[m_timemap.size()-1].seconds;
+	// give an error value of -1 if time is out of range of data.
+	if (seconds < 0.0) {
+		return -1.0;
+	}
+	if (seconds > m_timemap[m_timemap.size()-1].seconds) {
+		return -1.0;
+	}
+
+	// Guess which side of the list is closest to target:
+	// Could do a more efficient algorithm since time values are sorted,
+	// but good enough for now...
+	int startindex = -1;
+	if (seconds < lasttime / 2) {
+		for (i=0; i<(int)m_timemap.size(); i++) {
+			if (m_timemap[i].seconds > seconds) {
+				startindex = i-1;
+				break;
+			} else if (m_timemap[i].seconds == seconds) {
+				startindex = i;
+				break;
 			}
-			break;
-		case 0xC0:        // patch change (1 more byte)
-		case 0xD0:        // channel pressure (1 more byte)
-			if (!runningQ) {
-				byte = readByte(input);
-				if (!status()) { return m_rwstatus; }
-				if (byte > 0x7f) {
-					std::cerr << "MIDI data byte too large: " << (int)byte << std::endl;
-					m_rwstatus = false; return m_rwstatus;
-				}
-				array.push_back(byte);
+		}
+	} else {
+		for (i=(int)m_timemap.size()-1; i>0; i--) {
+			if (m_timemap[i].seconds < seconds) {
+				startindex = i+1;
+				break;
+			} else if (m_timemap[i].seconds == seconds) {
+				startindex = i;
+				break;
 			}
-			break;
-		case 0xF0:
-			switch (runningCommand) {
-				case 0xff:                 // meta event
-					{
-					if (!runningQ) {
-						byte = readByte(input); // meta type
-						if (!status()) { return m_rwstatus; }
-						array.push_back(byte);
-					}
-					ulong length = 0;
-					uchar byte1 = 0;
-					uchar byte2 = 0;
-					uchar byte3 = 0;
-					uchar byte4 = 0;
-					byte1 = readByte(input);
-					if (!status()) { return m_rwstatus; }
-					array.push_back(byte1);
-					if (byte1 >= 0x80) {
-						byte2 = readByte(input);
-						if (!status()) { return m_rwstatus; }
-						array.push_back(byte2);
-						if (byte2 > 0x80) {
-							byte3 = readByte(input);
-							if (!status()) { return m_rwstatus; }
-							array.push_back(byte3);
-							if (byte3 >= 0x80) {
-								byte4 = readByte(input);
-								if (!status()) { return m_rwstatus; }
-								array.push_back(byte4);
-								if (byte4 >= 0x80) {
-									std::cerr << "Error: cannot handle large VLVs" << std::endl;
-									m_rwstatus = false; return m_rwstatus;
-								} else {
-									length = unpackVLV(byte1, byte2, byte3, byte4);
-									if (!m_rwstatus) { return m_rwstatus; }
-								}
-							} else {
-								length = unpackVLV(byte1, byte2, byte3);
-								if (!m_rwstatus) { return m_rwstatus; }
-							}
-						} else {
-							length = unpackVLV(byte1, byte2);
-							if (!m_rwstatus) { return m_rwstatus; }
-						}
-					} else {
-						length = byte1;
-					}
-					for (int j=0; j<(int)length; j++) {
-						byte = readByte(input); // meta type
-						if (!status()) { return m_rwstatus; }
-						array.push_back(byte);
-					}
-					}
-					break;
+		}
+	}
 
-				// The 0xf0 and 0xf7 meta commands deal with system-exclusive
-				// messages. 0xf0 is used to either start a message or to store
-				// a complete message.  The 0xf0 is part of the outgoing MIDI
-				// bytes.  The 0xf7 message is used to send arbitrary bytes,
-				// typically the middle or ends of system exclusive messages.  The
-				// 0xf7 byte at the start of the message is not part of the
-				// outgoing raw MIDI bytes, but is kept in the MidiFile message
-				// to indicate a raw MIDI byte message (typically a partial
-				// system exclusive message).
-				case 0xf7:   // Raw bytes. 0xf7 is not part of the raw
-				             // bytes, but are included to indicate
-				             // that this is a raw byte message.
-				case 0xf0:   // System Exclusive message
-					{         // (complete, or start of message).
-					int length = (int)readVLValue(input);
-					for (int i=0; i<length; i++) {
-						byte = readByte(input);
-						if (!status()) { return m_rwstatus; }
-						array.push_back(byte);
-					}
-					}
-					break;
+	if (startindex < 0) {
+		return -1.0;
+	}
+	if (startindex >= (int)m_timemap.size()-1) {
+		return -1.0;
+	}
 
-				// other "F" MIDI commands are not expected, but can be
-				// handled here if they exist.
-			}
-			break;
-		default:
-			std::cout << "Error reading midifile" << std::endl;
-			std::cout << "Command byte was " << (int)runningCommand << std::endl;
-			return 0;
+	double x1 = m_timemap[startindex].seconds;
+	double x2 = m_timemap[startindex+1].seconds;
+	double y1 = m_timemap[startindex].tick;
+	double y2 = m_timemap[startindex+1].tick;
+	double xi = seconds;
+
+	return (xi-x1) * ((y2-y1)/(x2-x1)) + y1;
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::linearSecondInterpolationAtTick -- return the time in seconds
+//    value at the given input tick time. (Ticks input could be made double).
+//
+
+double MidiFile::linearSecondInterpolationAtTick(int ticktime) {
+	if (m_timemapvalid == 0) {
+		buildTimeMap();
+		if (m_timemapvalid == 0) {
+			return -1.0;    // something went wrong
+		}
 	}
-	return 1;
+
+	int i;
+	double lasttick = m_timemap[m_timemap.size()-1].tick;
+	// give an error value of -1 if time is out of range of data.
+	if (ticktime < 0.0) {
+		return -1;
+	}
+	if (ticktime > m_timemap.back().tick) {
+		return -1;  // don't try to extrapolate
+	}
+
+	// Guess which side of the list is closest to target:
+	// Could do a more efficient algorithm since time values are sorted,
+	// but good enough for now...
+	int startindex = -1;
+	if (ticktime < lasttick / 2) {
+		for (i=0; i<(int)m_timemap.size(); i++) {
+			if (m_timemap[i].tick > ticktime) {
+				startindex = i-1;
+				break;
+			} else if (m_timemap[i].tick == ticktime) {
+				startindex = i;
+				break;
+			}
+		}
+	} else {
+		for (i=(int)m_timemap.size()-1; i>0; i--) {
+			if (m_timemap[i].tick < ticktime) {
+				startindex = i;
+				break;
+			} else if (m_timemap[i].tick == ticktime) {
+				startindex = i;
+				break;
+			}
+		}
+	}
+
+	if (startindex < 0) {
+		return -1;
+	}
+	if (startindex >= (int)m_timemap.size()-1) {
+		return -1;
+	}
+
+	if (m_timemap[startindex].tick == ticktime) {
+		return m_timemap[startindex].seconds;
+	}
+
+	double x1 = m_timemap[startindex].tick;
+	double x2 = m_timemap[startindex+1].tick;
+	double y1 = m_timemap[startindex].seconds;
+	double y2 = m_timemap[startindex+1].seconds;
+	double xi = ticktime;
+
+	return (xi-x1) * ((y2-y1)/(x2-x1)) + y1;
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::buildTimeMap -- build an index of the absolute tick values
+//      found in a MIDI file, and their corresponding time values in
+//      seconds, taking into consideration tempo change messages.  If no
+//      tempo messages are given (or until they are given, then the
+//      tempo is set to 120 beats per minute).  If SMPTE time code is
+//      used, then ticks are actually time values.  So don't build
+//      a time map for SMPTE ticks, and just calculate the time in
+//      seconds from the tick value (1000 ticks per second SMPTE
+//      is the only mode tested (25 frames per second and 40 subframes
+//      per frame).
+//
+
+void MidiFile::buildTimeMap(void) {
+
+	// convert the MIDI file to absolute time representation
+	// in single track mode (and undo if the MIDI file was not
+	// in that state when this function was called.
+	//
+	int trackstate = getTrackState();
+	int timestate  = getTickState();
+
+	makeAbsoluteTicks();
+	joinTracks();
+
+	int allocsize = getNumEvents(0);
+	m_timemap.reserve(allocsize+10);
+	m_timemap.clear();
+
+	_TickTime value;
+
+	int lasttick = 0;
+	int tickinit = 0;
+
+	int i;
+	int tpq = getTicksPerQuarterNote();
+	double defaultTempo = 120.0;
+	double secondsPerTick = 60.0 / (defaultTempo * tpq);
+
+	double lastsec = 0.0;
+	double cursec = 0.0;
+
+	for (i=0; i<getNumEvents(0); i++) {
+		int curtick = getEvent(0, i).tick;
+		getEvent(0, i).seconds = cursec;
+		if ((curtick > lasttick) || !tickinit) {
+			tickinit = 1;
+
+			// calculate the current time in seconds:
+			cursec = lastsec + (curtick - lasttick) * secondsPerTick;
+			getEvent(0, i).seconds = cursec;
+
+			// store the new tick to second mapping
+			value.tick = curtick;
+			value.seconds = cursec;
+			m_timemap.push_back(value);
+			lasttick   = curtick;
+			lastsec    = cursec;
+		}
+
+		// update the tempo if needed:
+		if (getEvent(0,i).isTempo()) {
+			secondsPerTick = getEvent(0,i).getTempoSPT(getTicksPerQuarterNote());
+		}
+	}
+
+	// reset the states of the tracks or time values if necessary here:
+	if (timestate == TIME_STATE_DELTA) {
+		deltaTicks();
+	}
+	if (trackstate == TRACK_STATE_SPLIT) {
+		splitTracks();
+	}
+
+	m_timemapvalid = 1;
+
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::extractMidiData -- Extract MIDI data from input
+//    stream.  Return value is 0 if failure; otherwise, returns 1.
+//
+
+int MidiFile::extractMidiData(std::istream& input, std::vector<uchar>& array,
+	uchar& runningCommand) {
+
+	int character;
+	uchar byte;
+	array.clear();
+	int runningQ;
+
+	character = input.get();
+	if (character == EOF) {
+		std::cerr << "Error: unexpected end of file." << std::endl;
+		return 0;
+	} else {
+		byte = (uchar)character;
+	}
+
+	if (byte < 0x80) {
+		runningQ = 1;
+		if (runningCommand == 0) {
+			std::cerr << "Error: running command with no previous command" << std::endl;
+			return 0;
+		}
+		if (runningCommand >= 0xf0) {
+			std::cerr << "Error: running status not permitted with meta and sysex"
+			     << " event." << std::endl;
+			std::cerr << "Byte is 0x" << std::hex << (int)byte << std::dec << std::endl;
+			return 0;
+		}
+	} else {
+		runningCommand = byte;
+		runningQ = 0;
+	}
+
+	array.push_back(runningCommand);
+	if (runningQ) {
+		array.push_back(byte);
+	}
+
+	switch (runningCommand & 0xf0) {
+		case 0x80:        // note off (2 more bytes)
+		case 0x90:        // note on (2 more bytes)
+		case 0xA0:        // aftertouch (2 more bytes)
+		case 0xB0:        // cont. controller (2 more bytes)
+		case 0xE0:        // pitch wheel (2 more bytes)
+			byte = readByte(input);
+			if (!status()) { return m_rwstatus; }
+			if (byte > 0x7f) {
+				std::cerr << "MIDI data byte too large: " << (int)byte << std::endl;
+				m_rwstatus = false; return m_rwstatus;
+			}
+			array.push_back(byte);
+			if (!runningQ) {
+				byte = readByte(input);
+				if (!status()) { return m_rwstatus; }
+				if (byte > 0x7f) {
+					std::cerr << "MIDI data byte too large: " << (int)byte << std::endl;
+					m_rwstatus = false; return m_rwstatus;
+				}
+				array.push_back(byte);
+			}
+			break;
+		case 0xC0:        // patch change (1 more byte)
+		case 0xD0:        // channel pressure (1 more byte)
+			if (!runningQ) {
+				byte = readByte(input);
+				if (!status()) { return m_rwstatus; }
+				if (byte > 0x7f) {
+					std::cerr << "MIDI data byte too large: " << (int)byte << std::endl;
+					m_rwstatus = false; return m_rwstatus;
+				}
+				array.push_back(byte);
+			}
+			break;
+		case 0xF0:
+			switch (runningCommand) {
+				case 0xff:                 // meta event
+					{
+					if (!runningQ) {
+						byte = readByte(input); // meta type
+						if (!status()) { return m_rwstatus; }
+						array.push_back(byte);
+					}
+					ulong length = 0;
+					uchar byte1 = 0;
+					uchar byte2 = 0;
+					uchar byte3 = 0;
+					uchar byte4 = 0;
+					byte1 = readByte(input);
+					if (!status()) { return m_rwstatus; }
+					array.push_back(byte1);
+					if (byte1 >= 0x80) {
+						byte2 = readByte(input);
+						if (!status()) { return m_rwstatus; }
+						array.push_back(byte2);
+						if (byte2 >= 0x80) {
+							byte3 = readByte(input);
+							if (!status()) { return m_rwstatus; }
+							array.push_back(byte3);
+							if (byte3 >= 0x80) {
+								byte4 = readByte(input);
+								if (!status()) { return m_rwstatus; }
+								array.push_back(byte4);
+								if (byte4 >= 0x80) {
+									std::cerr << "Error: cannot handle large VLVs" << std::endl;
+									m_rwstatus = false; return m_rwstatus;
+								} else {
+									length = unpackVLV(byte1, byte2, byte3, byte4);
+									if (!m_rwstatus) { return m_rwstatus; }
+								}
+							} else {
+								length = unpackVLV(byte1, byte2, byte3);
+								if (!m_rwstatus) { return m_rwstatus; }
+							}
+						} else {
+							length = unpackVLV(byte1, byte2);
+							if (!m_rwstatus) { return m_rwstatus; }
+						}
+					} else {
+						length = byte1;
+					}
+					for (int j=0; j<(int)length; j++) {
+						byte = readByte(input); // meta type
+						if (!status()) { return m_rwstatus; }
+						array.push_back(byte);
+					}
+					}
+					break;
+
+				// The 0xf0 and 0xf7 meta commands deal with system-exclusive
+				// messages. 0xf0 is used to either start a message or to store
+				// a complete message.  The 0xf0 is part of the outgoing MIDI
+				// bytes.  The 0xf7 message is used to send arbitrary bytes,
+				// typically the middle or ends of system exclusive messages.  The
+				// 0xf7 byte at the start of the message is not part of the
+				// outgoing raw MIDI bytes, but is kept in the MidiFile message
+				// to indicate a raw MIDI byte message (typically a partial
+				// system exclusive message).
+				case 0xf7:   // Raw bytes. 0xf7 is not part of the raw
+				             // bytes, but are included to indicate
+				             // that this is a raw byte message.
+				case 0xf0:   // System Exclusive message
+					{         // (complete, or start of message).
+					int length = (int)readVLValue(input);
+					for (int i=0; i<length; i++) {
+						byte = readByte(input);
+						if (!status()) { return m_rwstatus; }
+						array.push_back(byte);
+					}
+					}
+					break;
+
+				// other "F" MIDI commands are not expected, but can be
+				// handled here if they exist.
+			}
+			break;
+		default:
+			std::cout << "Error reading midifile" << std::endl;
+			std::cout << "Command byte was " << (int)runningCommand << std::endl;
+			return 0;
+	}
+	return 1;
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::readVLValue -- The VLV value is expected to be unpacked into
+//   a 4-byte integer no greater than 0x0fffFFFF, so a VLV value up to
+//   4-bytes in size (FF FF FF 7F) will only be considered.  Longer
+//   VLV values are not allowed in standard MIDI files, so the extract
+//   delta time would be truncated and the extra byte(s) will be parsed
+//   incorrectly as a MIDI command.
+//
+
+ulong MidiFile::readVLValue(std::istream& input) {
+	uchar b[5] = {0};
+
+    for (uchar &item : b) {
+            item = readByte(input);
+            if (!status()) {
+                    return m_rwstatus;
+            }
+            if (item < 0x80) {
+                    break;
+            }
+    }
+
+    return unpackVLV(b[0], b[1], b[2], b[3], b[4]);
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::unpackVLV -- converts a VLV value to an unsigned long value.
+//     The bytes a, b, c, d, e are in big-endian order (the order they would
+//     be read out of the MIDI file).
+// default values: a = b = c = d = 0;
+//
+
+ulong MidiFile::unpackVLV(uchar a, uchar b, uchar c, uchar d, uchar e) {
+	uchar bytes[5] = {a, b, c, d, e};
+	int count = 0;
+	while ((count < 5) && (bytes[count] > 0x7f)) {
+		count++;
+	}
+	count++;
+	if (count >= 6) {
+		std::cerr << "VLV number is too large" << std::endl;
+		m_rwstatus = false;
+		return 0;
+	}
+
+	ulong output = 0;
+	for (int i=0; i<count; i++) {
+		output = output << 7;
+		output = output | (bytes[i] & 0x7f);
+	}
+
+	return output;
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::writeVLValue -- write a number to the midifile
+//    as a variable length value which segments a file into 7-bit
+//    values and adds a continuation bit to each.  Maximum size of input
+//    aValue is 0x0FFFffff.
+//
+
+void MidiFile::writeVLValue(long aValue, std::vector<uchar>& outdata) {
+	uchar bytes[4] = {0};
+
+	if ((unsigned long)aValue >= (1 << 28)) {
+		std::cerr << "Error: number too large to convert to VLV" << std::endl;
+		aValue = 0x0FFFffff;
+	}
+
+	bytes[0] = (uchar)(((ulong)aValue >> 21) & 0x7f);  // most significant 7 bits
+	bytes[1] = (uchar)(((ulong)aValue >> 14) & 0x7f);
+	bytes[2] = (uchar)(((ulong)aValue >> 7)  & 0x7f);
+	bytes[3] = (uchar)(((ulong)aValue)       & 0x7f);  // least significant 7 bits
+
+	int start = 0;
+	while ((start<4) && (bytes[start] == 0))  start++;
+
+	for (int i=start; i<3; i++) {
+		bytes[i] = bytes[i] | 0x80;
+		outdata.push_back(bytes[i]);
+	}
+	outdata.push_back(bytes[3]);
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::clear_no_deallocate -- Similar to clear() but does not
+//   delete the Events in the lists.  This is primarily used internally
+//   to the MidiFile class, so don't use unless you really know what you
+//   are doing (otherwise you will end up with memory leaks or
+//   segmentation faults).
+//
+
+void MidiFile::clear_no_deallocate(void) {
+	clearLazyIndex();
+	for (int i=0; i<getTrackCount(); i++) {
+		m_events[i]->detach();
+		delete m_events[i];
+		m_events[i] = NULL;
+	}
+	m_events.resize(1);
+	m_events[0] = new MidiEventList;
+	m_timemapvalid=0;
+	m_timemap.clear();
+	// m_events.resize(0);   // causes a memory leak [20150205 Jorden Thatcher]
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::ticksearch -- for finding a tick entry in the time map.
+//
+
+int MidiFile::ticksearch(const void* A, const void* B) {
+	_TickTime& a = *((_TickTime*)A);
+	_TickTime& b = *((_TickTime*)B);
+
+	if (a.tick < b.tick) {
+		return -1;
+	} else if (a.tick > b.tick) {
+		return 1;
+	}
+	return 0;
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::secondsearch -- for finding a second entry in the time map.
+//
+
+int MidiFile::secondsearch(const void* A, const void* B) {
+	_TickTime& a = *((_TickTime*)A);
+	_TickTime& b = *((_TickTime*)B);
+
+	if (a.seconds < b.seconds) {
+		return -1;
+	} else if (a.seconds > b.seconds) {
+		return 1;
+	}
+	return 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// Static functions:
+//
+
+
+//////////////////////////////
+//
+// MidiFile::readLittleEndian4Bytes -- Read four bytes which are in
+//      little-endian order (smallest byte is first).  Then flip
+//      the order of the bytes to create the return value.
+//
+
+ulong MidiFile::readLittleEndian4Bytes(std::istream& input) {
+	uchar buffer[4] = {0};
+	input.read((char*)buffer, 4);
+	if (input.eof()) {
+		std::cerr << "Error: unexpected end of file." << std::endl;
+		return 0;
+	}
+	return buffer[3] | (buffer[2] << 8) | (buffer[1] << 16) | (buffer[0] << 24);
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::readLittleEndian2Bytes -- Read two bytes which are in
+//       little-endian order (smallest byte is first).  Then flip
+//       the order of the bytes to create the return value.
+//
+
+ushort MidiFile::readLittleEndian2Bytes(std::istream& input) {
+	uchar buffer[2] = {0};
+	input.read((char*)buffer, 2);
+	if (input.eof()) {
+		std::cerr << "Error: unexpected end of file." << std::endl;
+		return 0;
+	}
+	return buffer[1] | (buffer[0] << 8);
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::readByte -- Read one byte from input stream.  Set
+//     fail status error if there was a problem (calling function
+//     has to check this status for an error after reading).
+//
+
+uchar MidiFile::readByte(std::istream& input) {
+	uchar buffer[1] = {0};
+	input.read((char*)buffer, 1);
+	if (input.eof()) {
+		std::cerr << "Error: unexpected end of file." << std::endl;
+		m_rwstatus = false;
+		return 0;
+	}
+	return buffer[0];
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::writeLittleEndianUShort --
+//
+
+std::ostream& MidiFile::writeLittleEndianUShort(std::ostream& out, ushort value) {
+	union { char bytes[2]; ushort us; } data;
+	data.us = value;
+	out << data.bytes[0];
+	out << data.bytes[1];
+	return out;
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::writeBigEndianUShort --
+//
+
+std::ostream& MidiFile::writeBigEndianUShort(std::ostream& out, ushort value) {
+	union { char bytes[2]; ushort us; } data;
+	data.us = value;
+	out << data.bytes[1];
+	out << data.bytes[0];
+	return out;
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::writeLittleEndianShort --
+//
+
+std::ostream& MidiFile::writeLittleEndianShort(std::ostream& out, short value) {
+	union { char bytes[2]; short s; } data;
+	data.s = value;
+	out << data.bytes[0];
+	out << data.bytes[1];
+	return out;
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::writeBigEndianShort --
+//
+
+std::ostream& MidiFile::writeBigEndianShort(std::ostream& out, short value) {
+	union { char bytes[2]; short s; } data;
+	data.s = value;
+	out << data.bytes[1];
+	out << data.bytes[0];
+	return out;
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::writeLittleEndianULong --
+//
+
+std::ostream& MidiFile::writeLittleEndianULong(std::ostream& out, ulong value) {
+	union { char bytes[4]; ulong ul; } data;
+	data.ul = value;
+	out << data.bytes[0];
+	out << data.bytes[1];
+	out << data.bytes[2];
+	out << data.bytes[3];
+	return out;
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::writeBigEndianULong --
+//
+
+std::ostream& MidiFile::writeBigEndianULong(std::ostream& out, ulong value) {
+	union { char bytes[4]; long ul; } data;
+	data.ul = value;
+	out << data.bytes[3];
+	out << data.bytes[2];
+	out << data.bytes[1];
+	out << data.bytes[0];
+	return out;
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::writeLittleEndianLong --
+//
+
+std::ostream& MidiFile::writeLittleEndianLong(std::ostream& out, long value) {
+	union { char bytes[4]; long l; } data;
+	data.l = value;
+	out << data.bytes[0];
+	out << data.bytes[1];
+	out << data.bytes[2];
+	out << data.bytes[3];
+	return out;
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::writeBigEndianLong --
+//
+
+std::ostream& MidiFile::writeBigEndianLong(std::ostream& out, long value) {
+	union { char bytes[4]; long l; } data;
+	data.l = value;
+	out << data.bytes[3];
+	out << data.bytes[2];
+	out << data.bytes[1];
+	out << data.bytes[0];
+	return out;
+
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::writeBigEndianFloat --
+//
+
+std::ostream& MidiFile::writeBigEndianFloat(std::ostream& out, float value) {
+	union { char bytes[4]; float f; } data;
+	data.f = value;
+	out << data.bytes[3];
+	out << data.bytes[2];
+	out << data.bytes[1];
+	out << data.bytes[0];
+	return out;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::readVLValue -- The VLV value is expected to be unpacked into
-//   a 4-byte integer no greater than 0x0fffFFFF, so a VLV value up to
-//   4-bytes in size (FF FF FF 7F) will only be considered.  Longer
-//   VLV values are not allowed in standard MIDI files, so the extract
-//   delta time would be truncated and the extra byte(s) will be parsed
-//   incorrectly as a MIDI command.
+// MidiFile::writeLittleEndianFloat --
 //
 
-ulong MidiFile::readVLValue(std::istream& input) {
-	uchar b[5] = {0};
+std::ostream& MidiFile::writeLittleEndianFloat(std::ostream& out, float value) {
+	union { char bytes[4]; float f; } data;
+	data.f = value;
+	out << data.bytes[0];
+	out << data.bytes[1];
+	out << data.bytes[2];
+	out << data.bytes[3];
+	return out;
+}
 
-    for (uchar &item : b) {
-            item = readByte(input);
-            if (!status()) {
-                    return m_rwstatus;
-            }
-            if (item < 0x80) {
-                    break;
-            }
-    }
 
-    return unpackVLV(b[0], b[1], b[2], b[3], b[4]);
+
+//////////////////////////////
+//
+// MidiFile::writeBigEndianDouble --
+//
+
+std::ostream& MidiFile::writeBigEndianDouble(std::ostream& out, double value) {
+	union { char bytes[8]; double d; } data;
+	data.d = value;
+	out << data.bytes[7];
+	out << data.bytes[6];
+	out << data.bytes[5];
+	out << data.bytes[4];
+	out << data.bytes[3];
+	out << data.bytes[2];
+	out << data.bytes[1];
+	out << data.bytes[0];
+	return out;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::unpackVLV -- converts a VLV value to an unsigned long value.
-//     The bytes a, b, c, d, e are in big-endian order (the order they would
-//     be read out of the MIDI file).
-// default values: a = b = c = d = 0;
+// MidiFile::writeLittleEndianDouble --
 //
 
-ulong MidiFile::unpackVLV(uchar a, uchar b, uchar c, uchar d, uchar e) {
-	uchar bytes[5] = {a, b, c, d, e};
-	int count = 0;
-	while ((count < 5) && (bytes[count] > 0x7f)) {
-		count++;
+std::ostream& MidiFile::writeLittleEndianDouble(std::ostream& out, double value) {
+	union { char bytes[8]; double d; } data;
+	data.d = value;
+	out << data.bytes[0];
+	out << data.bytes[1];
+	out << data.bytes[2];
+	out << data.bytes[3];
+	out << data.bytes[4];
+	out << data.bytes[5];
+	out << data.bytes[6];
+	out << data.bytes[7];
+	return out;
+}
+
+
+
+////////////////////
+//
+// MidiFile::getGMInstrumentName -- return the General MIDI instrument name
+//    for the given patch change index (in the range from 0 to 127).
+//
+
+std::string MidiFile::getGMInstrumentName(int patchIndex) {
+	if (patchIndex < 0) {
+		return "";
 	}
-	count++;
-	if (count >= 6) {
-		std::cerr << "VLV number is too large" << std::endl;
-		m_rwstatus = false;
-		return 0;
+	if (patchIndex > 127) {
+		return "";
 	}
+	return GMinstrument[patchIndex];
+}
 
-	ulong output = 0;
-	for (int i=0; i<count; i++) {
-		output = output << 7;
-		output = output | (bytes[i] & 0x7f);
-	}
 
+
+//////////////////////////////
+//
+// MidiFile::base64Encode -- Encode a string as base64.
+//
+
+std::string MidiFile::base64Encode(const std::string& input) {
+	std::string output;
+	output.reserve(((input.size()/3) + (input.size() % 3 > 0)) * 4);
+	int vala = 0;
+	int valb = -6;
+	for (uchar c : input) {
+		vala = (vala << 8) + c;
+		valb += 8;
+		while (valb >=0) {
+			output.push_back(MidiFile::encodeLookup[(vala >> valb) & 0x3F]);
+			valb -= 6;
+		}
+	}
+	if (valb > -6) {
+		output.push_back(MidiFile::encodeLookup[((vala << 8) >> (valb + 8)) & 0x3F]);
+	}
+	while (output.size() % 4) {
+		output.push_back(MidiFile::encodeLookup.back());
+	}
 	return output;
 }
 
@@ -3038,441 +4225,537 @@ ulong MidiFile::unpackVLV(uchar a, uchar b, uchar c, uchar d, uchar e) {
 
 //////////////////////////////
 //
-// MidiFile::writeVLValue -- write a number to the midifile
-//    as a variable length value which segments a file into 7-bit
-//    values and adds a continuation bit to each.  Maximum size of input
-//    aValue is 0x0FFFffff.
+// MidiFile::base64Decode -- Decode a base64 string.
 //
 
-void MidiFile::writeVLValue(long aValue, std::vector<uchar>& outdata) {
-	uchar bytes[4] = {0};
+std::string MidiFile::base64Decode(const std::string& input) {
+	// vector<int> decodeLookup(256,-1);
+	// for (int i=0; i<64; i++) decodeLookup[encodeLookup[i]] = i;
 
-	if ((unsigned long)aValue >= (1 << 28)) {
-		std::cerr << "Error: number too large to convert to VLV" << std::endl;
-		aValue = 0x0FFFffff;
+	std::string output;
+	int vala = 0;
+	int valb = -8;
+	for (uchar c : input) {
+		if (c == '=') {
+			break;
+		} else if (MidiFile::decodeLookup[c] == -1) {
+         // Ignore whitespace, for example.
+			continue;
+		}
+		vala = (vala << 6) + MidiFile::decodeLookup[c];
+		valb += 6;
+		if (valb >= 0) {
+			output.push_back(char((vala >> valb) & 0xFF));
+			valb -= 8;
+		}
 	}
+	return output;
+}
 
-	bytes[0] = (uchar)(((ulong)aValue >> 21) & 0x7f);  // most significant 7 bits
-	bytes[1] = (uchar)(((ulong)aValue >> 14) & 0x7f);
-	bytes[2] = (uchar)(((ulong)aValue >> 7)  & 0x7f);
-	bytes[3] = (uchar)(((ulong)aValue)       & 0x7f);  // least significant 7 bits
 
-	int start = 0;
-	while ((start<4) && (bytes[start] == 0))  start++;
 
-	for (int i=start; i<3; i++) {
-		bytes[i] = bytes[i] | 0x80;
-		outdata.push_back(bytes[i]);
+///////////////////////////////////////////////////////////////////////////
+//
+// SmfData
+//
+
+//////////////////////////////
+//
+// SmfData::SmfData -- Constructor.
+//
+
+SmfData::SmfData(void) {
+	// do nothing
+}
+
+
+
+//////////////////////////////
+//
+// SmfData::~SmfData -- Deconstructor.
+//
+
+SmfData::~SmfData() {
+	close();
+}
+
+
+
+//////////////////////////////
+//
+// SmfData::open -- Map the file into memory, or read it into a buffer
+//     if it cannot be mapped (empty files, pipes, some file systems).
+//     Returns false if the file cannot be read.
+//
+
+bool SmfData::open(const std::string& filename) {
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+			NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file != INVALID_HANDLE_VALUE) {
+		LARGE_INTEGER filesize;
+		if (GetFileSizeEx(file, &filesize) && (filesize.QuadPart > 0)) {
+			HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (mapping != NULL) {
+				// The view keeps the mapping alive after the handles close.
+				m_data = (const uchar*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+				CloseHandle(mapping);
+			}
+			m_size = (size_t)filesize.QuadPart;
+		}
+		CloseHandle(file);
+	}
+#else
+	int file = ::open(filename.c_str(), O_RDONLY);
+	if (file >= 0) {
+		struct stat info;
+		bool statQ = (fstat(file, &info) == 0);
+		if (statQ && S_ISDIR(info.st_mode)) {
+			// reading a directory as a stream throws instead of failing
+			::close(file);
+			return false;
+		}
+		if (statQ && S_ISREG(info.st_mode) && (info.st_size > 0)) {
+			void* mapped = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+			if (mapped != MAP_FAILED) {
+				m_data = (const uchar*)mapped;
+				m_size = (size_t)info.st_size;
+			}
+		}
+		::close(file);
 	}
-	outdata.push_back(bytes[3]);
+#endif
+
+	if (m_data != NULL) {
+		m_mapped = true;
+		return true;
+	}
+
+	m_size = 0;
+	std::ifstream input(filename.c_str(), std::ios::binary | std::ios::in);
+	if (!input.is_open()) {
+		return false;
+	}
+	m_buffer.assign(std::istreambuf_iterator<char>(input),
+			std::istreambuf_iterator<char>());
+	m_data = m_buffer.data();
+	m_size = m_buffer.size();
+	return true;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::clear_no_deallocate -- Similar to clear() but does not
-//   delete the Events in the lists.  This is primarily used internally
-//   to the MidiFile class, so don't use unless you really know what you
-//   are doing (otherwise you will end up with memory leaks or
-//   segmentation faults).
+// SmfData::close -- Release the file contents.
 //
 
-void MidiFile::clear_no_deallocate(void) {
-	for (int i=0; i<getTrackCount(); i++) {
-		m_events[i]->detach();
-		delete m_events[i];
-		m_events[i] = NULL;
+void SmfData::close(void) {
+	if (m_mapped) {
+#ifdef _WIN32
+		UnmapViewOfFile(m_data);
+#else
+		munmap((void*)m_data, m_size);
+#endif
 	}
-	m_events.resize(1);
-	m_events[0] = new MidiEventList;
-	m_timemapvalid=0;
-	m_timemap.clear();
-	// m_events.resize(0);   // causes a memory leak [20150205 Jorden Thatcher]
+	m_data   = NULL;
+	m_size   = 0;
+	m_mapped = false;
+	m_buffer.clear();
+	m_buffer.shrink_to_fit();
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::ticksearch -- for finding a tick entry in the time map.
+// SmfData::data -- Start of the file contents (NULL when closed).
 //
 
-int MidiFile::ticksearch(const void* A, const void* B) {
-	_TickTime& a = *((_TickTime*)A);
-	_TickTime& b = *((_TickTime*)B);
+const uchar* SmfData::data(void) const {
+	return m_data;
+}
 
-	if (a.tick < b.tick) {
-		return -1;
-	} else if (a.tick > b.tick) {
-		return 1;
-	}
-	return 0;
+
+
+//////////////////////////////
+//
+// SmfData::size -- Number of bytes in the file.
+//
+
+size_t SmfData::size(void) const {
+	return m_size;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// SmfEvent
+//
+
+//////////////////////////////
+//
+// SmfEvent::getChannel -- Channel (0-15) of a channel message.
+//
+
+int SmfEvent::getChannel(void) const {
+	return command & 0x0f;
+}
+
+
+
+//////////////////////////////
+//
+// SmfEvent::getP1, SmfEvent::getP2 -- First and second byte after the
+//    command byte, or -1 if the message is shorter.
+//
+
+int SmfEvent::getP1(void) const {
+	return size > 0 ? data[0] : -1;
+}
+
+
+int SmfEvent::getP2(void) const {
+	return size > 1 ? data[1] : -1;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::secondsearch -- for finding a second entry in the time map.
+// SmfEvent::isNoteOn -- Note-on with non-zero velocity, as
+//    MidiMessage::isNoteOn().
 //
 
-int MidiFile::secondsearch(const void* A, const void* B) {
-	_TickTime& a = *((_TickTime*)A);
-	_TickTime& b = *((_TickTime*)B);
-
-	if (a.seconds < b.seconds) {
-		return -1;
-	} else if (a.seconds > b.seconds) {
-		return 1;
-	}
-	return 0;
+bool SmfEvent::isNoteOn(void) const {
+	return ((command & 0xf0) == 0x90) && (size == 2) && (data[1] != 0);
 }
 
 
-///////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////
 //
-// Static functions:
+// SmfEvent::isNoteOff -- Note-off, or note-on with zero velocity, as
+//    MidiMessage::isNoteOff().
 //
 
+bool SmfEvent::isNoteOff(void) const {
+	if (size != 2) {
+		return false;
+	}
+	return ((command & 0xf0) == 0x80) ||
+			(((command & 0xf0) == 0x90) && (data[1] == 0));
+}
+
+
 
 //////////////////////////////
 //
-// MidiFile::readLittleEndian4Bytes -- Read four bytes which are in
-//      little-endian order (smallest byte is first).  Then flip
-//      the order of the bytes to create the return value.
+// SmfEvent::isController -- Continuous controller message.
 //
 
-ulong MidiFile::readLittleEndian4Bytes(std::istream& input) {
-	uchar buffer[4] = {0};
-	input.read((char*)buffer, 4);
-	if (input.eof()) {
-		std::cerr << "Error: unexpected end of file." << std::endl;
-		return 0;
-	}
-	return buffer[3] | (buffer[2] << 8) | (buffer[1] << 16) | (buffer[0] << 24);
+bool SmfEvent::isController(void) const {
+	return ((command & 0xf0) == 0xB0) && (size == 2);
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::readLittleEndian2Bytes -- Read two bytes which are in
-//       little-endian order (smallest byte is first).  Then flip
-//       the order of the bytes to create the return value.
+// SmfEvent::isMeta -- Meta message (the data starts with its type).
 //
 
-ushort MidiFile::readLittleEndian2Bytes(std::istream& input) {
-	uchar buffer[2] = {0};
-	input.read((char*)buffer, 2);
-	if (input.eof()) {
-		std::cerr << "Error: unexpected end of file." << std::endl;
-		return 0;
-	}
-	return buffer[1] | (buffer[0] << 8);
+bool SmfEvent::isMeta(void) const {
+	return (command == 0xff) && (size > 0);
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::readByte -- Read one byte from input stream.  Set
-//     fail status error if there was a problem (calling function
-//     has to check this status for an error after reading).
+// SmfEvent::getMetaType -- Type of a meta message, or -1.
 //
 
-uchar MidiFile::readByte(std::istream& input) {
-	uchar buffer[1] = {0};
-	input.read((char*)buffer, 1);
-	if (input.eof()) {
-		std::cerr << "Error: unexpected end of file." << std::endl;
-		m_rwstatus = false;
-		return 0;
-	}
-	return buffer[0];
+int SmfEvent::getMetaType(void) const {
+	return isMeta() ? data[0] : -1;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::writeLittleEndianUShort --
+// SmfEvent::isEndOfTrack -- End-of-track meta message.
 //
 
-std::ostream& MidiFile::writeLittleEndianUShort(std::ostream& out, ushort value) {
-	union { char bytes[2]; ushort us; } data;
-	data.us = value;
-	out << data.bytes[0];
-	out << data.bytes[1];
-	return out;
+bool SmfEvent::isEndOfTrack(void) const {
+	return getMetaType() == 0x2f;
 }
 
 
 
+///////////////////////////////////////////////////////////////////////////
+//
+// SmfEventIterator
+//
+
 //////////////////////////////
 //
-// MidiFile::writeBigEndianUShort --
+// SmfEventIterator::SmfEventIterator -- Constructor.  Without a reader
+//    (or at the end of the file) it compares equal to SmfEventReader::end().
 //
 
-std::ostream& MidiFile::writeBigEndianUShort(std::ostream& out, ushort value) {
-	union { char bytes[2]; ushort us; } data;
-	data.us = value;
-	out << data.bytes[1];
-	out << data.bytes[0];
-	return out;
+SmfEventIterator::SmfEventIterator(SmfEventReader* reader) {
+	m_reader = reader;
+	++(*this);
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::writeLittleEndianShort --
+// SmfEventIterator::operator++ -- Move to the next event.
 //
 
-std::ostream& MidiFile::writeLittleEndianShort(std::ostream& out, short value) {
-	union { char bytes[2]; short s; } data;
-	data.s = value;
-	out << data.bytes[0];
-	out << data.bytes[1];
-	return out;
+SmfEventIterator& SmfEventIterator::operator++(void) {
+	if (m_reader && !m_reader->next(m_event)) {
+		m_reader = NULL;
+	}
+	return *this;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::writeBigEndianShort --
+// SmfEventIterator::operator== -- Iterators are equal when both are at
+//    the end, since the reader only moves forward.
 //
 
-std::ostream& MidiFile::writeBigEndianShort(std::ostream& out, short value) {
-	union { char bytes[2]; short s; } data;
-	data.s = value;
-	out << data.bytes[1];
-	out << data.bytes[0];
-	return out;
+bool SmfEventIterator::operator==(const SmfEventIterator& other) const {
+	return m_reader == other.m_reader;
 }
 
 
+bool SmfEventIterator::operator!=(const SmfEventIterator& other) const {
+	return m_reader != other.m_reader;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// SmfEventReader
+//
 
 //////////////////////////////
 //
-// MidiFile::writeLittleEndianULong --
+// SmfEventReader::SmfEventReader -- Constructor.
 //
 
-std::ostream& MidiFile::writeLittleEndianULong(std::ostream& out, ulong value) {
-	union { char bytes[4]; ulong ul; } data;
-	data.ul = value;
-	out << data.bytes[0];
-	out << data.bytes[1];
-	out << data.bytes[2];
-	out << data.bytes[3];
-	return out;
+SmfEventReader::SmfEventReader(void) {
+	// do nothing
+}
+
+
+SmfEventReader::SmfEventReader(const uchar* data, size_t size) {
+	open(data, size);
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::writeBigEndianULong --
+// SmfEventReader::open -- Check the MIDI file header and get ready to
+//    read the first track.  Returns false, with the reason in getError(),
+//    if the data does not start with a header readSmf() accepts.
 //
 
-std::ostream& MidiFile::writeBigEndianULong(std::ostream& out, ulong value) {
-	union { char bytes[4]; long ul; } data;
-	data.ul = value;
-	out << data.bytes[3];
-	out << data.bytes[2];
-	out << data.bytes[1];
-	out << data.bytes[0];
-	return out;
+bool SmfEventReader::open(const uchar* data, size_t size) {
+	m_data   = data;
+	m_end    = data + size;
+	m_pos    = data;
+	m_track  = 0;
+	m_intrack = false;
+	m_done   = true;
+	m_error  = NULL;
+	m_erroroffset = 0;
+
+	if ((size < 4) || (memcmp(data, "MThd", 4) != 0)) {
+		return fail("not a MIDI file", data);
+	}
+	if (size < 14) {
+		return fail("unexpected end of file", m_end);
+	}
+	if (readBigEndian4(data + 4) != 6) {
+		return fail("not a MIDI 1.0 Standard MIDI file", data + 4);
+	}
+	m_format = readBigEndian2(data + 8);
+	if (m_format > 1) {
+		return fail("cannot handle a type-2 MIDI file", data + 8);
+	}
+	m_tracks = readBigEndian2(data + 10);
+	if ((m_format == 0) && (m_tracks != 1)) {
+		return fail("type-0 MIDI file can only contain one track", data + 10);
+	}
+	int division = readBigEndian2(data + 12);
+	if (division >= 0x8000) {
+		m_tpq = (255 - ((division >> 8) & 0x00ff) + 1) * (division & 0x00ff);
+	} else {
+		m_tpq = division;
+	}
+	m_pos  = data + 14;
+	m_done = (m_tracks == 0);
+	return true;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::writeLittleEndianLong --
+// SmfEventReader::next -- Read the next event.  Returns false at the end
+//    of the last track, or on an error (status() is then false).
 //
 
-std::ostream& MidiFile::writeLittleEndianLong(std::ostream& out, long value) {
-	union { char bytes[4]; long l; } data;
-	data.l = value;
-	out << data.bytes[0];
-	out << data.bytes[1];
-	out << data.bytes[2];
-	out << data.bytes[3];
-	return out;
+bool SmfEventReader::next(SmfEvent& event) {
+	if (m_done) {
+		return false;
+	}
+	if (!m_intrack) {
+		// start of a track: like readSmf(), ignore the chunk size and
+		// read up to the end-of-track message.
+		if ((size_t)(m_end - m_pos) < 8) {
+			return fail("unexpected end of file", m_end);
+		}
+		if (memcmp(m_pos, "MTrk", 4) != 0) {
+			return fail("expecting 'MTrk'", m_pos);
+		}
+		m_pos += 8;
+		m_intrack = true;
+		m_tick = 0;
+		m_runningCommand = 0;
+	}
+
+	ulong delta;
+	const char* error = scanVLV(m_pos, m_end, delta);
+	if (!error) {
+		error = scanMessage(m_pos, m_end, m_runningCommand, event.data, event.size);
+	}
+	if (error) {
+		return fail(error, m_pos);
+	}
+	m_tick += delta;
+	event.tick    = m_tick;
+	event.track   = m_track;
+	event.command = m_runningCommand;
+
+	if (event.isEndOfTrack()) {
+		// The next track (if any) is expected right after this message.
+		m_intrack = false;
+		m_track++;
+		m_done = (m_track >= m_tracks);
+	}
+	return true;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::writeBigEndianLong --
+// SmfEventReader::begin, SmfEventReader::end -- Input iterators over the
+//    remaining events.
 //
 
-std::ostream& MidiFile::writeBigEndianLong(std::ostream& out, long value) {
-	union { char bytes[4]; long l; } data;
-	data.l = value;
-	out << data.bytes[3];
-	out << data.bytes[2];
-	out << data.bytes[1];
-	out << data.bytes[0];
-	return out;
+SmfEventIterator SmfEventReader::begin(void) {
+	return SmfEventIterator(this);
+}
+
 
+SmfEventIterator SmfEventReader::end(void) {
+	return SmfEventIterator();
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::writeBigEndianFloat --
+// SmfEventReader::status -- False if reading stopped at an error.
 //
 
-std::ostream& MidiFile::writeBigEndianFloat(std::ostream& out, float value) {
-	union { char bytes[4]; float f; } data;
-	data.f = value;
-	out << data.bytes[3];
-	out << data.bytes[2];
-	out << data.bytes[1];
-	out << data.bytes[0];
-	return out;
+bool SmfEventReader::status(void) const {
+	return m_error == NULL;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::writeLittleEndianFloat --
+// SmfEventReader::getError -- Description of the error, or NULL.
 //
 
-std::ostream& MidiFile::writeLittleEndianFloat(std::ostream& out, float value) {
-	union { char bytes[4]; float f; } data;
-	data.f = value;
-	out << data.bytes[0];
-	out << data.bytes[1];
-	out << data.bytes[2];
-	out << data.bytes[3];
-	return out;
+const char* SmfEventReader::getError(void) const {
+	return m_error;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::writeBigEndianDouble --
+// SmfEventReader::getErrorOffset -- Byte offset of the error in the data.
 //
 
-std::ostream& MidiFile::writeBigEndianDouble(std::ostream& out, double value) {
-	union { char bytes[8]; double d; } data;
-	data.d = value;
-	out << data.bytes[7];
-	out << data.bytes[6];
-	out << data.bytes[5];
-	out << data.bytes[4];
-	out << data.bytes[3];
-	out << data.bytes[2];
-	out << data.bytes[1];
-	out << data.bytes[0];
-	return out;
+size_t SmfEventReader::getErrorOffset(void) const {
+	return m_erroroffset;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::writeLittleEndianDouble --
+// SmfEventReader::getFormat -- MIDI file type (0 or 1).
 //
 
-std::ostream& MidiFile::writeLittleEndianDouble(std::ostream& out, double value) {
-	union { char bytes[8]; double d; } data;
-	data.d = value;
-	out << data.bytes[0];
-	out << data.bytes[1];
-	out << data.bytes[2];
-	out << data.bytes[3];
-	out << data.bytes[4];
-	out << data.bytes[5];
-	out << data.bytes[6];
-	out << data.bytes[7];
-	return out;
+int SmfEventReader::getFormat(void) const {
+	return m_format;
 }
 
 
 
-////////////////////
+//////////////////////////////
 //
-// MidiFile::getGMInstrumentName -- return the General MIDI instrument name
-//    for the given patch change index (in the range from 0 to 127).
+// SmfEventReader::getTrackCount -- Number of tracks in the header.
 //
 
-std::string MidiFile::getGMInstrumentName(int patchIndex) {
-	if (patchIndex < 0) {
-		return "";
-	}
-	if (patchIndex > 127) {
-		return "";
-	}
-	return GMinstrument[patchIndex];
+int SmfEventReader::getTrackCount(void) const {
+	return m_tracks;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::base64Encode -- Encode a string as base64.
+// SmfEventReader::getTicksPerQuarterNote -- Header time division, as
+//    MidiFile::getTicksPerQuarterNote() reports it.
 //
 
-std::string MidiFile::base64Encode(const std::string& input) {
-	std::string output;
-	output.reserve(((input.size()/3) + (input.size() % 3 > 0)) * 4);
-	int vala = 0;
-	int valb = -6;
-	for (uchar c : input) {
-		vala = (vala << 8) + c;
-		valb += 8;
-		while (valb >=0) {
-			output.push_back(MidiFile::encodeLookup[(vala >> valb) & 0x3F]);
-			valb -= 6;
-		}
-	}
-	if (valb > -6) {
-		output.push_back(MidiFile::encodeLookup[((vala << 8) >> (valb + 8)) & 0x3F]);
-	}
-	while (output.size() % 4) {
-		output.push_back(MidiFile::encodeLookup.back());
-	}
-	return output;
+int SmfEventReader::getTicksPerQuarterNote(void) const {
+	return m_tpq;
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::base64Decode -- Decode a base64 string.
+// SmfEventReader::fail -- Stop reading with an error at p.
 //
 
-std::string MidiFile::base64Decode(const std::string& input) {
-	// vector<int> decodeLookup(256,-1);
-	// for (int i=0; i<64; i++) decodeLookup[encodeLookup[i]] = i;
-
-	std::string output;
-	int vala = 0;
-	int valb = -8;
-	for (uchar c : input) {
-		if (c == '=') {
-			break;
-		} else if (MidiFile::decodeLookup[c] == -1) {
-         // Ignore whitespace, for example.
-			continue;
-		}
-		vala = (vala << 6) + MidiFile::decodeLookup[c];
-		valb += 6;
-		if (valb >= 0) {
-			output.push_back(char((vala >> valb) & 0xFF));
-			valb -= 8;
-		}
-	}
-	return output;
+bool SmfEventReader::fail(const char* error, const uchar* p) {
+	m_error = error;
+	m_erroroffset = p - m_data;
+	m_done = true;
+	return false;
 }
 
 
@@ -0,0 +1,238 @@
+// 🎻 Multi-Part Arrangements
+//
+// Builds melody, bass, chord pad and drum parts against one shared
+// harmonic plan.  The plan is fixed before any part starts, so each part
+// generator runs on its own thread with its own RNG and writes into a
+// MidiFile of its own; the finished tracks are moved into the piece once
+// every part is done, so a four-part piece takes about as long as its
+// slowest part.
+
+#ifndef MOOD_ARRANGE_H
+#define MOOD_ARRANGE_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "midifile/include/MidiFile.h"
+#include "mood_batch.h"
+#include "mood_rhythm.h"
+#include "mood_stream.h"
+
+// 🧭 One chord per bar, as a triad stacked on scale degrees.
+struct HarmonicPlan {
+    int tpq = RHYTHM_TPQ;
+    Meter meter;
+    int bars = 0;
+    std::vector<int> roots;              // scale-degree root of each bar
+    std::vector<std::vector<int>> chords;  // MIDI keys of each bar's triad
+
+    int beatTicks() const { return meter.beatTicks(); }
+    int barTicks() const { return meter.barTicks(); }
+    int totalTicks() const { return bars * barTicks(); }
+};
+
+// Plan enough bars of `meter` for `seconds` at `tempo`, cycling through a
+// progression drawn once from a few common degree patterns.
+inline HarmonicPlan makeHarmonicPlan(const std::vector<int>& scale, int tempo, double seconds,
+                                     uint64_t seed, const Meter& meter = Meter()) {
+    static const int progressions[4][4] = {
+        {0, 3, 4, 0}, {0, 5, 3, 4}, {0, 4, 5, 3}, {5, 3, 0, 4}};
+    HarmonicPlan plan;
+    plan.meter = meter;
+    double ticks = seconds * tempo / 60.0 * plan.tpq;
+    plan.bars = std::max(1, static_cast<int>((ticks + plan.barTicks() - 1) / plan.barTicks()));
+
+    MelodyRng rng(seed);
+    const int* progression = progressions[rng.below(4)];
+    int n = static_cast<int>(scale.size());
+    for (int bar = 0; bar < plan.bars; bar++) {
+        int root = progression[bar % 4] % n;
+        std::vector<int> chord;
+        for (int step = 0; step < 3; step++) {
+            int degree = root + 2 * step;
+            chord.push_back(scale[degree % n] + 12 * (degree / n));
+        }
+        plan.roots.push_back(root);
+        plan.chords.push_back(chord);
+    }
+    return plan;
+}
+
+enum ArrangementPart { PART_MELODY, PART_BASS, PART_PAD, PART_DRUMS, PART_COUNT };
+
+struct ArrangementTiming {
+    double part_seconds[PART_COUNT] = {};
+    double total_seconds = 0.0;
+};
+
+inline int nearestChordTone(int key, const std::vector<int>& chord) {
+    int best = key;
+    int best_distance = 128;
+    for (int tone : chord) {
+        int pc = ((tone - key) % 12 + 12) % 12;  // upward distance in semitones
+        int candidate = pc <= 6 ? key + pc : key + pc - 12;
+        int distance = std::abs(candidate - key);
+        if (distance < best_distance) {
+            best = candidate;
+            best_distance = distance;
+        }
+    }
+    return best;
+}
+
+// 🎹 Parts.  Each writes only to `track` of `midi`.
+
+template <class Model>
+void arrangeMelody(smf::MidiFile& midi, int track, const HarmonicPlan& plan, const Model& model,
+                   const RhythmPattern& rhythm, uint64_t seed) {
+    MelodyStream stream(model, rhythm, seed);
+    NoteEvent event;
+    int bar = -1;
+    while (stream.next(event) && event.tick < plan.totalTicks()) {
+        int tick = static_cast<int>(event.tick);
+        int key = event.key;
+        if (tick / plan.barTicks() != bar) {
+            // First note of a bar lands on the nearest tone of its chord.
+            bar = tick / plan.barTicks();
+            key = nearestChordTone(key, plan.chords[bar]);
+        }
+        midi.addNoteOn(track, tick, 0, key, 100);
+        midi.addNoteOff(track, static_cast<int>(std::min<long long>(event.offTick(), plan.totalTicks())), 0, key);
+    }
+}
+
+inline void arrangeBass(smf::MidiFile& midi, int track, const HarmonicPlan& plan, uint64_t seed) {
+    MelodyRng rng(seed);
+    int beat = plan.beatTicks();
+    int beats = plan.meter.beats;
+    int half = std::max(1, beats / 2);
+    for (int bar = 0; bar < plan.bars; bar++) {
+        int start = bar * plan.barTicks();
+        int root = plan.chords[bar][0] - 24;
+        int fifth = plan.chords[bar][2] - 24;
+        // Root for the first half of the bar, then root or fifth (in 4/4:
+        // half notes on 1 and 3), with an occasional walking last beat.
+        midi.addNoteOn(track, start, 1, root, 96);
+        midi.addNoteOff(track, start + half * beat, 1, root);
+        int second = rng.below(2) ? fifth : root;
+        bool walk = rng.below(4) == 0 && beats - half > 1;
+        midi.addNoteOn(track, start + half * beat, 1, second, 88);
+        midi.addNoteOff(track, start + (walk ? beats - 1 : beats) * beat, 1, second);
+        if (walk) {
+            int approach = plan.chords[(bar + 1) % plan.bars][0] - 24 - 1;
+            midi.addNoteOn(track, start + (beats - 1) * beat, 1, approach, 80);
+            midi.addNoteOff(track, start + beats * beat, 1, approach);
+        }
+    }
+}
+
+inline void arrangePad(smf::MidiFile& midi, int track, const HarmonicPlan& plan) {
+    for (int bar = 0; bar < plan.bars; bar++) {
+        int start = bar * plan.barTicks();
+        for (int key : plan.chords[bar]) {
+            midi.addNoteOn(track, start, 2, key - 12, 64);
+            midi.addNoteOff(track, start + plan.barTicks(), 2, key - 12);
+        }
+    }
+}
+
+// General MIDI percussion on channel 10: kick, snare, closed hi-hat,
+// with the hi-hat eighths swung like the melody.
+inline void arrangeDrums(smf::MidiFile& midi, int track, const HarmonicPlan& plan,
+                         const RhythmPattern& rhythm, uint64_t seed) {
+    MelodyRng rng(seed);
+    int eighth = plan.tpq / 2;
+    for (int bar = 0; bar < plan.bars; bar++) {
+        int start = bar * plan.barTicks();
+        for (int i = 0; i < plan.barTicks() / eighth; i++) {
+            int tick = static_cast<int>(rhythm.swung(start + i * eighth));
+            int velocity = i % 2 ? 60 : 80;
+            midi.addNoteOn(track, tick, 9, 42, velocity + static_cast<int>(rng.below(12)));
+            midi.addNoteOff(track, tick + eighth / 2, 9, 42);
+            if (i % 4 == 0) {
+                midi.addNoteOn(track, tick, 9, 36, 110);
+                midi.addNoteOff(track, tick + eighth / 2, 9, 36);
+            } else if (i % 4 == 2) {
+                midi.addNoteOn(track, tick, 9, 38, 100);
+                midi.addNoteOff(track, tick + eighth / 2, 9, 38);
+            }
+        }
+    }
+}
+
+// 🏗️ Fill `midi` with a tempo track plus one track per part.  Parts run
+// concurrently, each into its own MidiFile (no MidiFile is shared between
+// threads); the calling thread then swaps their tracks into `midi`.
+template <class Model>
+ArrangementTiming arrangePiece(smf::MidiFile& midi, const HarmonicPlan& plan, const Model& model,
+                               const RhythmPattern& rhythm, int tempo, int instrument,
+                               const std::string& mood, uint64_t seed) {
+    static const int bass_program = 33;  // fingered electric bass
+    static const int pad_program = 89;   // warm pad
+
+    midi.clear();
+    midi.setTicksPerQuarterNote(plan.tpq);
+    midi.addTracks(PART_COUNT);
+    midi.addTempo(0, 0, tempo);
+    midi.addTimeSignature(0, 0, plan.meter.beats, plan.meter.unit);
+
+    // Part p is written to track p + 1 of parts[p], the track it takes in `midi`.
+    smf::MidiFile parts[PART_COUNT];
+    for (int part = 0; part < PART_COUNT; part++) {
+        parts[part].setTicksPerQuarterNote(plan.tpq);
+        parts[part].addTracks(part + 1);
+    }
+    parts[PART_MELODY].addTrackName(1, 0, "Melody");
+    parts[PART_MELODY].addTimbre(1, 0, 0, instrument);
+    parts[PART_BASS].addTrackName(2, 0, "Bass");
+    parts[PART_BASS].addTimbre(2, 0, 1, bass_program);
+    parts[PART_PAD].addTrackName(3, 0, "Pad");
+    parts[PART_PAD].addTimbre(3, 0, 2, pad_program);
+    parts[PART_DRUMS].addTrackName(4, 0, "Drums");
+
+    ArrangementTiming timing;
+    auto timed = [&](int part, auto work) {
+        return [&timing, part, work]() {
+            auto start = std::chrono::steady_clock::now();
+            work();
+            timing.part_seconds[part] =
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        };
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    workers.emplace_back(timed(PART_MELODY, [&]() {
+        arrangeMelody(parts[PART_MELODY], 1, plan, model, rhythm, melodySeed(mood, seed, PART_MELODY));
+        parts[PART_MELODY].sortTrack(1);
+    }));
+    workers.emplace_back(timed(PART_BASS, [&]() {
+        arrangeBass(parts[PART_BASS], 2, plan, melodySeed(mood, seed, PART_BASS));
+        parts[PART_BASS].sortTrack(2);
+    }));
+    workers.emplace_back(timed(PART_PAD, [&]() {
+        arrangePad(parts[PART_PAD], 3, plan);
+        parts[PART_PAD].sortTrack(3);
+    }));
+    workers.emplace_back(timed(PART_DRUMS, [&]() {
+        arrangeDrums(parts[PART_DRUMS], 4, plan, rhythm, melodySeed(mood, seed, PART_DRUMS));
+        parts[PART_DRUMS].sortTrack(4);
+    }));
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    for (int part = 0; part < PART_COUNT; part++) {
+        midi[part + 1] = parts[part][part + 1];  // swaps the event lists
+    }
+    midi.sortTrack(0);
+    timing.total_seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return timing;
+}
+
+#endif // MOOD_ARRANGE_H
@@ -0,0 +1,160 @@
+// 🧵 Batch Melody Generation
+//
+// Produces large catalogs of melodies across all cores.  Every melody
+// draws from its own small RNG seeded from (mood, seed, index), so a
+// catalog is reproduced exactly no matter how many threads build it.
+
+#ifndef MOOD_BATCH_H
+#define MOOD_BATCH_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mood_model.h"
+
+// 🎲 Per-melody RNG (SplitMix64 seeding, xorshift64* stream)
+struct MelodyRng {
+    uint64_t state;
+
+    explicit MelodyRng(uint64_t seed) {
+        state = mix(seed + 0x9E3779B97F4A7C15ULL);
+        if (state == 0) state = 0x9E3779B97F4A7C15ULL;
+    }
+
+    static uint64_t mix(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1DULL;
+    }
+
+    // Uniform integer in [0, n) without a division.
+    uint32_t below(uint32_t n) {
+        return static_cast<uint32_t>(((next() >> 32) * n) >> 32);
+    }
+};
+
+// Seed of melody `index` in the catalog for (mood, seed).
+inline uint64_t melodySeed(const std::string& mood, uint64_t seed, uint64_t index) {
+    uint64_t h = 0xCBF29CE484222325ULL;  // FNV-1a over the mood name
+    for (unsigned char c : mood) {
+        h = (h ^ c) * 0x100000001B3ULL;
+    }
+    return MelodyRng::mix(h ^ MelodyRng::mix(seed ^ MelodyRng::mix(index)));
+}
+
+// 🎶 Same walk as generateMelody(), written into `out` with a caller RNG.
+template <class Rng>
+void generateMelodyInto(int* out, int length, const std::vector<int>& scale,
+                        const std::map<int, std::vector<int>>& transitions, Rng& rng) {
+    uint32_t scale_size = static_cast<uint32_t>(scale.size());
+    int note = scale[rng.below(scale_size)];
+    for (int i = 0; i < length; i++) {
+        out[i] = note;
+        auto it = transitions.find(note);
+        if (it != transitions.end()) {
+            note = it->second[rng.below(static_cast<uint32_t>(it->second.size()))];
+        } else {
+            note = scale[rng.below(scale_size)];
+        }
+    }
+}
+
+struct BatchStats {
+    int melodies = 0;
+    int threads = 0;
+    double seconds = 0.0;
+    double melodies_per_second = 0.0;
+};
+
+// 🏭 Run block(first, n, out) over consecutive blocks of the catalog,
+// where a block is melodies [first, first + n) written at out + first *
+// length.  threads <= 0 uses every hardware thread.
+template <class Block>
+BatchStats runMelodyBlocks(int count, int length, int* out, int threads, Block block) {
+    BatchStats stats;
+    if (threads <= 0) {
+        threads = static_cast<int>(std::thread::hardware_concurrency());
+        if (threads <= 0) threads = 1;
+    }
+    const int chunk = 256;
+    threads = std::max(1, std::min(threads, (count + chunk - 1) / chunk));
+
+    std::atomic<int> next_index(0);
+    auto worker = [&]() {
+        for (;;) {
+            int begin = next_index.fetch_add(chunk, std::memory_order_relaxed);
+            if (begin >= count) break;
+            int end = std::min(begin + chunk, count);
+            block(begin, end - begin, out + static_cast<size_t>(begin) * length);
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; t++) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& th : pool) {
+        th.join();
+    }
+    auto stop = std::chrono::steady_clock::now();
+
+    stats.melodies = count;
+    stats.threads = threads;
+    stats.seconds = std::chrono::duration<double>(stop - start).count();
+    stats.melodies_per_second = stats.seconds > 0.0 ? count / stats.seconds : 0.0;
+    return stats;
+}
+
+// Run kernel(out, length, rng) for every melody of the catalog, writing
+// melody k at out + k * length.
+template <class Kernel>
+BatchStats runMelodyBatch(const std::string& mood, uint64_t seed, int count, int length,
+                          int* out, int threads, Kernel kernel) {
+    return runMelodyBlocks(count, length, out, threads, [&](int first, int n, int* melodies) {
+        for (int j = 0; j < n; j++) {
+            MelodyRng rng(melodySeed(mood, seed, static_cast<uint64_t>(first + j)));
+            kernel(melodies + static_cast<size_t>(j) * length, length, rng);
+        }
+    });
+}
+
+// Batch over the map-based tables.
+inline BatchStats generateMelodyBatch(const std::string& mood, uint64_t seed,
+                                      int count, int length, int* out,
+                                      const std::vector<int>& scale,
+                                      const std::map<int, std::vector<int>>& transitions,
+                                      int threads = 0) {
+    return runMelodyBatch(mood, seed, count, length, out, threads,
+        [&](int* melody, int n, MelodyRng& rng) {
+            generateMelodyInto(melody, n, scale, transitions, rng);
+        });
+}
+
+// Batch over a compiled model (CompiledMood, NgramModel, ...).  A
+// CompiledMood produces the same catalog as the map path.
+template <class Model>
+BatchStats generateMelodyBatch(const std::string& mood, uint64_t seed,
+                               int count, int length, int* out,
+                               const Model& model, int threads = 0) {
+    return runMelodyBatch(mood, seed, count, length, out, threads,
+        [&](int* melody, int n, MelodyRng& rng) {
+            model.generate(melody, n, rng);
+        });
+}
+
+#endif // MOOD_BATCH_H
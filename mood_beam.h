@@ -0,0 +1,261 @@
+// 🔦 Beam-Search Melody Generation
+//
+// Instead of a single random walk, keeps the K best partial melodies.
+// Every step expands each beam by all successors of its last note in
+// the compiled table, scores the candidates, and keeps the top K.  A
+// candidate's score is its model log-probability, plus Gumbel noise
+// drawn from the seed (so different seeds give different melodies, and
+// width 1 is an ordinary random walk), plus whatever the pluggable
+// scorer says about the new note.  Expansion of the beams is split
+// across a small persistent worker pool; beams are stored as back
+// pointers, so a step costs O(K) regardless of melody length.
+
+#ifndef MOOD_BEAM_H
+#define MOOD_BEAM_H
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "mood_batch.h"
+#include "mood_model.h"
+
+// Distinct successors of `row` and their probabilities, read back from
+// the alias table.  Returns the number written (at most 2 * row count).
+inline int rowDistribution(const CompiledMoodView& model, int row, int* notes, double* probs) {
+    const AliasCell* cells = model.cells + model.rows[row].offset;
+    uint32_t count = model.rows[row].count;
+    int n = 0;
+    auto add = [&](int note, double p) {
+        if (p <= 0.0) return;
+        for (int i = 0; i < n; i++) {
+            if (notes[i] == note) {
+                probs[i] += p;
+                return;
+            }
+        }
+        notes[n] = note;
+        probs[n++] = p;
+    };
+    for (uint32_t i = 0; i < count; i++) {
+        double keep = cells[i].threshold == 0xFFFFFFFFu ? 1.0 : cells[i].threshold / 4294967296.0;
+        add(cells[i].note, keep / count);
+        add(cells[i].alias, (1.0 - keep) / count);
+    }
+    return n;
+}
+
+// 🎯 Default scorer: smooth contour, moderate intervals, tonic cadence.
+// Any type with the same score() signature can be passed instead.
+struct ShapeScorer {
+    int tonic = 60;             // pitch class of scale[0] counts as the tonic
+    double interval = 0.35;     // per semitone beyond a whole step
+    double octave = 4.0;        // leaps larger than an octave
+    double repeat = 0.5;        // same note twice in a row
+    double recovery = 1.0;      // a leap answered by a step the other way
+    double cadence = 4.0;       // last note on the tonic
+    double approach = 1.0;      // ... reached by step
+
+    // Change in score for appending `next` after `prev2`, `prev` (-1 when
+    // absent) at `position` of a melody of `length` notes.
+    double score(int prev2, int prev, int next, int position, int length) const {
+        double s = 0.0;
+        if (prev >= 0) {
+            int leap = std::abs(next - prev);
+            s -= interval * std::max(0, leap - 2);
+            if (leap > 12) s -= octave;
+            if (leap == 0) s -= repeat;
+            if (prev2 >= 0 && std::abs(prev - prev2) >= 5 && leap <= 2 && leap > 0 &&
+                (next - prev > 0) != (prev - prev2 > 0)) {
+                s += recovery;
+            }
+        }
+        if (position == length - 1) {
+            bool home = ((next - tonic) % 12 + 12) % 12 == 0;
+            if (home) s += cadence;
+            if (home && prev >= 0 && std::abs(next - prev) <= 2) s += approach;
+        }
+        return s;
+    }
+};
+
+// Runs job(begin, end) over [0, n) on a fixed set of threads, the
+// calling thread included.  Workers stay parked between calls.
+class StepPool {
+public:
+    explicit StepPool(int threads) {
+        if (threads <= 0) {
+            threads = static_cast<int>(std::thread::hardware_concurrency());
+            if (threads <= 0) threads = 1;
+        }
+        m_threads = threads;
+        for (int t = 1; t < threads; t++) {
+            m_workers.emplace_back([this, t]() { work(t); });
+        }
+    }
+
+    ~StepPool() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_start.notify_all();
+        for (auto& worker : m_workers) {
+            worker.join();
+        }
+    }
+
+    int threads() const { return m_threads; }
+
+    void run(int n, const std::function<void(int, int)>& job) {
+        if (m_threads == 1 || n < 2 * m_threads) {
+            job(0, n);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_job = &job;
+            m_n = n;
+            m_remaining = m_threads - 1;
+            m_generation++;
+        }
+        m_start.notify_all();
+        slice(0, job, n);
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this]() { return m_remaining == 0; });
+    }
+
+private:
+    void slice(int t, const std::function<void(int, int)>& job, int n) {
+        int begin = static_cast<int>(static_cast<long long>(n) * t / m_threads);
+        int end = static_cast<int>(static_cast<long long>(n) * (t + 1) / m_threads);
+        job(begin, end);
+    }
+
+    void work(int t) {
+        unsigned long long seen = 0;
+        for (;;) {
+            const std::function<void(int, int)>* job;
+            int n;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_start.wait(lock, [&]() { return m_stop || m_generation != seen; });
+                if (m_stop) return;
+                seen = m_generation;
+                job = m_job;
+                n = m_n;
+            }
+            slice(t, *job, n);
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_remaining--;
+            }
+            m_done.notify_one();
+        }
+    }
+
+    int m_threads = 1;
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_start;
+    std::condition_variable m_done;
+    const std::function<void(int, int)>* m_job = nullptr;
+    int m_n = 0;
+    int m_remaining = 0;
+    unsigned long long m_generation = 0;
+    bool m_stop = false;
+};
+
+struct BeamStats {
+    long long candidates = 0;   // scored expansions
+    double best_score = 0.0;
+};
+
+// 🔎 Best melody of `length` notes under `scorer` with beam width
+// `width`; `noise` scales the Gumbel perturbation (0: deterministic).
+template <class Scorer>
+BeamStats beamSearch(const CompiledMoodView& model, const Scorer& scorer, int length, int width,
+                     uint64_t seed, int* out, StepPool& pool, double noise = 1.0) {
+    struct Candidate {
+        double score;
+        int parent;
+        int note;
+    };
+    static constexpr int MAX_FANOUT = 128;  // distinct MIDI keys
+
+    BeamStats stats;
+    if (length <= 0) return stats;
+    width = std::max(1, width);
+    std::vector<int> parents(static_cast<size_t>(length) * width, -1);
+    std::vector<int> notes(static_cast<size_t>(length) * width, 0);
+    std::vector<double> scores(width, 0.0), next_scores(width);
+    std::vector<int> last(width, CompiledMoodView::START_ROW), prev2(width, -1);
+    std::vector<Candidate> candidates(static_cast<size_t>(width) * MAX_FANOUT);
+    std::vector<int> counts(width);
+    int beams = 1;
+
+    for (int step = 0; step < length; step++) {
+        pool.run(beams, [&](int begin, int end) {
+            int successor[MAX_FANOUT];
+            double prob[MAX_FANOUT];
+            for (int b = begin; b < end; b++) {
+                MelodyRng rng(seed ^ MelodyRng::mix(static_cast<uint64_t>(step) * width + b));
+                int n = rowDistribution(model, last[b], successor, prob);
+                int prev = last[b] == CompiledMoodView::START_ROW ? -1 : last[b];
+                Candidate* slot = &candidates[static_cast<size_t>(b) * MAX_FANOUT];
+                for (int i = 0; i < n; i++) {
+                    double u = (static_cast<double>(rng.next() >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+                    double gumbel = -std::log(-std::log(u));
+                    slot[i].score = scores[b] + std::log(prob[i]) + noise * gumbel +
+                                    scorer.score(prev2[b], prev, successor[i], step, length);
+                    slot[i].parent = b;
+                    slot[i].note = successor[i];
+                }
+                counts[b] = n;
+            }
+        });
+
+        // Gather and keep the best `width` candidates.
+        size_t total = 0;
+        for (int b = 0; b < beams; b++) {
+            Candidate* slot = &candidates[static_cast<size_t>(b) * MAX_FANOUT];
+            std::copy(slot, slot + counts[b], candidates.begin() + total);
+            total += static_cast<size_t>(counts[b]);
+        }
+        stats.candidates += static_cast<long long>(total);
+        int kept = static_cast<int>(std::min<size_t>(total, static_cast<size_t>(width)));
+        auto better = [](const Candidate& a, const Candidate& b) { return a.score > b.score; };
+        std::nth_element(candidates.begin(), candidates.begin() + kept, candidates.begin() + total, better);
+        std::sort(candidates.begin(), candidates.begin() + kept, better);
+
+        std::vector<int> next_last(kept), next_prev2(kept);
+        for (int k = 0; k < kept; k++) {
+            const Candidate& c = candidates[k];
+            parents[static_cast<size_t>(step) * width + k] = c.parent;
+            notes[static_cast<size_t>(step) * width + k] = c.note;
+            next_scores[k] = c.score;
+            next_prev2[k] = last[c.parent] == CompiledMoodView::START_ROW ? -1 : last[c.parent];
+            next_last[k] = c.note;
+        }
+        std::copy(next_scores.begin(), next_scores.begin() + kept, scores.begin());
+        std::copy(next_last.begin(), next_last.end(), last.begin());
+        std::copy(next_prev2.begin(), next_prev2.end(), prev2.begin());
+        beams = kept;
+    }
+
+    // Beam 0 is the best after the final sort; follow its back pointers.
+    stats.best_score = scores[0];
+    for (int step = length - 1, k = 0; step >= 0; step--) {
+        out[step] = notes[static_cast<size_t>(step) * width + k];
+        k = parents[static_cast<size_t>(step) * width + k];
+    }
+    return stats;
+}
+
+#endif // MOOD_BEAM_H
@@ -0,0 +1,56 @@
+// ⏱️ Benchmark Helpers
+//
+// Tiny timing harness shared by the `--bench` modes of moodplayer.
+
+#ifndef MOOD_BENCH_H
+#define MOOD_BENCH_H
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+struct BenchResult {
+    std::string name;
+    double seconds = 0.0;
+    double items_per_second = 0.0;
+    double ns_per_item = 0.0;
+};
+
+// Time `run` (which processes `items` units of work), keeping the best
+// of `repeats` runs to filter out scheduler noise.
+template <class F>
+BenchResult benchItems(const std::string& name, long long items, F run, int repeats = 5) {
+    BenchResult result;
+    result.name = name;
+    double best = 0.0;
+    for (int r = 0; r < repeats; r++) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        auto stop = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(stop - start).count();
+        if (r == 0 || seconds < best) best = seconds;
+    }
+    result.seconds = best;
+    result.items_per_second = best > 0.0 ? items / best : 0.0;
+    result.ns_per_item = items > 0 ? best * 1e9 / items : 0.0;
+    return result;
+}
+
+inline void printBench(const std::vector<BenchResult>& results, const std::string& unit) {
+    if (results.empty()) return;
+    std::printf("%-28s %14s %12s %9s\n", "path", (unit + "/s").c_str(),
+                ("ns/" + unit).c_str(), "speedup");
+    for (const auto& r : results) {
+        std::printf("%-28s %14.0f %12.2f %8.2fx\n", r.name.c_str(), r.items_per_second,
+                    r.ns_per_item, r.ns_per_item > 0.0 ? results[0].ns_per_item / r.ns_per_item : 0.0);
+    }
+}
+
+// Keeps the optimizer from discarding benchmark results.
+inline void benchSink(long long value) {
+    static volatile long long sink;
+    sink = sink + value;
+}
+
+#endif // MOOD_BENCH_H
@@ -0,0 +1,306 @@
+// 🗃️ Content-Addressed Output Cache
+//
+// Keeps encoded output (SMF bytes, note text, ...) under a 128-bit digest
+// of every parameter that went into it, so a repeated request is answered
+// without generating or serializing again.  The memory tier is an LRU
+// list bounded by a byte cap; an optional disk tier stores each entry as
+// <dir>/<digest>.bin, survives restarts and has a byte cap of its own,
+// deleting the oldest files first.  Lookups and inserts are thread-safe;
+// cached buffers are shared, never copied under the lock.
+
+#ifndef MOOD_CACHE_H
+#define MOOD_CACHE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "mood_batch.h"
+
+struct CacheDigest {
+    uint64_t hi = 0;
+    uint64_t lo = 0;
+
+    bool operator==(const CacheDigest& other) const { return hi == other.hi && lo == other.lo; }
+
+    std::string hex() const {
+        char text[33];
+        std::snprintf(text, sizeof(text), "%016llx%016llx", static_cast<unsigned long long>(hi),
+                      static_cast<unsigned long long>(lo));
+        return text;
+    }
+};
+
+struct CacheDigestHash {
+    size_t operator()(const CacheDigest& digest) const { return static_cast<size_t>(digest.lo); }
+};
+
+// 🔑 Digest of a parameter list: two independently mixed 64-bit lanes.
+// Strings are length-prefixed so ("ab", "c") and ("a", "bc") differ.
+class DigestBuilder {
+public:
+    DigestBuilder& add(uint64_t value) {
+        m_hi = MelodyRng::mix(m_hi ^ value) + 0x9E3779B97F4A7C15ULL;
+        m_lo = (m_lo ^ MelodyRng::mix(value + m_count)) * 0x100000001B3ULL;
+        m_count++;
+        return *this;
+    }
+
+    DigestBuilder& add(const std::string& text) {
+        add(static_cast<uint64_t>(text.size()));
+        return add(text.data(), text.size());
+    }
+
+    DigestBuilder& add(const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        while (size > 0) {
+            uint64_t word = 0;
+            size_t take = size < 8 ? size : 8;
+            for (size_t i = 0; i < take; i++) {
+                word |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+            }
+            add(word);
+            bytes += take;
+            size -= take;
+        }
+        return *this;
+    }
+
+    CacheDigest digest() const {
+        CacheDigest digest;
+        digest.hi = MelodyRng::mix(m_hi ^ m_count);
+        digest.lo = MelodyRng::mix(m_lo + m_hi);
+        return digest;
+    }
+
+private:
+    uint64_t m_hi = 0x6A09E667F3BCC908ULL;
+    uint64_t m_lo = 0xCBF29CE484222325ULL;
+    uint64_t m_count = 0;
+};
+
+struct CacheStats {
+    long long hits = 0;         // served from memory
+    long long disk_hits = 0;    // served from the disk tier (then kept in memory)
+    long long misses = 0;
+    long long insertions = 0;
+    long long evictions = 0;
+    long long disk_evictions = 0;
+    size_t entries = 0;
+    size_t bytes = 0;           // payload bytes held in memory
+    size_t max_bytes = 0;
+    size_t disk_entries = 0;
+    size_t disk_bytes = 0;      // payload bytes in the disk tier
+    size_t disk_max_bytes = 0;
+};
+
+class OutputCache {
+public:
+    using Buffer = std::shared_ptr<const std::vector<uint8_t>>;
+
+    // `max_bytes` caps the memory tier; a non-empty `disk_dir` enables
+    // the disk tier (created if missing), capped at `disk_max_bytes`.
+    // Entries already in the directory count against the cap, oldest
+    // first by modification time.
+    explicit OutputCache(size_t max_bytes, const std::string& disk_dir = "",
+                         size_t disk_max_bytes = size_t(1) << 30)
+        : m_max_bytes(max_bytes), m_disk_dir(disk_dir), m_disk_max_bytes(disk_max_bytes) {
+        if (!m_disk_dir.empty()) {
+            std::error_code error;
+            std::filesystem::create_directories(m_disk_dir, error);
+            scanDisk();
+        }
+    }
+
+    // Cached bytes for `key`, or null on a miss.
+    Buffer find(const CacheDigest& key) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_index.find(key);
+            if (it != m_index.end()) {
+                m_lru.splice(m_lru.begin(), m_lru, it->second);
+                m_stats.hits++;
+                return it->second->bytes;
+            }
+        }
+        if (!m_disk_dir.empty()) {
+            auto bytes = std::make_shared<std::vector<uint8_t>>();
+            if (readFile(path(key), *bytes)) {
+                Buffer buffer = bytes;
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stats.disk_hits++;
+                store(key, buffer);
+                return buffer;
+            }
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.misses++;
+        return nullptr;
+    }
+
+    // Cache `bytes` under `key` (memory, and disk when enabled).
+    Buffer insert(const CacheDigest& key, std::vector<uint8_t> bytes) {
+        Buffer buffer = std::make_shared<const std::vector<uint8_t>>(std::move(bytes));
+        if (!m_disk_dir.empty()) {
+            writeFile(key, *buffer);
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.insertions++;
+        store(key, buffer);
+        return buffer;
+    }
+
+    CacheStats stats() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        CacheStats stats = m_stats;
+        stats.entries = m_index.size();
+        stats.bytes = m_bytes;
+        stats.max_bytes = m_max_bytes;
+        std::lock_guard<std::mutex> disk_lock(m_disk_mutex);
+        stats.disk_entries = m_disk_files.size();
+        stats.disk_bytes = m_disk_bytes;
+        stats.disk_max_bytes = m_disk_max_bytes;
+        stats.disk_evictions = m_disk_evictions;
+        return stats;
+    }
+
+private:
+    struct Entry {
+        CacheDigest key;
+        Buffer bytes;
+    };
+
+    struct DiskFile {
+        std::string name;
+        size_t size;
+    };
+
+    // Insert or refresh under the lock, then evict down to the cap.
+    void store(const CacheDigest& key, const Buffer& buffer) {
+        auto it = m_index.find(key);
+        if (it != m_index.end()) {
+            m_bytes -= it->second->bytes->size();
+            m_lru.erase(it->second);
+            m_index.erase(it);
+        }
+        if (buffer->size() > m_max_bytes) return;
+        m_lru.push_front({key, buffer});
+        m_index[key] = m_lru.begin();
+        m_bytes += buffer->size();
+        while (m_bytes > m_max_bytes && !m_lru.empty()) {
+            m_bytes -= m_lru.back().bytes->size();
+            m_index.erase(m_lru.back().key);
+            m_lru.pop_back();
+            m_stats.evictions++;
+        }
+    }
+
+    std::string path(const CacheDigest& key) const {
+        return (std::filesystem::path(m_disk_dir) / (key.hex() + ".bin")).string();
+    }
+
+    // Index the entries left by earlier runs, oldest first, and trim them
+    // to the cap.
+    void scanDisk() {
+        std::vector<std::pair<std::filesystem::file_time_type, DiskFile>> found;
+        std::error_code error;
+        for (std::filesystem::directory_iterator it(m_disk_dir, error), end; !error && it != end;
+             it.increment(error)) {
+            std::error_code file_error;
+            if (it->path().extension() != ".bin" || !it->is_regular_file(file_error)) continue;
+            size_t size = static_cast<size_t>(it->file_size(file_error));
+            auto time = it->last_write_time(file_error);
+            if (!file_error) found.push_back({time, {it->path().filename().string(), size}});
+        }
+        std::sort(found.begin(), found.end(),
+                  [](const auto& a, const auto& b) { return a.first < b.first; });
+        std::lock_guard<std::mutex> lock(m_disk_mutex);
+        for (const auto& file : found) addDiskFile(file.second);
+    }
+
+    // Record a file just written (or found) as the newest, then delete the
+    // oldest files until the tier fits its cap.  Call with m_disk_mutex held.
+    void addDiskFile(const DiskFile& file) {
+        auto it = m_disk_index.find(file.name);
+        if (it != m_disk_index.end()) {
+            m_disk_bytes -= it->second->size;
+            m_disk_files.erase(it->second);
+        }
+        m_disk_files.push_back(file);
+        m_disk_index[file.name] = std::prev(m_disk_files.end());
+        m_disk_bytes += file.size;
+        while (m_disk_bytes > m_disk_max_bytes && !m_disk_files.empty()) {
+            const DiskFile& oldest = m_disk_files.front();
+            std::error_code error;
+            std::filesystem::remove(std::filesystem::path(m_disk_dir) / oldest.name, error);
+            m_disk_bytes -= oldest.size;
+            m_disk_index.erase(oldest.name);
+            m_disk_files.pop_front();
+            m_disk_evictions++;
+        }
+    }
+
+    static bool readFile(const std::string& filename, std::vector<uint8_t>& bytes) {
+        FILE* file = std::fopen(filename.c_str(), "rb");
+        if (!file) return false;
+        bool ok = std::fseek(file, 0, SEEK_END) == 0;
+        long size = ok ? std::ftell(file) : -1;
+        ok = size >= 0 && std::fseek(file, 0, SEEK_SET) == 0;
+        if (ok) {
+            bytes.resize(static_cast<size_t>(size));
+            ok = std::fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+        }
+        std::fclose(file);
+        return ok;
+    }
+
+    // Write to a private temporary name and rename into place, so readers
+    // never see a partial entry.
+    void writeFile(const CacheDigest& key, const std::vector<uint8_t>& bytes) {
+        if (bytes.size() > m_disk_max_bytes) return;
+        std::string target = path(key);
+        std::string temporary = target + "." +
+            std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+        FILE* file = std::fopen(temporary.c_str(), "wb");
+        if (!file) return;
+        bool ok = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+        ok = std::fclose(file) == 0 && ok;
+        std::error_code error;
+        if (ok) {
+            std::filesystem::rename(temporary, target, error);
+        }
+        if (!ok || error) {
+            std::filesystem::remove(temporary, error);
+            return;
+        }
+        std::lock_guard<std::mutex> lock(m_disk_mutex);
+        addDiskFile({key.hex() + ".bin", bytes.size()});
+    }
+
+    size_t m_max_bytes;
+    std::string m_disk_dir;
+    mutable std::mutex m_mutex;
+    std::list<Entry> m_lru;  // most recently used first
+    std::unordered_map<CacheDigest, std::list<Entry>::iterator, CacheDigestHash> m_index;
+    size_t m_bytes = 0;
+    CacheStats m_stats;
+
+    size_t m_disk_max_bytes;
+    mutable std::mutex m_disk_mutex;        // guards the disk index below
+    std::list<DiskFile> m_disk_files;       // oldest first
+    std::unordered_map<std::string, std::list<DiskFile>::iterator> m_disk_index;
+    size_t m_disk_bytes = 0;
+    long long m_disk_evictions = 0;
+};
+
+#endif // MOOD_CACHE_H
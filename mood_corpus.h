@@ -0,0 +1,93 @@
+// 🗂️ Parallel Corpus Ingestion
+//
+// Parses a list of MIDI files on a worker pool.  Each worker pulls file
+// indices from an atomic counter and accumulates into its own
+// NgramCounts; the per-worker tables are merged pairwise at the end,
+// so no lock is ever shared while parsing.
+
+#ifndef MOOD_CORPUS_H
+#define MOOD_CORPUS_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mood_ngram.h"
+
+struct CorpusStats {
+    long long files = 0;
+    long long failed = 0;
+    long long events = 0;
+    long long notes = 0;
+    int threads = 0;
+    double seconds = 0.0;
+    double files_per_second = 0.0;
+    double events_per_second = 0.0;
+};
+
+// Ingest `files` into `counts` using `threads` workers (<= 0: all cores).
+inline CorpusStats ingestCorpus(const std::vector<std::string>& files, NgramCounts& counts,
+                                int threads = 0) {
+    CorpusStats stats;
+    if (threads <= 0) {
+        threads = static_cast<int>(std::thread::hardware_concurrency());
+        if (threads <= 0) threads = 1;
+    }
+    threads = std::max(1, std::min<int>(threads, static_cast<int>(files.size())));
+
+    std::vector<NgramCounts> local(threads, NgramCounts(counts.order));
+    std::vector<long long> failed(threads, 0);
+    std::atomic<size_t> next_file(0);
+
+    auto start = std::chrono::steady_clock::now();
+    auto worker = [&](int t) {
+        for (;;) {
+            size_t index = next_file.fetch_add(1, std::memory_order_relaxed);
+            if (index >= files.size()) break;
+            if (!addMidiFile(local[t], files[index])) {
+                failed[t]++;
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; t++) {
+        pool.emplace_back(worker, t);
+    }
+    worker(0);
+    for (auto& th : pool) {
+        th.join();
+    }
+
+    // Pairwise reduction: each round merges disjoint pairs in parallel.
+    for (int step = 1; step < threads; step *= 2) {
+        std::vector<std::thread> mergers;
+        for (int t = 0; t + step < threads; t += 2 * step) {
+            mergers.emplace_back([&local, t, step]() {
+                local[t].merge(local[t + step]);
+                local[t + step] = NgramCounts(local[t].order);
+            });
+        }
+        for (auto& th : mergers) {
+            th.join();
+        }
+    }
+    counts.merge(local[0]);
+    auto stop = std::chrono::steady_clock::now();
+
+    stats.files = static_cast<long long>(files.size());
+    for (long long f : failed) stats.failed += f;
+    stats.events = local[0].events;
+    stats.notes = local[0].notes;
+    stats.threads = threads;
+    stats.seconds = std::chrono::duration<double>(stop - start).count();
+    if (stats.seconds > 0.0) {
+        stats.files_per_second = stats.files / stats.seconds;
+        stats.events_per_second = stats.events / stats.seconds;
+    }
+    return stats;
+}
+
+#endif // MOOD_CORPUS_H
@@ -0,0 +1,185 @@
+// 🔢 Counter-Based Random Draws
+//
+// Philox4x32-10 turns (seed, melody, note) directly into a 64-bit draw,
+// so the randomness behind any note is a pure function of where it sits
+// instead of the state left behind by earlier draws.  CounterRng wraps
+// it in the next()/below() interface the generators already use.
+//
+// Because draws no longer depend on order, one long first-order melody
+// can be built in parallel chunks: each chunk first runs its chain from
+// every possible entry note at once on the shared draws until they all
+// agree (they coalesce within a few notes), and fills in the rest of the
+// chunk right away.  A short serial pass then completes each chunk's
+// head from the real previous note.  The result equals serial
+// generation note for note, and any bar can be regenerated on its own
+// from the note before it.
+
+#ifndef MOOD_COUNTER_H
+#define MOOD_COUNTER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "mood_model.h"
+
+struct Philox4x32 {
+    static void round(uint32_t counter[4], const uint32_t key[2]) {
+        uint64_t product0 = static_cast<uint64_t>(0xD2511F53u) * counter[0];
+        uint64_t product1 = static_cast<uint64_t>(0xCD9E8D57u) * counter[2];
+        uint32_t c0 = static_cast<uint32_t>(product1 >> 32) ^ counter[1] ^ key[0];
+        uint32_t c2 = static_cast<uint32_t>(product0 >> 32) ^ counter[3] ^ key[1];
+        counter[1] = static_cast<uint32_t>(product1);
+        counter[3] = static_cast<uint32_t>(product0);
+        counter[0] = c0;
+        counter[2] = c2;
+    }
+
+    // Ten rounds over `counter` with `key`, in place.
+    static void block(uint32_t counter[4], uint64_t seed) {
+        uint32_t key[2] = {static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)};
+        for (int i = 0; i < 10; i++) {
+            round(counter, key);
+            key[0] += 0x9E3779B9u;
+            key[1] += 0xBB67AE85u;
+        }
+    }
+};
+
+// Draw for note `index` of melody `melody` under `seed`.  One Philox
+// block yields the draws of two neighbouring notes.
+inline uint64_t counterDraw(uint64_t seed, uint64_t melody, uint64_t index) {
+    uint64_t pair = index >> 1;
+    uint32_t counter[4] = {static_cast<uint32_t>(pair), static_cast<uint32_t>(pair >> 32),
+                           static_cast<uint32_t>(melody), static_cast<uint32_t>(melody >> 32)};
+    Philox4x32::block(counter, seed);
+    int half = static_cast<int>(index & 1) * 2;
+    return (static_cast<uint64_t>(counter[half]) << 32) | counter[half + 1];
+}
+
+// 🎲 Sequential reader over the draws of one melody, starting anywhere.
+class CounterRng {
+public:
+    CounterRng(uint64_t seed, uint64_t melody, uint64_t position = 0)
+        : m_seed(seed), m_melody(melody), m_position(position) {}
+
+    uint64_t next() {
+        uint64_t pair = m_position >> 1;
+        if (pair != m_pair || !m_valid) {
+            m_block[0] = static_cast<uint32_t>(pair);
+            m_block[1] = static_cast<uint32_t>(pair >> 32);
+            m_block[2] = static_cast<uint32_t>(m_melody);
+            m_block[3] = static_cast<uint32_t>(m_melody >> 32);
+            Philox4x32::block(m_block, m_seed);
+            m_pair = pair;
+            m_valid = true;
+        }
+        int half = static_cast<int>(m_position & 1) * 2;
+        m_position++;
+        return (static_cast<uint64_t>(m_block[half]) << 32) | m_block[half + 1];
+    }
+
+    uint32_t below(uint32_t n) {
+        return static_cast<uint32_t>(((next() >> 32) * n) >> 32);
+    }
+
+    uint64_t position() const { return m_position; }
+
+private:
+    uint64_t m_seed;
+    uint64_t m_melody;
+    uint64_t m_position;
+    uint64_t m_pair = 0;
+    bool m_valid = false;
+    uint32_t m_block[4] = {};
+};
+
+// Notes [begin, end) of a melody from `model`, given the note before
+// `begin` (ignored when begin is 0).  Matches model.generate() with a
+// CounterRng on the same (seed, melody).
+inline void regenerateRange(const CompiledMoodView& model, uint64_t seed, uint64_t melody,
+                            long long begin, long long end, int previous, int* out) {
+    CounterRng rng(seed, melody, static_cast<uint64_t>(begin));
+    int row = begin == 0 ? CompiledMoodView::START_ROW : previous;
+    for (long long i = begin; i < end; i++) {
+        row = model.sample(row, rng.next());
+        out[i - begin] = row;
+    }
+}
+
+// 🧩 Whole melody in parallel chunks; identical to serial generation.
+inline void generateChunked(const CompiledMoodView& model, uint64_t seed, uint64_t melody,
+                            int* out, long long length, int threads, long long chunk = 1 << 16) {
+    if (length <= 0) return;
+    if (threads <= 0) {
+        threads = static_cast<int>(std::thread::hardware_concurrency());
+        if (threads <= 0) threads = 1;
+    }
+    chunk = std::max(1LL, chunk);
+    long long chunks = (length + chunk - 1) / chunk;
+    threads = static_cast<int>(std::max(1LL, std::min<long long>(threads, chunks)));
+
+    // Every key a chunk can be entered from.
+    std::vector<int> entries;
+    for (uint32_t i = 0; i < model.cell_count; i++) {
+        entries.push_back(model.cells[i].note);
+        entries.push_back(model.cells[i].alias);
+    }
+    std::sort(entries.begin(), entries.end());
+    entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+
+    // First note of each chunk that is already final (chunk end: none).
+    std::vector<long long> settled(static_cast<size_t>(chunks));
+    std::atomic<long long> next_chunk(0);
+    auto worker = [&]() {
+        std::vector<int> rows;
+        for (;;) {
+            long long c = next_chunk.fetch_add(1, std::memory_order_relaxed);
+            if (c >= chunks) break;
+            long long begin = c * chunk;
+            long long end = std::min(begin + chunk, length);
+            if (c == 0) {
+                regenerateRange(model, seed, melody, begin, end, 0, out);
+                settled[0] = begin;
+                continue;
+            }
+            rows = entries;
+            CounterRng rng(seed, melody, static_cast<uint64_t>(begin));
+            long long i = begin;
+            for (; i < end; i++) {
+                uint64_t draw = rng.next();
+                bool same = true;
+                for (int& row : rows) {
+                    row = model.sample(row, draw);
+                    same = same && row == rows[0];
+                }
+                if (same) break;
+            }
+            settled[static_cast<size_t>(c)] = i;
+            if (i < end) {
+                out[i] = rows[0];
+                regenerateRange(model, seed, melody, i + 1, end, rows[0], out + i + 1);
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; t++) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& th : pool) {
+        th.join();
+    }
+
+    // Heads before each chunk's coalescence point, in order.
+    for (long long c = 1; c < chunks; c++) {
+        long long begin = c * chunk;
+        long long head_end = settled[static_cast<size_t>(c)];
+        regenerateRange(model, seed, melody, begin, head_end, out[begin - 1], out + begin);
+    }
+}
+
+#endif // MOOD_COUNTER_H
@@ -0,0 +1,520 @@
+// 📡 Generation Daemon
+//
+// A long-running server that answers generation requests over a Unix
+// domain socket, so services no longer pay process startup, the mood
+// prompt and fixed output files for every cue.
+//
+// Protocol (one request per line, any number per connection):
+//   request:  <mood> <length> <seed> <format>\n      format: smf | notes
+//   response: OK <size>\n<size payload bytes>   or   ERR <reason>\n
+// Responses on a connection come back in request order.  A line longer
+// than DAEMON_MAX_LINE gets "ERR request line too long" and the
+// connection is closed.
+//
+// One I/O thread polls the listening socket and every client.  Complete
+// request lines go onto a shared queue; each worker takes everything
+// queued (up to a batch limit) under a single lock, generates the whole
+// batch, and hands the responses back to the I/O thread through a wake
+// pipe.  The I/O thread sends them without blocking, so a client that
+// stops reading holds up nobody else.  A connection has at most one
+// request in flight, which keeps its responses ordered.
+
+#ifndef MOOD_DAEMON_H
+#define MOOD_DAEMON_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+struct DaemonRequest {
+    std::string mood;
+    int length = 16;
+    uint64_t seed = 1;
+    std::string format = "smf";
+};
+
+static constexpr int DAEMON_MAX_LENGTH = 1 << 20;
+static constexpr size_t DAEMON_MAX_LINE = 1024;  // request bytes, newline excluded
+
+inline bool parseDaemonRequest(const std::string& line, DaemonRequest& request,
+                               std::string& error) {
+    std::istringstream in(line);
+    long long length = 0;
+    unsigned long long seed = 0;
+    if (!(in >> request.mood >> length >> seed >> request.format)) {
+        error = "expected: <mood> <length> <seed> <smf|notes>";
+        return false;
+    }
+    if (length < 1 || length > DAEMON_MAX_LENGTH) {
+        error = "length out of range";
+        return false;
+    }
+    if (request.format != "smf" && request.format != "notes") {
+        error = "unknown format " + request.format;
+        return false;
+    }
+    request.length = static_cast<int>(length);
+    request.seed = seed;
+    return true;
+}
+
+// Ask the daemon owning wake pipe `fd` to stop.  Async-signal-safe.
+inline void wakeDaemon(int fd) {
+#ifdef _WIN32
+    (void)fd;
+#else
+    if (fd >= 0) {
+        char byte = 'q';
+        ssize_t written = ::write(fd, &byte, 1);
+        (void)written;
+    }
+#endif
+}
+
+struct DaemonStats {
+    std::atomic<long long> requests{0};
+    std::atomic<long long> errors{0};
+    std::atomic<long long> batches{0};
+    std::atomic<long long> connections{0};
+};
+
+// Serves requests with handler(request, payload, error), which fills
+// `payload` and returns true, or sets `error` and returns false.  The
+// handler runs on several workers at once and must be thread-safe.
+template <class Handler>
+class MoodDaemon {
+public:
+    MoodDaemon(Handler handler, int workers = 0, size_t max_batch = 32)
+        : m_handler(handler), m_workers(workers), m_max_batch(std::max<size_t>(1, max_batch)) {
+        if (m_workers <= 0) {
+            m_workers = static_cast<int>(std::thread::hardware_concurrency());
+            if (m_workers <= 0) m_workers = 1;
+        }
+    }
+
+    ~MoodDaemon() { close(); }
+
+    // Bind and listen on `path`, replacing a stale socket file.
+    bool listen(const std::string& path, std::string& error) {
+#ifdef _WIN32
+        (void)path;
+        error = "Unix domain sockets are not supported on this platform";
+        return false;
+#else
+        sockaddr_un address;
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+            error = "socket path is empty or too long";
+            return false;
+        }
+        std::strcpy(address.sun_path, path.c_str());
+        ::unlink(path.c_str());
+
+        m_listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (m_listen_fd < 0 ||
+            ::bind(m_listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            ::listen(m_listen_fd, 128) != 0 || ::pipe(m_wake) != 0) {
+            error = std::strerror(errno);
+            close();
+            return false;
+        }
+        ::fcntl(m_wake[0], F_SETFL, O_NONBLOCK);
+        m_path = path;
+        return true;
+#endif
+    }
+
+    // Write end of the wake pipe, for wakeDaemon() from a signal handler.
+    int wakeFd() const { return m_wake[1]; }
+
+    void stop() { wakeDaemon(m_wake[1]); }
+
+    // Serve until stop().  Starts and joins the worker pool.
+    void run() {
+#ifndef _WIN32
+        if (m_listen_fd < 0) return;
+        m_stopping = false;
+        std::vector<std::thread> pool;
+        for (int i = 0; i < m_workers; i++) {
+            pool.emplace_back([this]() { work(); });
+        }
+        serve();
+        {
+            std::lock_guard<std::mutex> lock(m_queue_mutex);
+            m_stopping = true;
+        }
+        m_queue_ready.notify_all();
+        for (auto& worker : pool) {
+            worker.join();
+        }
+        for (auto& entry : m_connections) {
+            ::close(entry.first);
+        }
+        m_connections.clear();
+#endif
+    }
+
+    const DaemonStats& stats() const { return m_stats; }
+    int workers() const { return m_workers; }
+
+private:
+    struct Connection {
+        uint64_t id = 0;         // unique per accept(); fds are reused
+        std::string input;
+        std::string output;      // response being sent
+        size_t sent = 0;         // bytes of output already sent
+        bool busy = false;       // a request is with a worker or being sent
+        bool responding = false; // output holds that request's response
+        bool closing = false;    // peer hung up; close once idle
+    };
+
+    // Jobs and responses name their connection by fd and id, so a
+    // response for a connection dropped meanwhile is discarded rather
+    // than sent to whoever accept() gave the fd to next.
+    struct Job {
+        int fd;
+        uint64_t id;
+        std::string line;
+    };
+
+    struct Response {
+        int fd;
+        uint64_t id;
+        std::string bytes;
+    };
+
+    void close() {
+#ifndef _WIN32
+        if (m_listen_fd >= 0) ::close(m_listen_fd);
+        if (m_wake[0] >= 0) ::close(m_wake[0]);
+        if (m_wake[1] >= 0) ::close(m_wake[1]);
+        if (!m_path.empty()) ::unlink(m_path.c_str());
+#endif
+        m_listen_fd = m_wake[0] = m_wake[1] = -1;
+        m_path.clear();
+    }
+
+#ifndef _WIN32
+    void serve() {
+        std::vector<pollfd> fds;
+        char buffer[4096];
+        for (;;) {
+            fds.clear();
+            fds.push_back({m_listen_fd, POLLIN, 0});
+            fds.push_back({m_wake[0], POLLIN, 0});
+            for (const auto& entry : m_connections) {
+                const Connection& connection = entry.second;
+                short events = 0;
+                // Input past the line limit is left unread until dispatch()
+                // has rejected it, so no connection buffers without bound.
+                if (!connection.closing && connection.input.size() <= DAEMON_MAX_LINE) events |= POLLIN;
+                if (connection.sent < connection.output.size()) events |= POLLOUT;
+                if (events) fds.push_back({entry.first, events, 0});
+            }
+            if (::poll(fds.data(), fds.size(), -1) < 0) {
+                if (errno == EINTR) continue;
+                return;
+            }
+
+            if (fds[1].revents & POLLIN) {
+                bool quit = false;
+                ssize_t n;
+                while ((n = ::read(m_wake[0], buffer, sizeof(buffer))) > 0) {
+                    quit = quit || std::memchr(buffer, 'q', static_cast<size_t>(n)) != nullptr;
+                }
+                if (quit) return;
+                finishJobs();
+            }
+            if (fds[0].revents & POLLIN) {
+                int fd = ::accept(m_listen_fd, nullptr, nullptr);
+                if (fd >= 0) {
+                    ::fcntl(fd, F_SETFL, O_NONBLOCK);
+                    m_connections[fd].id = ++m_next_id;
+                    m_stats.connections++;
+                }
+            }
+            for (size_t i = 2; i < fds.size(); i++) {
+                int fd = fds[i].fd;
+                auto it = m_connections.find(fd);
+                if (it == m_connections.end()) continue;
+                Connection& connection = it->second;
+                if ((fds[i].revents & (POLLOUT | POLLERR)) && !flush(fd)) continue;
+                if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+                ssize_t n = ::read(fd, buffer, sizeof(buffer));
+                if (n > 0) {
+                    connection.input.append(buffer, static_cast<size_t>(n));
+                } else if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+                    connection.closing = true;
+                }
+                dispatch(fd);
+            }
+        }
+    }
+
+    // Queue the connection's next complete line, or close it once idle.
+    void dispatch(int fd) {
+        Connection& connection = m_connections[fd];
+        if (connection.busy) return;
+        size_t end = connection.input.find('\n');
+        if ((end == std::string::npos ? connection.input.size() : end) > DAEMON_MAX_LINE) {
+            static const char reply[] = "ERR request line too long\n";
+            ssize_t written = ::send(fd, reply, sizeof(reply) - 1, SEND_FLAGS);
+            (void)written;
+            m_stats.errors++;
+            drop(fd);
+            return;
+        }
+        if (end == std::string::npos) {
+            if (connection.closing) drop(fd);
+            return;
+        }
+        Job job{fd, connection.id, connection.input.substr(0, end)};
+        connection.input.erase(0, end + 1);
+        connection.busy = true;
+        {
+            std::lock_guard<std::mutex> lock(m_queue_mutex);
+            m_queue.push_back(std::move(job));
+        }
+        m_queue_ready.notify_one();
+    }
+
+    // Take back responses from the workers and start sending them.
+    void finishJobs() {
+        std::vector<Response> done;
+        {
+            std::lock_guard<std::mutex> lock(m_done_mutex);
+            done.swap(m_done);
+        }
+        for (Response& response : done) {
+            auto it = m_connections.find(response.fd);
+            if (it == m_connections.end() || it->second.id != response.id) continue;
+            it->second.output = std::move(response.bytes);
+            it->second.sent = 0;
+            it->second.responding = true;
+            flush(response.fd);
+        }
+    }
+
+    // Send as much of the pending response as the socket takes without
+    // blocking; a peer that stops reading only holds up itself.  Once a
+    // response is out the connection's next request is dispatched (never
+    // while its request is still with a worker).  Returns false if the
+    // connection was dropped.
+    bool flush(int fd) {
+        Connection& connection = m_connections[fd];
+        while (connection.sent < connection.output.size()) {
+            ssize_t n = ::send(fd, connection.output.data() + connection.sent,
+                               connection.output.size() - connection.sent, SEND_FLAGS);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+            if (n <= 0) {
+                drop(fd);
+                return false;
+            }
+            connection.sent += static_cast<size_t>(n);
+        }
+        if (connection.responding) {
+            connection.output.clear();
+            connection.output.shrink_to_fit();
+            connection.sent = 0;
+            connection.responding = false;
+            connection.busy = false;
+            dispatch(fd);
+        }
+        return m_connections.count(fd) != 0;
+    }
+
+    void drop(int fd) {
+        ::close(fd);
+        m_connections.erase(fd);
+    }
+
+    void work() {
+        std::vector<Job> batch;
+        std::vector<uint8_t> payload;
+        std::vector<Response> responses;
+        for (;;) {
+            batch.clear();
+            {
+                std::unique_lock<std::mutex> lock(m_queue_mutex);
+                m_queue_ready.wait(lock, [this]() { return m_stopping || !m_queue.empty(); });
+                if (m_stopping) return;
+                while (!m_queue.empty() && batch.size() < m_max_batch) {
+                    batch.push_back(std::move(m_queue.front()));
+                    m_queue.pop_front();
+                }
+            }
+            m_stats.batches++;
+
+            responses.clear();
+            for (const Job& job : batch) {
+                DaemonRequest request;
+                std::string error;
+                payload.clear();
+                Response response{job.fd, job.id, std::string()};
+                if (parseDaemonRequest(job.line, request, error) && m_handler(request, payload, error)) {
+                    response.bytes = "OK " + std::to_string(payload.size()) + "\n";
+                    response.bytes.append(payload.begin(), payload.end());
+                } else {
+                    response.bytes = "ERR " + error + "\n";
+                    m_stats.errors++;
+                }
+                m_stats.requests++;
+                responses.push_back(std::move(response));
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_done_mutex);
+                for (Response& response : responses) m_done.push_back(std::move(response));
+            }
+            char byte = 'd';
+            ssize_t written = ::write(m_wake[1], &byte, 1);
+            (void)written;
+        }
+    }
+
+#ifdef MSG_NOSIGNAL
+    static constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+    static constexpr int SEND_FLAGS = 0;
+#endif
+#endif
+
+    Handler m_handler;
+    int m_workers;
+    size_t m_max_batch;
+    std::string m_path;
+    int m_listen_fd = -1;
+    int m_wake[2] = {-1, -1};
+    std::map<int, Connection> m_connections;  // I/O thread only
+    uint64_t m_next_id = 0;                   // I/O thread only
+
+    std::mutex m_queue_mutex;
+    std::condition_variable m_queue_ready;
+    std::deque<Job> m_queue;
+    bool m_stopping = false;
+
+    std::mutex m_done_mutex;
+    std::vector<Response> m_done;
+
+    DaemonStats m_stats;
+};
+
+// 🔌 Minimal blocking client, one connection, requests in sequence.
+class DaemonClient {
+public:
+    ~DaemonClient() { disconnect(); }
+
+    bool connect(const std::string& path) {
+#ifdef _WIN32
+        (void)path;
+        return false;
+#else
+        sockaddr_un address;
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) return false;
+        std::strcpy(address.sun_path, path.c_str());
+        m_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (m_fd < 0) return false;
+        if (::connect(m_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            disconnect();
+            return false;
+        }
+        return true;
+#endif
+    }
+
+    void disconnect() {
+#ifndef _WIN32
+        if (m_fd >= 0) ::close(m_fd);
+#endif
+        m_fd = -1;
+    }
+
+    // Send one request line; on OK fill `payload`, on ERR fill `error`.
+    bool request(const std::string& line, std::vector<uint8_t>& payload, std::string& error) {
+#ifdef _WIN32
+        (void)line;
+        (void)payload;
+        error = "not supported on this platform";
+        return false;
+#else
+        std::string message = line + "\n";
+        const char* bytes = message.data();
+        size_t left = message.size();
+        while (left > 0) {
+            ssize_t n = ::write(m_fd, bytes, left);
+            if (n <= 0) {
+                error = "connection lost";
+                return false;
+            }
+            bytes += n;
+            left -= static_cast<size_t>(n);
+        }
+
+        std::string header;
+        char c;
+        while (readSome(&c, 1) && c != '\n') header += c;
+        if (header.compare(0, 3, "OK ") == 0) {
+            size_t size = static_cast<size_t>(std::strtoull(header.c_str() + 3, nullptr, 10));
+            payload.resize(size);
+            if (size > 0 && !readSome(reinterpret_cast<char*>(payload.data()), size)) {
+                error = "connection lost";
+                return false;
+            }
+            return true;
+        }
+        error = header.compare(0, 4, "ERR ") == 0 ? header.substr(4) : "connection lost";
+        return false;
+#endif
+    }
+
+private:
+#ifndef _WIN32
+    // Read exactly `size` bytes, buffering ahead to keep syscalls few.
+    bool readSome(char* out, size_t size) {
+        while (size > 0) {
+            if (m_begin == m_end) {
+                ssize_t n = ::read(m_fd, m_buffer, sizeof(m_buffer));
+                if (n <= 0) return false;
+                m_begin = 0;
+                m_end = static_cast<size_t>(n);
+            }
+            size_t take = std::min(size, m_end - m_begin);
+            std::memcpy(out, m_buffer + m_begin, take);
+            m_begin += take;
+            out += take;
+            size -= take;
+        }
+        return true;
+    }
+
+    char m_buffer[4096];
+    size_t m_begin = 0;
+    size_t m_end = 0;
+#endif
+    int m_fd = -1;
+};
+
+#endif // MOOD_DAEMON_H
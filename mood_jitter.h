@@ -0,0 +1,150 @@
+// 📈 Playback Jitter Measurement
+//
+// Headless stand-ins for a MIDI port so playback timing can be measured
+// without hardware.  A JitterRecorder timestamps every message when it
+// is sent and again when it arrives at the receiving end, either through
+// RecordingSink (an in-process loopback with its own receiver thread) or
+// through a real virtual port looped back into RtMidiIn.
+
+#ifndef MOOD_JITTER_H
+#define MOOD_JITTER_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "mood_scheduler.h"
+
+struct JitterRecorder {
+    using Clock = std::chrono::steady_clock;
+
+    std::mutex mutex;
+    std::condition_variable arrived;
+    std::vector<Clock::time_point> sent;
+    std::vector<Clock::time_point> received;
+
+    void markSent() {
+        auto now = Clock::now();
+        std::lock_guard<std::mutex> lock(mutex);
+        sent.push_back(now);
+    }
+
+    void markReceived() {
+        auto now = Clock::now();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            received.push_back(now);
+        }
+        arrived.notify_all();
+    }
+
+    // Wait until every sent message has arrived; false on timeout.
+    bool waitForAll(std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(mutex);
+        return arrived.wait_for(lock, timeout, [this]() { return received.size() >= sent.size(); });
+    }
+};
+
+// 🔁 In-process loopback: send() hands the message to a receiver thread,
+// which timestamps it on arrival like a port callback would.
+class RecordingSink {
+public:
+    explicit RecordingSink(JitterRecorder& recorder)
+        : m_recorder(recorder), m_receiver([this]() { receive(); }) {}
+
+    ~RecordingSink() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_ready.notify_one();
+        m_receiver.join();
+    }
+
+    void send(const unsigned char* bytes, size_t size) {
+        Message message;
+        message.size = std::min<size_t>(size, 3);
+        std::copy(bytes, bytes + message.size, message.bytes);
+        m_recorder.markSent();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_queue.push_back(message);
+        }
+        m_ready.notify_one();
+    }
+
+private:
+    struct Message {
+        unsigned char bytes[3];
+        size_t size;
+    };
+
+    void receive() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;) {
+            m_ready.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+            while (!m_queue.empty()) {
+                m_queue.pop_front();
+                lock.unlock();
+                m_recorder.markReceived();
+                lock.lock();
+            }
+            if (m_stop) return;
+        }
+    }
+
+    JitterRecorder& m_recorder;
+    std::mutex m_mutex;
+    std::condition_variable m_ready;
+    std::deque<Message> m_queue;
+    bool m_stop = false;
+    std::thread m_receiver;
+};
+
+struct JitterReport {
+    long long events = 0;
+    double p50_us = 0.0;
+    double p99_us = 0.0;
+    double max_us = 0.0;
+    double drift_us = 0.0;          // arrival of the last event vs its deadline
+    double transport_p50_us = 0.0;  // send -> receive
+};
+
+// Jitter of event i = its send lateness (from the scheduler trace) plus
+// the time from send to arrival (from the recorder).
+inline JitterReport makeJitterReport(const std::vector<DispatchRecord>& trace,
+                                     const JitterRecorder& recorder) {
+    JitterReport report;
+    size_t n = std::min({trace.size(), recorder.sent.size(), recorder.received.size()});
+    if (n == 0) return report;
+
+    std::vector<double> jitter(n), transport(n);
+    for (size_t i = 0; i < n; i++) {
+        transport[i] = std::chrono::duration<double, std::micro>(
+            recorder.received[i] - recorder.sent[i]).count();
+        jitter[i] = std::max(0.0, trace[i].sent_us - trace[i].deadline_us) + transport[i];
+    }
+    report.events = static_cast<long long>(n);
+    report.drift_us = jitter[n - 1];
+    std::sort(jitter.begin(), jitter.end());
+    std::sort(transport.begin(), transport.end());
+    report.p50_us = jitter[(n - 1) / 2];
+    report.p99_us = jitter[static_cast<size_t>((n - 1) * 0.99)];
+    report.max_us = jitter[n - 1];
+    report.transport_p50_us = transport[(n - 1) / 2];
+    return report;
+}
+
+inline void printJitterReport(const char* sink, const JitterReport& report) {
+    std::printf("%s: %lld events, jitter p50 %.1f us, p99 %.1f us, max %.1f us, "
+                "transport p50 %.1f us, total drift %.1f us\n",
+                sink, report.events, report.p50_us, report.p99_us, report.max_us,
+                report.transport_p50_us, report.drift_us);
+}
+
+#endif // MOOD_JITTER_H
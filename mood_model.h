@@ -0,0 +1,162 @@
+// 🧮 Compiled Mood Model
+//
+// Flattens a mood's scale and Markov table into a dense 128-row table
+// indexed by MIDI key.  Successors of every row sit contiguously in one
+// cell array (CSR layout) and are sampled with Walker's alias method, so
+// each note costs a row load, a cell load and one 64-bit RNG draw.
+// Keys without transitions fall back to the scale, exactly as
+// generateMelody() does; the scale itself is the extra START_ROW.
+
+#ifndef MOOD_MODEL_H
+#define MOOD_MODEL_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// One alias-table column: keep `note` when the low RNG word is below
+// `threshold`, otherwise take `alias`.
+struct AliasCell {
+    uint32_t threshold;
+    uint8_t note;
+    uint8_t alias;
+    uint16_t reserved;
+};
+
+// Append an alias row for `notes` (uniform when `weights` is null),
+// using Vose's construction on probabilities scaled by `count`.
+inline void appendAliasRow(std::vector<AliasCell>& cells, const int* notes,
+                           const double* weights, int count) {
+    double total = 0.0;
+    for (int i = 0; i < count; i++) {
+        total += weights ? weights[i] : 1.0;
+    }
+
+    std::vector<double> scaled(count);
+    std::vector<int> small, large;
+    for (int i = 0; i < count; i++) {
+        scaled[i] = (weights ? weights[i] : 1.0) * count / total;
+        (scaled[i] < 1.0 ? small : large).push_back(i);
+    }
+    std::vector<AliasCell> column(count);
+    for (int i = 0; i < count; i++) {
+        column[i].note = static_cast<uint8_t>(notes[i] & 0x7F);
+        column[i].alias = column[i].note;
+        column[i].threshold = 0xFFFFFFFFu;
+        column[i].reserved = 0;
+    }
+    while (!small.empty() && !large.empty()) {
+        int s = small.back();
+        small.pop_back();
+        int l = large.back();
+        column[s].threshold = static_cast<uint32_t>(scaled[s] * 4294967296.0);
+        column[s].alias = column[l].note;
+        scaled[l] -= 1.0 - scaled[s];
+        if (scaled[l] < 1.0) {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+    cells.insert(cells.end(), column.begin(), column.end());
+}
+
+// Draw from an alias row.  With uniform weights every cell aliases
+// itself, so the pick matches MelodyRng::below() on the same draw.
+inline int sampleAliasRow(const AliasCell* row, uint32_t count, uint64_t draw) {
+    uint32_t hi = static_cast<uint32_t>(draw >> 32);
+    uint32_t lo = static_cast<uint32_t>(draw);
+    const AliasCell& c = row[(static_cast<uint64_t>(hi) * count) >> 32];
+    return lo < c.threshold ? c.note : c.alias;
+}
+
+struct MoodRow {
+    uint32_t offset;  // first cell of the row
+    uint32_t count;   // number of cells (never zero)
+};
+
+// Read-only view of a compiled mood.  It points either into a
+// CompiledMood or straight into a memory-mapped model file.
+struct CompiledMoodView {
+    static constexpr int KEYS = 128;
+    static constexpr int START_ROW = KEYS;
+
+    const MoodRow* rows = nullptr;  // KEYS + 1 rows
+    const AliasCell* cells = nullptr;
+    uint32_t cell_count = 0;
+
+    int sample(int row, uint64_t draw) const {
+        return sampleAliasRow(cells + rows[row].offset, rows[row].count, draw);
+    }
+
+    template <class Rng>
+    void generate(int* out, int length, Rng& rng) const {
+        int note = sample(START_ROW, rng.next());
+        for (int i = 0; i < length; i++) {
+            out[i] = note;
+            note = sample(note, rng.next());
+        }
+    }
+};
+
+struct CompiledMood {
+    static constexpr int KEYS = CompiledMoodView::KEYS;
+    static constexpr int START_ROW = CompiledMoodView::START_ROW;
+    using Row = MoodRow;
+
+    Row rows[KEYS + 1];
+    std::vector<AliasCell> cells;
+
+    // Append the weighted row for `row` (a MIDI key or START_ROW).
+    void setRow(int row, const int* notes, const double* weights, int count) {
+        rows[row].offset = static_cast<uint32_t>(cells.size());
+        rows[row].count = static_cast<uint32_t>(count);
+        appendAliasRow(cells, notes, weights, count);
+    }
+
+    CompiledMoodView view() const {
+        CompiledMoodView v;
+        v.rows = rows;
+        v.cells = cells.data();
+        v.cell_count = static_cast<uint32_t>(cells.size());
+        return v;
+    }
+
+    int sample(int row, uint64_t draw) const {
+        return view().sample(row, draw);
+    }
+
+    template <class Rng>
+    void generate(int* out, int length, Rng& rng) const {
+        view().generate(out, length, rng);
+    }
+};
+
+// Compile a mood from the uniform tables used by generateMelody().
+// Keys without transitions share the START_ROW cells.
+inline CompiledMood compileMood(const std::vector<int>& scale,
+                                const std::map<int, std::vector<int>>& transitions) {
+    CompiledMood model;
+    model.setRow(CompiledMood::START_ROW, scale.data(), nullptr, static_cast<int>(scale.size()));
+    for (int key = 0; key < CompiledMood::KEYS; key++) {
+        auto it = transitions.find(key);
+        if (it != transitions.end() && !it->second.empty()) {
+            model.setRow(key, it->second.data(), nullptr, static_cast<int>(it->second.size()));
+        } else {
+            model.rows[key] = model.rows[CompiledMood::START_ROW];
+        }
+    }
+    return model;
+}
+
+inline std::map<std::string, CompiledMood> compileMoods(
+        const std::map<std::string, std::vector<int>>& scales,
+        const std::map<int, std::vector<int>>& transitions) {
+    std::map<std::string, CompiledMood> models;
+    for (const auto& entry : scales) {
+        models[entry.first] = compileMood(entry.second, transitions);
+    }
+    return models;
+}
+
+#endif // MOOD_MODEL_H
@@ -0,0 +1,361 @@
+// 💽 Binary Mood Model Files
+//
+// A versioned, little-endian file holding every mood's tempo, instrument,
+// scale, compiled Markov table and optional trained n-gram model.  The
+// file is mapped read-only and the generator views point straight into
+// the mapping, so opening a multi-hundred-MB model costs a few page
+// faults instead of a parse, and every process using the same file
+// shares one page-cache copy.
+//
+// Layout (all offsets from the start of the file, sections 8-byte aligned):
+//   ModelFileHeader
+//   int32_t        rhythm[rhythm_count]       (ticks, 480 per quarter)
+//   ModelFileMood  moods[mood_count]
+//   per mood:      MoodRow rows[129], AliasCell cells[cell_count],
+//                  NgramSlot slots[slot_count], AliasCell ngram_cells[...]
+
+#ifndef MOOD_MODELFILE_H
+#define MOOD_MODELFILE_H
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "mood_model.h"
+#include "mood_ngram.h"
+
+static const char MOOD_MODEL_MAGIC[8] = {'M', 'O', 'O', 'D', 'M', 'D', 'L', '\0'};
+// The rhythm is stored in ticks (480 per quarter).
+static const uint32_t MOOD_MODEL_VERSION = 2;
+
+struct ModelFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;     // sizeof(ModelFileHeader), for sanity checks
+    uint64_t file_size;
+    uint32_t mood_count;
+    uint32_t rhythm_count;
+    uint64_t rhythm_offset;
+    uint64_t moods_offset;
+};
+
+struct ModelFileMood {
+    char name[32];
+    int32_t tempo;
+    int32_t instrument;
+    uint32_t scale_count;
+    int32_t scale[25];
+    uint64_t rows_offset;
+    uint64_t cells_offset;
+    uint64_t cell_count;
+    int32_t ngram_order;
+    uint32_t reserved;
+    uint64_t slots_offset;      // 0 when the mood has no n-gram model
+    uint64_t slot_count;
+    uint64_t ngram_cells_offset;
+    uint64_t ngram_cell_count;
+};
+
+// One mood as written to or read from a model file.
+struct MoodModelEntry {
+    std::string name;
+    int tempo = 120;
+    int instrument = 0;
+    std::vector<int> scale;
+    CompiledMoodView compiled;
+    NgramView ngram;            // ngram.slots == nullptr: none
+};
+
+// 🗺️ Read-only file mapping (POSIX mmap or Win32 file mapping).
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const std::string& filename) {
+        close();
+#ifdef _WIN32
+        m_file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                             OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (m_file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0) {
+            close();
+            return false;
+        }
+        m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!m_mapping) {
+            close();
+            return false;
+        }
+        m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+        m_size = static_cast<size_t>(size.QuadPart);
+#else
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED) return false;
+        m_data = static_cast<const uint8_t*>(data);
+        m_size = static_cast<size_t>(info.st_size);
+#endif
+        if (!m_data) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (m_data) UnmapViewOfFile(m_data);
+        if (m_mapping) CloseHandle(m_mapping);
+        if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+        m_mapping = nullptr;
+        m_file = INVALID_HANDLE_VALUE;
+#else
+        if (m_data) munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+    const uint8_t* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = nullptr;
+#endif
+};
+
+// 📖 A mapped model file.  Entries stay valid while the file is open.
+class MoodModelFile {
+public:
+    // Map `filename` and check its header, section bounds, every row and
+    // n-gram slot, tempos and instruments.  Returns false with a reason in
+    // `error` for missing, foreign, truncated or out-of-range files.
+    bool open(const std::string& filename, std::string& error) {
+        m_moods.clear();
+        m_rhythm.clear();
+        if (!m_map.open(filename)) {
+            error = "cannot map " + filename;
+            return false;
+        }
+        const uint8_t* base = m_map.data();
+        uint64_t size = m_map.size();
+        if (size < sizeof(ModelFileHeader)) {
+            return fail("file too small for a model header", error);
+        }
+        const ModelFileHeader* header = reinterpret_cast<const ModelFileHeader*>(base);
+        if (std::memcmp(header->magic, MOOD_MODEL_MAGIC, sizeof(MOOD_MODEL_MAGIC)) != 0) {
+            return fail("not a mood model file", error);
+        }
+        if (header->version != MOOD_MODEL_VERSION ||
+            header->header_size != sizeof(ModelFileHeader)) {
+            return fail("unsupported model file version " + std::to_string(header->version), error);
+        }
+        if (header->file_size != size) {
+            return fail("model file is truncated", error);
+        }
+        if (!inside(header->rhythm_offset, header->rhythm_count, sizeof(int32_t)) ||
+            !inside(header->moods_offset, header->mood_count, sizeof(ModelFileMood))) {
+            return fail("model file sections out of range", error);
+        }
+
+        const int32_t* rhythm = reinterpret_cast<const int32_t*>(base + header->rhythm_offset);
+        m_rhythm.assign(rhythm, rhythm + header->rhythm_count);
+
+        const ModelFileMood* moods = reinterpret_cast<const ModelFileMood*>(base + header->moods_offset);
+        for (uint32_t m = 0; m < header->mood_count; m++) {
+            const ModelFileMood& mood = moods[m];
+            if (mood.scale_count == 0 || mood.scale_count > 25 ||
+                !inside(mood.rows_offset, CompiledMood::KEYS + 1, sizeof(MoodRow)) ||
+                !inside(mood.cells_offset, mood.cell_count, sizeof(AliasCell))) {
+                return fail("mood " + std::to_string(m) + " is out of range", error);
+            }
+            const MoodRow* rows = reinterpret_cast<const MoodRow*>(base + mood.rows_offset);
+            const AliasCell* cells = reinterpret_cast<const AliasCell*>(base + mood.cells_offset);
+            if (mood.tempo <= 0 || mood.instrument < 0 || mood.instrument > 127 ||
+                !cellsValid(cells, mood.cell_count)) {
+                return fail("mood " + std::to_string(m) + " is out of range", error);
+            }
+            for (int row = 0; row <= CompiledMood::KEYS; row++) {
+                if (!rowValid(rows[row].offset, rows[row].count, mood.cell_count)) {
+                    return fail("mood " + std::to_string(m) + " has a row out of range", error);
+                }
+            }
+            MoodModelEntry entry;
+            entry.name.assign(mood.name, strnlen(mood.name, sizeof(mood.name)));
+            entry.tempo = mood.tempo;
+            entry.instrument = mood.instrument;
+            entry.scale.assign(mood.scale, mood.scale + mood.scale_count);
+            entry.compiled.rows = rows;
+            entry.compiled.cells = cells;
+            entry.compiled.cell_count = static_cast<uint32_t>(mood.cell_count);
+            if (mood.slots_offset != 0) {
+                uint64_t slots = mood.slot_count;
+                if (slots == 0 || (slots & (slots - 1)) != 0 ||
+                    !inside(mood.slots_offset, slots, sizeof(NgramSlot)) ||
+                    !inside(mood.ngram_cells_offset, mood.ngram_cell_count, sizeof(AliasCell))) {
+                    return fail("n-gram model of mood " + entry.name + " is out of range", error);
+                }
+                const NgramSlot* table = reinterpret_cast<const NgramSlot*>(base + mood.slots_offset);
+                const AliasCell* ngram_cells =
+                    reinterpret_cast<const AliasCell*>(base + mood.ngram_cells_offset);
+                if (mood.ngram_order < 0 || mood.ngram_order > NgramCounts::MAX_ORDER ||
+                    !cellsValid(ngram_cells, mood.ngram_cell_count)) {
+                    return fail("n-gram model of mood " + entry.name + " is out of range", error);
+                }
+                // Lookups stop at an empty slot, so a full table would never end.
+                bool has_empty = false;
+                for (uint64_t i = 0; i < slots; i++) {
+                    if (table[i].key == NgramSlot::EMPTY) {
+                        has_empty = true;
+                    } else if (!rowValid(table[i].offset, table[i].count, mood.ngram_cell_count)) {
+                        return fail("n-gram model of mood " + entry.name + " has a slot out of range",
+                                    error);
+                    }
+                }
+                if (!has_empty) {
+                    return fail("n-gram model of mood " + entry.name + " has no empty slot", error);
+                }
+                entry.ngram.order = mood.ngram_order;
+                entry.ngram.mask = slots - 1;
+                entry.ngram.slots = table;
+                entry.ngram.cells = ngram_cells;
+                entry.ngram.cell_count = mood.ngram_cell_count;
+            }
+            m_moods.push_back(entry);
+        }
+        return true;
+    }
+
+    const std::vector<MoodModelEntry>& moods() const { return m_moods; }
+    const std::vector<int>& rhythm() const { return m_rhythm; }
+    size_t size() const { return m_map.size(); }
+
+private:
+    bool inside(uint64_t offset, uint64_t count, uint64_t item) const {
+        return offset % 8 == 0 && offset <= m_map.size() &&
+               count <= (m_map.size() - offset) / item;
+    }
+
+    // A row of alias cells: at least one, all inside the cell section.
+    static bool rowValid(uint32_t offset, uint32_t count, uint64_t cell_count) {
+        return count > 0 && static_cast<uint64_t>(offset) + count <= cell_count;
+    }
+
+    // Every note a cell can return must be a MIDI key, since it selects
+    // the next row.
+    static bool cellsValid(const AliasCell* cells, uint64_t count) {
+        for (uint64_t i = 0; i < count; i++) {
+            if (cells[i].note > 127 || cells[i].alias > 127) return false;
+        }
+        return true;
+    }
+
+    bool fail(const std::string& reason, std::string& error) {
+        error = reason;
+        m_moods.clear();
+        m_map.close();
+        return false;
+    }
+
+    MappedFile m_map;
+    std::vector<MoodModelEntry> m_moods;
+    std::vector<int> m_rhythm;
+};
+
+// ✍️ Write `moods` and the shared rhythm pattern as a model file.
+inline bool writeMoodModelFile(const std::string& filename, const std::vector<int>& rhythm,
+                               const std::vector<MoodModelEntry>& moods) {
+    std::vector<uint8_t> bytes;
+    auto align = [&bytes]() { bytes.resize((bytes.size() + 7) & ~size_t(7), 0); };
+    auto append = [&bytes, &align](const void* data, size_t size) {
+        align();
+        uint64_t offset = bytes.size();
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        bytes.insert(bytes.end(), p, p + size);
+        return offset;
+    };
+
+    ModelFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MOOD_MODEL_MAGIC, sizeof(MOOD_MODEL_MAGIC));
+    header.version = MOOD_MODEL_VERSION;
+    header.header_size = sizeof(ModelFileHeader);
+    header.mood_count = static_cast<uint32_t>(moods.size());
+    header.rhythm_count = static_cast<uint32_t>(rhythm.size());
+    append(&header, sizeof(header));
+
+    std::vector<int32_t> rhythm32(rhythm.begin(), rhythm.end());
+    header.rhythm_offset = append(rhythm32.data(), rhythm32.size() * sizeof(int32_t));
+
+    std::vector<ModelFileMood> table(moods.size());
+    header.moods_offset = append(table.data(), table.size() * sizeof(ModelFileMood));
+
+    for (size_t m = 0; m < moods.size(); m++) {
+        const MoodModelEntry& entry = moods[m];
+        ModelFileMood& mood = table[m];
+        std::memset(&mood, 0, sizeof(mood));
+        if (entry.name.size() >= sizeof(mood.name) || entry.scale.empty() || entry.scale.size() > 25) {
+            return false;
+        }
+        std::memcpy(mood.name, entry.name.data(), entry.name.size());
+        mood.tempo = entry.tempo;
+        mood.instrument = entry.instrument;
+        mood.scale_count = static_cast<uint32_t>(entry.scale.size());
+        for (size_t i = 0; i < entry.scale.size(); i++) {
+            mood.scale[i] = entry.scale[i];
+        }
+        mood.rows_offset = append(entry.compiled.rows, (CompiledMood::KEYS + 1) * sizeof(MoodRow));
+        mood.cell_count = entry.compiled.cell_count;
+        mood.cells_offset = append(entry.compiled.cells, mood.cell_count * sizeof(AliasCell));
+        if (entry.ngram.slots) {
+            mood.ngram_order = entry.ngram.order;
+            mood.slot_count = entry.ngram.slotCount();
+            mood.slots_offset = append(entry.ngram.slots, mood.slot_count * sizeof(NgramSlot));
+            mood.ngram_cell_count = entry.ngram.cell_count;
+            mood.ngram_cells_offset = append(entry.ngram.cells,
+                                             mood.ngram_cell_count * sizeof(AliasCell));
+        }
+    }
+    align();
+    header.file_size = bytes.size();
+    std::memcpy(bytes.data(), &header, sizeof(header));
+    if (!table.empty()) {
+        std::memcpy(bytes.data() + header.moods_offset, table.data(),
+                    table.size() * sizeof(ModelFileMood));
+    }
+
+    std::ofstream out(filename, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    return static_cast<bool>(out);
+}
+
+#endif // MOOD_MODELFILE_H
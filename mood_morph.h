@@ -0,0 +1,179 @@
+// 🌗 Mood Morphing
+//
+// Moves a running stream from one mood to another over a number of bars
+// without rebuilding any table or stopping playback.  The blend weight t
+// steps once per bar from 0 to 1; each note first picks the source or
+// target table (the target with probability t) and then samples that
+// table's row, which is exactly a draw from the interpolated distribution
+// (1 - t) * P_from + t * P_to, scale fallbacks included.  Bars come from
+// the rhythm's meter; the tempo is interpolated per bar and sent as a
+// tempo change on the bar's first note.  The two instruments sit
+// on their own channels and are crossfaded by splitting each note's
+// velocity between them; program changes ride along with the notes.
+// Another thread (a UI, a control socket) hands over a new target with
+// requestMorph(); the playing thread picks it up at the next bar line.
+
+#ifndef MOOD_MORPH_H
+#define MOOD_MORPH_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "mood_batch.h"
+#include "mood_model.h"
+#include "mood_rhythm.h"
+#include "mood_stream.h"
+
+struct MorphEndpoint {
+    CompiledMoodView model;
+    int tempo = 120;
+    int instrument = 0;
+};
+
+class MorphStream {
+public:
+    // Play `from` until morphTo().  `length` < 0 never ends.
+    MorphStream(const MorphEndpoint& from, const RhythmPattern& rhythm, uint64_t seed,
+                long long length = -1)
+        : m_clock(rhythm), m_rng(seed), m_length(length), m_tempo(from.tempo) {
+        m_side[0] = m_side[1] = from;
+    }
+
+    // Morph to `to` over `bars` bars (0: at the next bar line).  A morph
+    // started mid-way continues from whichever mood currently dominates.
+    // Call from the thread calling next(), between next() calls.
+    void morphTo(const MorphEndpoint& to, int bars) {
+        if (m_blend >= 0.5) {
+            m_from = 1 - m_from;
+        }
+        m_side[1 - m_from] = to;
+        m_program_sent[1 - m_from] = false;
+        m_bars = std::max(0, bars);
+        m_bar = 0;
+        m_blend = 0.0;
+        m_morphing = true;
+        m_tempo = m_side[m_from].tempo;
+        m_tempo_changed = true;
+    }
+
+    // Thread-safe morphTo(): the morph starts at the first note on or
+    // after the next bar line.  A later request replaces one not yet
+    // picked up.
+    void requestMorph(const MorphEndpoint& to, int bars) {
+        std::lock_guard<std::mutex> lock(m_request_mutex);
+        m_request = to;
+        m_request_bars = bars;
+        m_request_ready.store(true, std::memory_order_release);
+    }
+
+    bool next(NoteEvent& event) {
+        if (m_pending) {
+            // Second layer of a crossfaded note.
+            event = m_layer;
+            m_pending = false;
+            return true;
+        }
+        if (m_length >= 0 && m_index >= m_length) {
+            return false;
+        }
+
+        long long tick = m_clock.tick();
+        bool bar_start = m_index == 0 || tick / m_clock.pattern().meter().barTicks() > m_bar_line;
+        advanceBars(tick);
+        if (bar_start && m_request_ready.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> lock(m_request_mutex);
+            m_request_ready.store(false, std::memory_order_relaxed);
+            morphTo(m_request, m_request_bars);
+        }
+
+        // Pick a side with probability t, then sample that side's row.
+        int to = 1 - m_from;
+        double u = static_cast<double>(m_rng.next() >> 11) * (1.0 / 9007199254740992.0);
+        const CompiledMoodView& model = u < m_blend ? m_side[to].model : m_side[m_from].model;
+        int row = m_index == 0 ? CompiledMoodView::START_ROW : m_key;
+        m_key = model.sample(row, m_rng.next());
+
+        NoteTiming timing = m_clock.next();
+        int to_velocity = static_cast<int>(100 * m_blend + 0.5);
+        int from_velocity = 100 - to_velocity;
+
+        event.index = m_index;
+        event.key = m_key;
+        event.tick = timing.on;
+        event.duration = static_cast<int>(timing.off - timing.on);
+        event.tempo = m_tempo_changed ? m_tempo : 0.0;
+        m_tempo_changed = false;
+        if (from_velocity > 0 && to_velocity > 0) {
+            // The second layer starts together with the first.
+            m_layer = event;
+            m_layer.tempo = 0.0;
+            layer(m_layer, to, to_velocity);
+            m_pending = true;
+        }
+        if (from_velocity > 0) {
+            layer(event, m_from, from_velocity);
+        } else {
+            layer(event, to, to_velocity);
+        }
+
+        m_index++;
+        return true;
+    }
+
+    long long position() const { return m_index; }
+    double blend() const { return m_blend; }
+    double tempo() const { return m_tempo; }
+
+private:
+    // Route `event` to side `side`'s channel, with its program change on
+    // the first note that channel plays for that side.
+    void layer(NoteEvent& event, int side, int velocity) {
+        event.channel = side;
+        event.velocity = velocity;
+        event.program = -1;
+        if (!m_program_sent[side]) {
+            event.program = m_side[side].instrument;
+            m_program_sent[side] = true;
+        }
+    }
+
+    // t and the tempo step once per bar line crossed before `tick`.
+    void advanceBars(long long tick) {
+        long long bar = tick / m_clock.pattern().meter().barTicks();
+        for (; m_bar_line < bar; m_bar_line++) {
+            if (!m_morphing) continue;
+            m_bar++;
+            m_blend = m_bars == 0 ? 1.0 : std::min(1.0, static_cast<double>(m_bar) / m_bars);
+            m_tempo = m_side[m_from].tempo + (m_side[1 - m_from].tempo - m_side[m_from].tempo) * m_blend;
+            m_tempo_changed = true;
+            m_morphing = m_blend < 1.0;
+        }
+    }
+
+    MorphEndpoint m_side[2];  // channel c plays m_side[c]
+    int m_from = 0;           // side being left; the other is the target
+    bool m_program_sent[2] = {false, false};
+    RhythmClock m_clock;
+    MelodyRng m_rng;
+    long long m_length;
+    long long m_index = 0;
+    int m_key = 60;
+    double m_tempo;
+    bool m_tempo_changed = true;  // the first note carries the starting tempo
+    double m_blend = 0.0;     // t: weight of the target
+    bool m_morphing = false;
+    int m_bars = 0;
+    int m_bar = 0;
+    long long m_bar_line = 0; // bar lines passed so far
+    bool m_pending = false;
+    NoteEvent m_layer;
+    std::mutex m_request_mutex;   // guards m_request and m_request_bars
+    std::atomic<bool> m_request_ready{false};
+    MorphEndpoint m_request;
+    int m_request_bars = 0;
+};
+
+#endif // MOOD_MORPH_H
@@ -1,50 +1,77 @@
 #include <iostream>
 #include <vector>
+#include <atomic>
 #include <map>
 #include <cstdlib>
 #include <ctime>
 #include <thread>
 #include <chrono>
 #include <fstream>
+#include <csignal>
+#include <filesystem>
 #include "rtmidi/RtMidi.h"
 #include "midifile/include/MidiFile.h"
+#include "midifile/include/Options.h"
+#include "mood_arrange.h"
+#include "mood_batch.h"
+#include "mood_beam.h"
+#include "mood_cache.h"
+#include "mood_corpus.h"
+#include "mood_counter.h"
+#include "mood_daemon.h"
+#include "mood_jitter.h"
+#include "mood_bench.h"
+#include "mood_model.h"
+#include "mood_modelfile.h"
+#include "mood_morph.h"
+#include "mood_ngram.h"
+#include "mood_notefile.h"
+#include "mood_profiles.h"
+#include "mood_rhythm.h"
+#include "mood_scheduler.h"
+#include "mood_simd.h"
+#include "mood_smfwriter.h"
+#include "mood_stream.h"
+#include "mood_synth.h"
 
 using namespace std;
 using namespace smf; // for midifile
 
 // 🎵 Markov Chain for Melody Generation
-map<int, vector<int>> mood_transitions = {
-    {60, {62, 64, 67}}, {62, {64, 60, 65}}, {64, {65, 67, 60}},
-    {65, {67, 69, 60}}, {67, {69, 71, 60}}, {69, {71, 72, 60}},
-    {71, {72, 74, 60}}
-};
+map<int, vector<int>> mood_transitions = builtinTransitionTable();
 
 // 🎼 Scales for Different Moods
-map<string, vector<int>> mood_scales = {
-    {"joyful", {60, 62, 64, 65, 67, 69, 71, 72}},
-    {"melancholy", {60, 62, 63, 65, 67, 68, 70, 72}},
-    {"powerful", {60, 62, 65, 67, 70, 72}},
-    {"calm", {60, 62, 64, 65, 67, 69, 71}},
-    {"tense", {60, 61, 64, 65, 68, 69, 72}},
-    {"dreamy", {60, 62, 64, 66, 69, 71}}
-};
-
-// 🥁 Rhythm Patterns (durations in milliseconds)
-vector<int> rhythm_pattern = {400, 200, 600, 300, 500};
+map<string, vector<int>> mood_scales = builtinScaleTable();
+
+// 🥁 Rhythm Pattern (step lengths in ticks, 480 per quarter: the classic
+// 400/200/600/300/500 ms at 120 BPM, scaled by each mood's tempo)
+RhythmPattern rhythm_pattern({384, 192, 576, 288, 480});
 
 // 🎚️ Tempo Mapping
-map<string, int> mood_tempo = {
-    {"joyful", 120}, {"melancholy", 60}, {"powerful", 150},
-    {"calm", 80}, {"tense", 100}, {"dreamy", 90}
-};
+map<string, int> mood_tempo = builtinTempoTable();
 
 // 🎹 Instrument Mapping
-map<string, int> mood_instruments = {
-    {"joyful", 0}, {"melancholy", 40}, {"powerful", 81},
-    {"calm", 14}, {"tense", 48}, {"dreamy", 89}
-};
+map<string, int> mood_instruments = builtinInstrumentTable();
+
+// 🧬 True while the tables above still hold the built-in profiles, so the
+// per-mood kernels in mood_profiles.h may stand in for the map walk
+bool builtin_tables = true;
+
+// 🧮 Compiled Models (built once at startup from the tables above)
+map<string, CompiledMood> compiled_moods;
+
+// 📚 Corpus-trained n-gram models (only for moods trained with --train)
+map<string, NgramModel> trained_moods;
+
+// 💽 Model file mapped with --model; its views replace the models above
+MoodModelFile model_file;
 
-// 🎶 Generate Melody
+// 🧭 Generators in use: views into compiled_moods, trained_moods or model_file
+map<string, CompiledMoodView> mood_models;
+map<string, NgramView> ngram_models;
+
+// 🎶 Original map-based generator, kept only as the --bench model baseline
+// (it draws from rand(), so it is not reproducible from a seed)
 vector<int> generateMelody(string mood, int length) {
     vector<int> melody;
     vector<int> scale = mood_scales[mood];
@@ -60,52 +87,96 @@ vector<int> generateMelody(string mood, int length) {
     return melody;
 }
 
-// 💾 Export as Text
-void exportToMidiText(const vector<int>& melody, const string& filename) {
-    ofstream out(filename);
-    for (int note : melody) {
-        out << "Note: " << note << "\n";
+// 💾 Export as a binary note stream (delta, key, velocity, duration)
+void exportNoteStream(const vector<int>& melody, const string& filename, const string& mood) {
+    NoteStreamWriter writer;
+    bool ok = writer.open(filename);
+    if (ok) {
+        writer.addMelody(melody.data(), melody.size(), rhythm_pattern, TempoMap(mood_tempo[mood]));
+        ok = writer.close();
+    }
+    if (!ok) {
+        cerr << "Error: could not write: " << filename << endl;
+        return;
     }
-    out.close();
     cout << "Melody exported to " << filename << endl;
 }
 
-// 🎼 Export to MIDI using Midifile
-void saveAsMIDI(const vector<int>& melody, const string& filename, string mood) {
-    MidiFile midi;
-    midi.addTrack(1);
-    int tpq = 480;
-    midi.setTicksPerQuarterNote(tpq);
+// 🎼 Encode a melody as SMF bytes (tempo, instrument, rhythm of the mood)
+void encodeMelody(vector<uint8_t>& bytes, const int* melody, size_t length, int tempo,
+                  int instrument) {
+    RhythmClock clock(rhythm_pattern);
+    encodeMelodySmf(bytes, melody, length, RHYTHM_TPQ, tempo, instrument, [&](size_t) {
+        NoteTiming timing = clock.next();
+        return static_cast<int>(timing.off - timing.on);
+    });
+}
 
-    int track = 0;
-    int instrument = mood_instruments[mood];
-    int tempo = mood_tempo[mood];
-    int tick = 0;
+// 🎼 Export to MIDI (streamed straight into a byte buffer, no sorting)
+void saveAsMIDI(const vector<int>& melody, const string& filename, string mood) {
+    vector<uint8_t> bytes;
+    encodeMelody(bytes, melody.data(), melody.size(), mood_tempo[mood], mood_instruments[mood]);
+    if (!writeBytes(filename, bytes)) {
+        cerr << "Error: could not write: " << filename << endl;
+        return;
+    }
+    cout << "MIDI file saved as " << filename << endl;
+}
 
-    // Set tempo
-    midi.addTempo(track, tick, tempo);
+// ⏰ Playback timing: busy-wait this long before each deadline, and
+// generate this far ahead of the clock
+int playback_spin_us = 500;
+const chrono::milliseconds playback_lookahead(200);
 
-    // Set instrument
-    midi.addTimbre(track, tick, 0, instrument);
+void printLateness(const LatenessStats& stats) {
+    cout << "Playback lateness over " << stats.count << " events: mean "
+         << stats.mean() << " us, p50 " << stats.percentile(0.5) << " us, p99 "
+         << stats.percentile(0.99) << " us, max " << stats.max_us << " us, final drift "
+         << stats.last_us << " us" << endl;
+}
 
-    // Add notes
-    for (size_t i = 0; i < melody.size(); i++) {
-        int note = melody[i];
-        int duration_ms = rhythm_pattern[i % rhythm_pattern.size()];
-        int duration_ticks = (duration_ms * tpq) / (60000 / tempo);
+// ⏰ Schedule notes pulled one at a time from `next` and hand each MIDI
+// message to `send(bytes, size)` at its absolute deadline.  Note ticks go
+// through a tempo map starting at `bpm` (and following the notes' tempo
+// changes), exactly as the exported SMF times them.  Events are queued a
+// short lookahead ahead of the clock, so output starts after the first
+// note and timing never drifts.
+template <class Source, class Send>
+LatenessStats runPlayback(Source next, Send send, double bpm,
+                          vector<DispatchRecord>* trace = nullptr) {
+    auto scheduler = makeScheduler(send, chrono::microseconds(playback_spin_us));
+    scheduler.trace(trace);
 
-        midi.addNoteOn(track, tick, 0, note, 100);
-        midi.addNoteOff(track, tick + duration_ticks, 0, note);
-        tick += duration_ticks;
+    TempoMap tempo(bpm);
+    NoteEvent event;
+    bool more = true;
+    chrono::steady_clock::duration offset(0);
+    scheduler.start();
+    while (true) {
+        while (more && offset <= scheduler.elapsed() + playback_lookahead) {
+            more = next(event);
+            if (!more) break;
+            if (event.tempo > 0.0) tempo.set(event.tick, event.tempo);
+            offset = chrono::microseconds(tempo.micros(event.tick));
+            auto release = chrono::microseconds(tempo.micros(event.offTick()));
+            unsigned char key = static_cast<unsigned char>(event.key);
+            unsigned char channel = static_cast<unsigned char>(event.channel & 0x0F);
+            if (event.program >= 0) {
+                scheduler.at(offset, 0xC0 | channel, static_cast<unsigned char>(event.program), 0, 2);
+            }
+            scheduler.at(offset, 0x90 | channel, key, static_cast<unsigned char>(event.velocity));
+            scheduler.at(release, 0x80 | channel, key, 0);
+        }
+        if (scheduler.empty()) break;
+        scheduler.dispatchNext();
     }
-
-    midi.sortTracks();
-    midi.write(filename);
-    cout << "MIDI file saved as " << filename << endl;
+    return scheduler.stats();
 }
 
-// 🎛️ Play Melody using RtMidi
-void playMelody(vector<int> melody, string mood) {
+// 🎛️ Play notes pulled from `next` on the first MIDI output port at
+// `bpm`, after setting channel c to programs[c]
+template <class Source>
+void playNotes(Source next, const vector<int>& programs, double bpm) {
     RtMidiOut midiOut;
     if (midiOut.getPortCount() == 0) {
         cout << "No MIDI output ports found!" << endl;
@@ -113,42 +184,1225 @@ void playMelody(vector<int> melody, string mood) {
     }
     midiOut.openPort(0);
 
-    vector<unsigned char> message;
-    message.push_back(0xC0);
-    message.push_back(mood_instruments[mood]);
-    midiOut.sendMessage(&message);
+    for (size_t channel = 0; channel < programs.size(); channel++) {
+        vector<unsigned char> message;
+        message.push_back(static_cast<unsigned char>(0xC0 | channel));
+        message.push_back(static_cast<unsigned char>(programs[channel]));
+        midiOut.sendMessage(&message);
+    }
+
+    LatenessStats stats = runPlayback(next, [&](const unsigned char* bytes, size_t size) {
+        midiOut.sendMessage(bytes, size);
+    }, bpm);
+    midiOut.closePort();
+    printLateness(stats);
+}
+
+// Note events of `melody` in the shared rhythm
+template <class Play>
+void melodyEvents(const vector<int>& melody, Play play) {
+    size_t i = 0;
+    RhythmClock clock(rhythm_pattern);
+    play([&](NoteEvent& event) {
+        if (i >= melody.size()) return false;
+        NoteTiming timing = clock.next();
+        event.index = static_cast<long long>(i);
+        event.key = melody[i];
+        event.velocity = 100;
+        event.tick = timing.on;
+        event.duration = static_cast<int>(timing.off - timing.on);
+        i++;
+        return true;
+    });
+}
+
+// 🎛️ Play Melody using RtMidi
+void playMelody(vector<int> melody, string mood) {
+    melodyEvents(melody, [&](auto next) { playNotes(next, {mood_instruments[mood]}, mood_tempo[mood]); });
+}
 
+// 🌊 Play an endless (or --length limited) stream of generated notes
+void playStream(MelodyStream& stream, const string& mood) {
+    playNotes([&](NoteEvent& event) { return stream.next(event); }, {mood_instruments[mood]},
+              mood_tempo[mood]);
+}
+
+// 🌗 Play `from` morphing into `to` over `bars` bars, then carry on in `to`
+void playMorph(const string& from, const string& to, int bars, uint64_t seed, long long length) {
+    MorphEndpoint source{mood_models[from], mood_tempo[from], mood_instruments[from]};
+    MorphEndpoint target{mood_models[to], mood_tempo[to], mood_instruments[to]};
+    MorphStream stream(source, rhythm_pattern, melodySeed(from, seed, 0), length);
+    stream.morphTo(target, bars);
+    cout << "Morphing " << from << " -> " << to << " over " << bars << " bars" << endl;
+    playNotes([&](NoteEvent& event) { return stream.next(event); }, {}, mood_tempo[from]);
+}
+
+// 🔊 Render notes offline to a WAV file (for machines with no MIDI port)
+int wav_rate = 44100;
+int wav_bits = 16;
+
+bool renderWav(const vector<SynthNote>& notes, const string& filename) {
+    vector<float> samples;
+    SynthStats stats = renderSynth(notes, wav_rate, samples);
+    normalizePeak(samples);
+    if (!writeWav(filename, samples, wav_rate, wav_bits)) {
+        cerr << "Error: could not write: " << filename << endl;
+        return false;
+    }
+    cout << "Rendered " << stats.voices << " voices, " << static_cast<double>(stats.frames) / wav_rate
+         << " s of audio in " << stats.seconds << " s (" << stats.realtime << "x real time) to "
+         << filename << endl;
+    return true;
+}
+
+// Notes of `melody` as playMelody() would play them
+vector<SynthNote> melodySynthNotes(const vector<int>& melody, const string& mood) {
+    vector<SynthNote> notes;
+    melodyEvents(melody, [&](auto next) {
+        notes = synthNotesFromStream(next, {mood_instruments[mood]}, mood_tempo[mood]);
+    });
+    return notes;
+}
+
+// 🏭 Batch Mode: generate a reproducible catalog across all cores
+// Generate the catalog with `model`; with a MIDI directory each worker
+// also encodes and writes its melodies as they are produced, counting
+// files it could not write in `failed`.
+template <class Model>
+BatchStats generateCatalog(const Model& model, const string& mood, uint64_t seed, int count,
+                           int length, int* catalog, int threads, const string& midi_dir,
+                           atomic<long long>& failed) {
+    if (midi_dir.empty()) {
+        return generateMelodyBatch(mood, seed, count, length, catalog, model, threads);
+    }
     int tempo = mood_tempo[mood];
-    for (size_t i = 0; i < melody.size(); i++) {
-        int note = melody[i];
-        int velocity = 100;
+    int instrument = mood_instruments[mood];
+    return runMelodyBatch(mood, seed, count, length, catalog, threads,
+        [&](int* melody, int n, MelodyRng& rng) {
+            model.generate(melody, n, rng);
+            thread_local vector<uint8_t> bytes;
+            bytes.clear();
+            encodeMelody(bytes, melody, static_cast<size_t>(n), tempo, instrument);
+            long long k = (melody - catalog) / n;
+            if (!writeBytes(midi_dir + "/" + mood + "_" + to_string(k) + ".mid", bytes)) {
+                failed.fetch_add(1, memory_order_relaxed);
+            }
+        });
+}
 
-        message = {0x90, static_cast<unsigned char>(note), static_cast<unsigned char>(velocity)};
-        midiOut.sendMessage(&message);
+// Write every melody of a finished catalog as <midi_dir>/<mood>_<k>.mid;
+// returns the number of files that could not be written.
+long long writeCatalogMidi(const string& mood, const int* catalog, int count, int length, int threads,
+                           const string& midi_dir) {
+    atomic<long long> failed(0);
+    int tempo = mood_tempo[mood];
+    int instrument = mood_instruments[mood];
+    runMelodyBlocks(count, length, const_cast<int*>(catalog), threads,
+        [&](int first, int n, int* melodies) {
+            vector<uint8_t> bytes;
+            for (int j = 0; j < n; j++) {
+                bytes.clear();
+                encodeMelody(bytes, melodies + static_cast<size_t>(j) * length,
+                             static_cast<size_t>(length), tempo, instrument);
+                if (!writeBytes(midi_dir + "/" + mood + "_" + to_string(first + j) + ".mid", bytes)) {
+                    failed.fetch_add(1, memory_order_relaxed);
+                }
+            }
+        });
+    return failed.load();
+}
 
-        this_thread::sleep_for(chrono::milliseconds(rhythm_pattern[i % rhythm_pattern.size()]));
+int runBatch(const string& mood, uint64_t seed, int count, int length, int threads,
+             const string& filename, const string& midi_dir, bool simd) {
+    vector<int> catalog(static_cast<size_t>(count) * length);
+    BatchStats stats;
+    atomic<long long> midi_failed(0);
+    if (simd && !ngram_models.count(mood)) {
+        SimdLevel level = detectSimd();
+        stats = generateLockstepBatch(mood, seed, count, length, catalog.data(), mood_models[mood],
+                                      threads, level);
+        cout << "Lock-step sampling with " << simdName(level) << " (" << simdLanes(level)
+             << " chains per step)" << endl;
+        if (!midi_dir.empty()) {
+            midi_failed += writeCatalogMidi(mood, catalog.data(), count, length, threads, midi_dir);
+        }
+    } else if (ngram_models.count(mood)) {
+        stats = generateCatalog(ngram_models[mood], mood, seed, count, length, catalog.data(),
+                                threads, midi_dir, midi_failed);
+    } else if (builtin_tables && builtinMoodId(mood) != MOOD_NONE) {
+        BuiltinMoodKernel kernel{builtinMoodId(mood)};
+        stats = generateCatalog(kernel, mood, seed, count, length, catalog.data(), threads,
+                                midi_dir, midi_failed);
+    } else {
+        stats = generateCatalog(mood_models[mood], mood, seed, count, length, catalog.data(),
+                                threads, midi_dir, midi_failed);
+    }
 
-        message = {0x80, static_cast<unsigned char>(note), 0};
-        midiOut.sendMessage(&message);
+    uint64_t checksum = 0xCBF29CE484222325ULL;
+    for (int note : catalog) {
+        checksum = (checksum ^ static_cast<uint64_t>(note)) * 0x100000001B3ULL;
     }
-    midiOut.closePort();
+
+    cout << "Generated " << stats.melodies << " melodies x " << length << " notes on "
+         << stats.threads << " threads in " << stats.seconds << " s ("
+         << static_cast<long long>(stats.melodies_per_second) << " melodies/s)" << endl;
+    cout << "Catalog checksum: " << hex << checksum << dec << endl;
+
+    bool binary = filename.size() > 6 && filename.compare(filename.size() - 6, 6, ".notes") == 0;
+    if (binary) {
+        TempoMap tempo(mood_tempo[mood]);
+        NoteStreamWriter writer;
+        bool ok = writer.open(filename);
+        for (int k = 0; ok && k < count; k++) {
+            writer.addMelody(catalog.data() + static_cast<size_t>(k) * length,
+                             static_cast<size_t>(length), rhythm_pattern, tempo);
+        }
+        if (!writer.close() || !ok) {
+            cerr << "Error: could not write: " << filename << endl;
+            return 1;
+        }
+        cout << "Catalog exported to " << filename << endl;
+    } else if (!filename.empty()) {
+        ofstream out(filename);
+        for (int k = 0; k < count; k++) {
+            const int* melody = catalog.data() + static_cast<size_t>(k) * length;
+            for (int i = 0; i < length; i++) {
+                out << melody[i] << (i + 1 < length ? ' ' : '\n');
+            }
+        }
+        out.close();
+        if (!out) {
+            cerr << "Error: could not write: " << filename << endl;
+            return 1;
+        }
+        cout << "Catalog exported to " << filename << endl;
+    }
+    if (midi_failed > 0) {
+        cerr << "Error: could not write " << midi_failed << " of " << count << " MIDI files to "
+             << midi_dir << endl;
+        return 1;
+    }
+    if (!midi_dir.empty()) {
+        cout << "MIDI files written to " << midi_dir << endl;
+    }
+    return 0;
+}
+
+// 🎻 Arrangement Mode: melody, bass, pad and drums generated concurrently
+int runArrangement(const string& mood, double seconds, uint64_t seed, const string& filename,
+                   const string& wav) {
+    int tempo = mood_tempo[mood];
+    HarmonicPlan plan = makeHarmonicPlan(mood_scales[mood], tempo, seconds, melodySeed(mood, seed, 99),
+                                         rhythm_pattern.meter());
+    MidiFile midi;
+    ArrangementTiming timing;
+    if (ngram_models.count(mood)) {
+        timing = arrangePiece(midi, plan, ngram_models[mood], rhythm_pattern, tempo,
+                              mood_instruments[mood], mood, seed);
+    } else {
+        timing = arrangePiece(midi, plan, mood_models[mood], rhythm_pattern, tempo,
+                              mood_instruments[mood], mood, seed);
+    }
+
+    static const char* part_names[PART_COUNT] = {"melody", "bass", "pad", "drums"};
+    cout << "Arranged " << plan.bars << " bars (" << seconds << " s) of " << mood << " in "
+         << timing.total_seconds * 1000.0 << " ms; parts:";
+    for (int part = 0; part < PART_COUNT; part++) {
+        cout << " " << part_names[part] << " " << timing.part_seconds[part] * 1000.0 << " ms";
+    }
+    cout << endl;
+
+    if (!midi.write(filename)) return 1;
+    cout << "MIDI file saved as " << filename << endl;
+    if (!wav.empty() && !renderWav(synthNotesFromMidi(midi), wav)) return 1;
+    return 0;
+}
+
+// 🛡️ Check MIDI files before trusting them: structure only, nothing is parsed
+int runValidate(const vector<string>& files, bool strict) {
+    if (files.empty()) {
+        cout << "No MIDI files to validate" << endl;
+        return 1;
+    }
+    int invalid = 0;
+    for (const string& file : files) {
+        SmfData data;
+        if (!data.open(file)) {
+            invalid++;
+            cout << file << ": cannot read" << endl;
+            continue;
+        }
+        SmfCheck check;
+        auto start = chrono::steady_clock::now();
+        bool valid = MidiFile::validateSmf(data.data(), data.size(), &check, strict);
+        double us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+        if (valid) {
+            cout << file << ": ok, " << check.tracks << " tracks, " << check.events << " events ("
+                 << us << " us)" << endl;
+            continue;
+        }
+        invalid++;
+        cout << file << ": " << check.reason << " at byte " << check.offset;
+        if (check.track >= 0) cout << " in track " << check.track;
+        cout << endl;
+    }
+    return invalid == 0 ? 0 : 1;
+}
+
+// 📚 Train an n-gram model for a mood from a directory of MIDI files
+bool trainMood(const string& mood, const string& directory, int order, int min_count,
+               int threads) {
+    vector<string> files = listMidiFiles(directory);
+    NgramCounts counts(order);
+    CorpusStats stats = ingestCorpus(files, counts, threads);
+    if (stats.failed > 0) {
+        cerr << "Skipped " << stats.failed << " unreadable MIDI files" << endl;
+    }
+    cout << "Ingested " << stats.files << " files (" << stats.events << " events) on "
+         << stats.threads << " threads in " << stats.seconds << " s: "
+         << static_cast<long long>(stats.files_per_second) << " files/s, "
+         << static_cast<long long>(stats.events_per_second) << " events/s" << endl;
+    if (counts.notes == 0) {
+        cout << "No notes found in " << directory << endl;
+        return false;
+    }
+
+    NgramModel& model = trained_moods[mood];
+    model.build(counts, static_cast<uint32_t>(max(1, min_count)));
+    ngram_models[mood] = model.view();
+    cout << "Trained order-" << model.order << " model for " << mood << " from "
+         << counts.notes << " notes: " << model.contextCount() << " contexts, "
+         << model.memoryBytes() / 1024 << " KiB" << endl;
+    return true;
+}
+
+// 💽 Load a model file: tables come from the mapping, mood settings are copied
+bool loadModelFile(const string& filename) {
+    auto start = chrono::steady_clock::now();
+    string error;
+    if (!model_file.open(filename, error)) {
+        cout << "Cannot load model " << filename << ": " << error << endl;
+        return false;
+    }
+    builtin_tables = false;
+    mood_scales.clear();
+    mood_tempo.clear();
+    mood_instruments.clear();
+    mood_models.clear();
+    ngram_models.clear();
+    for (const MoodModelEntry& entry : model_file.moods()) {
+        mood_scales[entry.name] = entry.scale;
+        mood_tempo[entry.name] = entry.tempo;
+        mood_instruments[entry.name] = entry.instrument;
+        mood_models[entry.name] = entry.compiled;
+        if (entry.ngram.slots) {
+            ngram_models[entry.name] = entry.ngram;
+        }
+    }
+    if (!model_file.rhythm().empty()) {
+        rhythm_pattern = RhythmPattern(model_file.rhythm(), rhythm_pattern.meter(), rhythm_pattern.swing());
+    }
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cout << "Mapped model " << filename << " (" << model_file.size() / 1024 << " KiB, "
+         << model_file.moods().size() << " moods) in " << ms << " ms" << endl;
+    return true;
+}
+
+// ✍️ Save every mood, with any trained n-gram model, as a model file
+bool saveModelFile(const string& filename) {
+    vector<MoodModelEntry> entries;
+    for (const auto& scale : mood_scales) {
+        MoodModelEntry entry;
+        entry.name = scale.first;
+        entry.tempo = mood_tempo[scale.first];
+        entry.instrument = mood_instruments[scale.first];
+        entry.scale = scale.second;
+        entry.compiled = mood_models[scale.first];
+        if (ngram_models.count(scale.first)) {
+            entry.ngram = ngram_models[scale.first];
+        }
+        entries.push_back(entry);
+    }
+    if (!writeMoodModelFile(filename, rhythm_pattern.steps(), entries)) {
+        cout << "Cannot write model " << filename << endl;
+        return false;
+    }
+    cout << "Model saved as " << filename << endl;
+    return true;
+}
+
+// 📡 Daemon Mode: answer generation requests over a Unix domain socket
+// Melody `seed` of a mood is entry 0 of the batch catalog for that seed.
+// Runs on several workers at once, so the tables are only read.
+bool generateResponse(const DaemonRequest& request, vector<uint8_t>& payload, string& error) {
+    auto tempo = mood_tempo.find(request.mood);
+    auto instrument = mood_instruments.find(request.mood);
+    if (tempo == mood_tempo.end() || instrument == mood_instruments.end()) {
+        error = "unknown mood " + request.mood;
+        return false;
+    }
+    thread_local vector<int> melody;
+    melody.resize(static_cast<size_t>(request.length));
+    MelodyRng rng(melodySeed(request.mood, request.seed, 0));
+    auto ngram = ngram_models.find(request.mood);
+    MoodId builtin = builtin_tables ? builtinMoodId(request.mood) : MOOD_NONE;
+    if (ngram != ngram_models.end()) {
+        ngram->second.generate(melody.data(), request.length, rng);
+    } else if (builtin != MOOD_NONE) {
+        generateBuiltinMelody(builtin, melody.data(), request.length, rng);
+    } else {
+        mood_models.find(request.mood)->second.generate(melody.data(), request.length, rng);
+    }
+
+    if (request.format == "notes") {
+        for (int note : melody) {
+            string line = "Note: " + to_string(note) + "\n";
+            payload.insert(payload.end(), line.begin(), line.end());
+        }
+    } else {
+        encodeMelody(payload, melody.data(), melody.size(), tempo->second, instrument->second);
+    }
+    return true;
+}
+
+// 🗃️ Output cache for daemon responses (null: off), and a fingerprint of
+// each mood's generator tables so a changed model never hits old entries
+unique_ptr<OutputCache> output_cache;
+map<string, uint64_t> model_fingerprints;
+
+// Bump whenever encodeMelody() or the notes format changes its output.
+const int output_format_version = 2;
+
+void fingerprintModels() {
+    for (const auto& mood : mood_tempo) {
+        DigestBuilder digest;
+        auto compiled = mood_models.find(mood.first);
+        if (compiled != mood_models.end() && compiled->second.rows) {
+            digest.add(compiled->second.rows, sizeof(MoodRow) * (CompiledMoodView::KEYS + 1));
+            digest.add(compiled->second.cells, sizeof(AliasCell) * compiled->second.cell_count);
+        }
+        auto ngram = ngram_models.find(mood.first);
+        if (ngram != ngram_models.end()) {
+            digest.add(static_cast<uint64_t>(ngram->second.order));
+            digest.add(ngram->second.slots, sizeof(NgramSlot) * ngram->second.slotCount());
+            digest.add(ngram->second.cells, sizeof(AliasCell) * ngram->second.cell_count);
+        }
+        model_fingerprints[mood.first] = digest.digest().lo;
+    }
+}
+
+// Digest of everything a response depends on.
+CacheDigest requestDigest(const DaemonRequest& request) {
+    DigestBuilder digest;
+    digest.add(static_cast<uint64_t>(output_format_version)).add(request.format).add(request.mood);
+    digest.add(static_cast<uint64_t>(request.length)).add(request.seed);
+    digest.add(static_cast<uint64_t>(mood_tempo.find(request.mood)->second));
+    digest.add(static_cast<uint64_t>(mood_instruments.find(request.mood)->second));
+    const vector<int>& steps = rhythm_pattern.steps();
+    digest.add(steps.data(), steps.size() * sizeof(int));
+    digest.add(static_cast<uint64_t>(rhythm_pattern.swing()));
+    digest.add(static_cast<uint64_t>(rhythm_pattern.meter().beats)).add(static_cast<uint64_t>(rhythm_pattern.meter().unit));
+    digest.add(model_fingerprints.find(request.mood)->second);
+    return digest.digest();
+}
+
+bool serveRequest(const DaemonRequest& request, vector<uint8_t>& payload, string& error) {
+    if (!output_cache || !model_fingerprints.count(request.mood)) {
+        return generateResponse(request, payload, error);
+    }
+    CacheDigest key = requestDigest(request);
+    OutputCache::Buffer cached = output_cache->find(key);
+    if (!cached) {
+        if (!generateResponse(request, payload, error)) return false;
+        output_cache->insert(key, payload);
+        return true;
+    }
+    payload.assign(cached->begin(), cached->end());
+    return true;
+}
+
+void printCacheStats() {
+    if (!output_cache) return;
+    CacheStats stats = output_cache->stats();
+    cout << "Cache: " << stats.hits << " hits, " << stats.disk_hits << " disk hits, "
+         << stats.misses << " misses, " << stats.evictions << " evictions; " << stats.entries
+         << " entries, " << stats.bytes / 1024 << " of " << stats.max_bytes / 1024 << " KiB" << endl;
+    if (stats.disk_max_bytes > 0) {
+        cout << "Disk cache: " << stats.disk_entries << " files, " << stats.disk_bytes / 1024 << " of "
+             << stats.disk_max_bytes / 1024 << " KiB, " << stats.disk_evictions << " evictions" << endl;
+    }
+}
+
+void configureCache(int megabytes, const string& directory, int disk_megabytes) {
+    if (megabytes <= 0) return;
+    output_cache.reset(new OutputCache(static_cast<size_t>(megabytes) << 20, directory,
+                                       static_cast<size_t>(max(0, disk_megabytes)) << 20));
+    fingerprintModels();
+}
+
+int daemon_wake_fd = -1;
+
+void stopDaemon(int) {
+    wakeDaemon(daemon_wake_fd);
+}
+
+int runDaemon(const string& path, int workers) {
+    MoodDaemon<decltype(&serveRequest)> daemon(&serveRequest, workers);
+    string error;
+    if (!daemon.listen(path, error)) {
+        cout << "Cannot listen on " << path << ": " << error << endl;
+        return 1;
+    }
+    daemon_wake_fd = daemon.wakeFd();
+    signal(SIGINT, stopDaemon);
+    signal(SIGTERM, stopDaemon);
+    cout << "Serving on " << path << " with " << daemon.workers() << " workers" << endl;
+    daemon.run();
+    daemon_wake_fd = -1;
+    cout << "Served " << daemon.stats().requests << " requests (" << daemon.stats().errors
+         << " errors) in " << daemon.stats().batches << " batches over "
+         << daemon.stats().connections << " connections" << endl;
+    printCacheStats();
+    return 0;
+}
+
+// ⏱️ Benchmark: map-based generateMelody() against the compiled model
+int runModelBench(const string& mood) {
+    const int length = 16;
+    const int count = 200000;
+    const long long notes = static_cast<long long>(count) * length;
+    vector<int> buffer(length);
+    vector<BenchResult> results;
+
+    results.push_back(benchItems("generateMelody (map, rand)", notes, [&]() {
+        for (int k = 0; k < count; k++) {
+            benchSink(generateMelody(mood, length).back());
+        }
+    }));
+    const vector<int>& scale = mood_scales[mood];
+    results.push_back(benchItems("map walk, MelodyRng", notes, [&]() {
+        MelodyRng rng(1);
+        for (int k = 0; k < count; k++) {
+            generateMelodyInto(buffer.data(), length, scale, mood_transitions, rng);
+            benchSink(buffer.back());
+        }
+    }));
+    const CompiledMood& model = compiled_moods[mood];
+    results.push_back(benchItems("compiled model, MelodyRng", notes, [&]() {
+        MelodyRng rng(1);
+        for (int k = 0; k < count; k++) {
+            model.generate(buffer.data(), length, rng);
+            benchSink(buffer.back());
+        }
+    }));
+
+    cout << "Melody generation, mood " << mood << ", " << count << " x " << length << " notes" << endl;
+    printBench(results, "note");
+    return 0;
+}
+
+// ⏱️ Benchmark: string-keyed lookups against the per-mood kernels
+int runKernelBench(const string& mood) {
+    MoodId id = builtinMoodId(mood);
+    if (id == MOOD_NONE || !builtin_tables) {
+        cout << "Kernel benchmark needs a built-in mood" << endl;
+        return 1;
+    }
+    const int length = 16;
+    const int count = 200000;
+    const long long notes = static_cast<long long>(count) * length;
+    vector<int> buffer(length);
+    vector<BenchResult> results;
+
+    results.push_back(benchItems("string path (map lookups)", notes, [&]() {
+        MelodyRng rng(1);
+        for (int k = 0; k < count; k++) {
+            generateMelodyInto(buffer.data(), length, mood_scales[mood], mood_transitions, rng);
+            benchSink(buffer.back() + mood_tempo[mood] + mood_instruments[mood]);
+        }
+    }));
+    const CompiledMoodView model = mood_models[mood];
+    results.push_back(benchItems("compiled model", notes, [&]() {
+        MelodyRng rng(1);
+        for (int k = 0; k < count; k++) {
+            model.generate(buffer.data(), length, rng);
+            benchSink(buffer.back());
+        }
+    }));
+    results.push_back(benchItems("constexpr kernel (switch)", notes, [&]() {
+        MelodyRng rng(1);
+        for (int k = 0; k < count; k++) {
+            generateBuiltinMelody(id, buffer.data(), length, rng);
+            benchSink(buffer.back() + builtin_moods[id].tempo + builtin_moods[id].instrument);
+        }
+    }));
+
+    cout << "Per-melody mood dispatch, mood " << mood << ", " << count << " x " << length
+         << " notes" << endl;
+    printBench(results, "note");
+    return 0;
+}
+
+// ⏱️ Benchmark: scalar chains against lock-step SIMD chains
+int runSimdBench(const string& mood) {
+    const int length = 16;
+    const int count = 200000;
+    const long long notes = static_cast<long long>(count) * length;
+    const CompiledMoodView model = mood_models[mood];
+    vector<uint64_t> seeds(count);
+    for (int k = 0; k < count; k++) {
+        seeds[k] = melodySeed(mood, 1, static_cast<uint64_t>(k));
+    }
+    vector<int> reference(static_cast<size_t>(notes)), melodies(reference.size());
+    vector<BenchResult> results;
+
+    results.push_back(benchItems("scalar chains", notes, [&]() {
+        sampleChainsScalar(model, seeds.data(), count, length, reference.data(), length);
+        benchSink(reference.back());
+    }));
+    bool all_match = true;
+    SimdLevel best = detectSimd();
+    for (SimdLevel level : {SIMD_AVX2, SIMD_AVX512}) {
+        if (level > best) break;
+        fill(melodies.begin(), melodies.end(), 0);
+        results.push_back(benchItems(string("lock-step ") + simdName(level), notes, [&]() {
+            sampleChains(model, seeds.data(), count, length, melodies.data(), length, level);
+            benchSink(melodies.back());
+        }));
+        bool match = melodies == reference;
+        all_match = all_match && match;
+        cout << simdName(level) << " chains " << (match ? "match" : "DIFFER FROM") << " scalar" << endl;
+    }
+
+    cout << "Lock-step sampling, mood " << mood << ", " << count << " x " << length << " notes"
+         << endl;
+    printBench(results, "note");
+    return all_match ? 0 : 1;
+}
+
+// ⏱️ Benchmark: beam-search throughput as the beam widens
+int runBeamBench(const string& mood, int length, int threads) {
+    const CompiledMoodView model = mood_models[mood];
+    ShapeScorer scorer;
+    scorer.tonic = mood_scales[mood][0];
+    StepPool pool(threads);
+    vector<int> melody(static_cast<size_t>(length));
+    vector<BenchResult> results;
+    vector<double> best;
+
+    for (int width : {1, 4, 16, 64, 256, 1024, 4096}) {
+        int melodies = max(1, 4096 / width);
+        BeamStats stats;
+        beamSearch(model, scorer, length, width, 1, melody.data(), pool);  // warm up
+        long long candidates = 0;
+        for (int k = 0; k < melodies; k++) {
+            candidates += beamSearch(model, scorer, length, width, static_cast<uint64_t>(k),
+                                     melody.data(), pool).candidates;
+        }
+        results.push_back(benchItems("width " + to_string(width), candidates, [&]() {
+            double total = 0.0;
+            for (int k = 0; k < melodies; k++) {
+                stats = beamSearch(model, scorer, length, width, static_cast<uint64_t>(k),
+                                   melody.data(), pool);
+                total += stats.best_score;
+            }
+            benchSink(static_cast<long long>(total));
+        }, 3));
+        double total = 0.0;
+        for (int k = 0; k < melodies; k++) {
+            total += beamSearch(model, scorer, length, width, static_cast<uint64_t>(k),
+                                melody.data(), pool).best_score;
+        }
+        best.push_back(total / melodies);
+    }
+
+    cout << "Beam search, mood " << mood << ", " << length << " notes, " << pool.threads()
+         << " threads" << endl;
+    printBench(results, "candidate");
+    cout << "Mean best score by width:";
+    for (double score : best) cout << " " << score;
+    cout << endl;
+    return 0;
+}
+
+// ⏱️ Benchmark: one long melody, serial vs. parallel counter-based chunks
+int runCounterBench(const string& mood, long long length, int threads) {
+    const CompiledMoodView model = mood_models[mood];
+    const uint64_t seed = melodySeed(mood, 1, 0);
+    vector<int> serial(static_cast<size_t>(length)), chunked(serial.size());
+    vector<BenchResult> results;
+
+    results.push_back(benchItems("serial, MelodyRng", length, [&]() {
+        MelodyRng rng(seed);
+        model.generate(serial.data(), static_cast<int>(length), rng);
+        benchSink(serial.back());
+    }, 3));
+    results.push_back(benchItems("serial, CounterRng", length, [&]() {
+        CounterRng rng(seed, 0);
+        model.generate(serial.data(), static_cast<int>(length), rng);
+        benchSink(serial.back());
+    }, 3));
+    results.push_back(benchItems("parallel chunks, CounterRng", length, [&]() {
+        generateChunked(model, seed, 0, chunked.data(), length, threads);
+        benchSink(chunked.back());
+    }, 3));
+
+    // Regenerate one bar-sized span in the middle from the note before it.
+    long long begin = length / 2;
+    long long end = min(length, begin + 16);
+    vector<int> bar(static_cast<size_t>(end - begin));
+    regenerateRange(model, seed, 0, begin, end, serial[begin - 1], bar.data());
+
+    cout << "One melody of " << length << " notes, mood " << mood << endl;
+    printBench(results, "note");
+    cout << "Chunked output " << (chunked == serial ? "matches" : "DIFFERS FROM") << " serial; "
+         << "regenerated notes " << begin << "-" << end - 1 << " "
+         << (equal(bar.begin(), bar.end(), serial.begin() + begin) ? "match" : "DIFFER") << endl;
+    return chunked == serial ? 0 : 1;
+}
+
+// ⏱️ Benchmark: "Note: N" text dump vs. the binary note stream, written
+// and scanned back
+int runNotesBench(const string& mood, int count, int length) {
+    vector<int> catalog(static_cast<size_t>(count) * length);
+    generateMelodyBatch(mood, 1, count, length, catalog.data(), mood_models[mood], 0);
+    const long long notes = static_cast<long long>(catalog.size());
+    string directory = filesystem::temp_directory_path().string();
+    string text_file = directory + "/moodplayer-bench.txt";
+    string note_file = directory + "/moodplayer-bench.notes";
+    long long text_sum = 0, binary_sum = 0, expected = 0;
+    for (int note : catalog) expected += note;
+    vector<BenchResult> results;
+
+    results.push_back(benchItems("write text (ofstream)", notes, [&]() {
+        ofstream out(text_file);
+        for (int note : catalog) {
+            out << "Note: " << note << "\n";
+        }
+    }, 3));
+    TempoMap tempo(mood_tempo[mood]);
+    results.push_back(benchItems("write binary (stream writer)", notes, [&]() {
+        NoteStreamWriter writer;
+        writer.open(note_file);
+        for (int k = 0; k < count; k++) {
+            writer.addMelody(catalog.data() + static_cast<size_t>(k) * length,
+                             static_cast<size_t>(length), rhythm_pattern, tempo);
+        }
+        writer.close();
+    }, 3));
+    results.push_back(benchItems("read text (ifstream)", notes, [&]() {
+        ifstream in(text_file);
+        string label;
+        int note;
+        text_sum = 0;
+        while (in >> label >> note) text_sum += note;
+    }, 3));
+    results.push_back(benchItems("read binary (mmap scan)", notes, [&]() {
+        NoteStreamFile file;
+        string error;
+        binary_sum = 0;
+        if (!file.open(note_file, error)) return;
+        for (const NoteRecord& record : file.records()) {
+            binary_sum += record.isNote() ? record.key : 0;
+        }
+    }, 3));
+
+    uintmax_t text_bytes = filesystem::file_size(text_file);
+    uintmax_t note_bytes = filesystem::file_size(note_file);
+    filesystem::remove(text_file);
+    filesystem::remove(note_file);
+
+    cout << "Catalog of " << count << " x " << length << " notes, mood " << mood << "; text "
+         << text_bytes / 1024 << " KiB, binary " << note_bytes / 1024 << " KiB" << endl;
+    printBench(results, "note");
+    bool ok = text_sum == expected && binary_sum == expected;
+    cout << "Read-back " << (ok ? "matches" : "DIFFERS FROM") << " the catalog" << endl;
+    return ok ? 0 : 1;
+}
+
+// ⏱️ Benchmark: offline synthesis of an arrangement, scalar vs. vector kernels
+int runSynthBench(const string& mood, double seconds, int threads) {
+    int tempo = mood_tempo[mood];
+    HarmonicPlan plan = makeHarmonicPlan(mood_scales[mood], tempo, seconds, melodySeed(mood, 1, 99),
+                                         rhythm_pattern.meter());
+    MidiFile midi;
+    arrangePiece(midi, plan, mood_models[mood], rhythm_pattern, tempo, mood_instruments[mood], mood, 1);
+    vector<SynthNote> notes = synthNotesFromMidi(midi);
+    vector<float> scalar, vector1, parallel;
+    long long frames = 0;
+    vector<BenchResult> results;
+
+    results.push_back(benchItems("scalar kernel, 1 thread", 1, [&]() {
+        frames = renderSynth(notes, wav_rate, scalar, 1, false).frames;
+    }, 1));
+    results.push_back(benchItems("vector kernel, 1 thread", 1, [&]() {
+        renderSynth(notes, wav_rate, vector1, 1, true);
+    }, 3));
+    results.push_back(benchItems("vector kernel, all threads", 1, [&]() {
+        renderSynth(notes, wav_rate, parallel, threads, true);
+    }, 3));
+
+    double error = 0.0;
+    for (size_t i = 0; i < scalar.size() && i < vector1.size(); i++) {
+        error = max(error, static_cast<double>(fabs(scalar[i] - vector1[i])));
+    }
+    for (BenchResult& result : results) {
+        result.items_per_second = frames / result.seconds;
+        result.ns_per_item = result.seconds * 1e9 / frames;
+    }
+
+    cout << "Synthesized " << notes.size() << " notes, " << plan.bars << " bars (" << seconds
+         << " s) of " << mood << " at " << wav_rate << " Hz" << endl;
+    printBench(results, "frame");
+    for (const BenchResult& result : results) {
+        cout << result.name << ": " << (static_cast<double>(frames) / wav_rate) / result.seconds
+             << "x real time" << endl;
+    }
+    cout << "Max vector/scalar difference " << error << "; threaded output "
+         << (parallel == vector1 ? "matches" : "DIFFERS FROM") << " single-threaded" << endl;
+    return parallel == vector1 ? 0 : 1;
+}
+
+// Same tracks, ticks, sequence numbers and bytes in both files.
+bool sameMidi(MidiFile& a, MidiFile& b) {
+    if (a.getTrackCount() != b.getTrackCount() || a.getTPQ() != b.getTPQ()) return false;
+    for (int track = 0; track < a.getTrackCount(); track++) {
+        if (a.getEventCount(track) != b.getEventCount(track)) return false;
+        for (int i = 0; i < a.getEventCount(track); i++) {
+            const MidiEvent& x = a[track][i];
+            const MidiEvent& y = b[track][i];
+            if (x.tick != y.tick || x.track != y.track || x.seq != y.seq ||
+                static_cast<const vector<uchar>&>(x) != static_cast<const vector<uchar>&>(y)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// ⏱️ Benchmark: loading an arrangement's SMF through the istream reader
+// vs. parsing it in place
+int runSmfBench(const string& mood, double seconds, int threads) {
+    int tempo = mood_tempo[mood];
+    HarmonicPlan plan = makeHarmonicPlan(mood_scales[mood], tempo, seconds, melodySeed(mood, 1, 99),
+                                         rhythm_pattern.meter());
+    string file = filesystem::temp_directory_path().string() + "/moodplayer-bench.mid";
+    {
+        MidiFile midi;
+        arrangePiece(midi, plan, mood_models[mood], rhythm_pattern, tempo, mood_instruments[mood], mood, 1);
+        midi.write(file);
+    }
+    SmfData bytes;
+    bytes.open(file);
+    MidiFile streamed, mapped, memory, parallel;
+    parallel.setReadThreads(threads);
+    vector<BenchResult> results;
+
+    results.push_back(benchItems("istream (readSmf)", 1, [&]() {
+        ifstream in(file, ios::binary);
+        streamed.readSmf(in);
+    }, 3));
+    results.push_back(benchItems("mapped file (readSmf)", 1, [&]() {
+        mapped.readSmf(file);
+    }, 3));
+    results.push_back(benchItems("in memory (readSmf)", 1, [&]() {
+        memory.readSmf(bytes.data(), bytes.size());
+    }, 3));
+    results.push_back(benchItems("in memory, tracks threaded", 1, [&]() {
+        parallel.readSmf(bytes.data(), bytes.size());
+    }, 3));
+    long long pulled = 0;
+    results.push_back(benchItems("event reader (no MidiEvent)", 1, [&]() {
+        SmfEventReader reader(bytes.data(), bytes.size());
+        long long keys = 0;
+        pulled = 0;
+        for (const SmfEvent& event : reader) {
+            keys += event.isNoteOn() ? event.getP1() : 0;
+            pulled++;
+        }
+        benchSink(keys);
+    }, 3));
+    bool valid = false;
+    results.push_back(benchItems("validate only (no events)", 1, [&]() {
+        valid = MidiFile::validateSmf(bytes.data(), bytes.size(), nullptr, true);
+    }, 3));
+    bool views_match = true;
+    {
+        SmfEventReader reader(bytes.data(), bytes.size());
+        vector<int> index(streamed.getTrackCount(), 0);
+        for (const SmfEvent& event : reader) {
+            const MidiEvent& stored = streamed[event.track][index[event.track]++];
+            views_match = views_match && stored.tick == event.tick && stored[0] == event.command &&
+                          stored.size() == event.size + 1 &&
+                          equal(event.data, event.data + event.size, stored.begin() + 1);
+        }
+        views_match = views_match && reader.status();
+    }
+    MidiFile lazy;
+    lazy.setLazyLoad();
+    BenchResult tempo_only = benchItems("lazy, tempo track only", 1, [&]() {
+        lazy.readSmf(file);
+        benchSink(lazy.getEventCount(0));
+    }, 3);
+
+    long long events = 0;
+    for (int track = 0; track < streamed.getTrackCount(); track++) {
+        events += streamed.getEventCount(track);
+    }
+    for (BenchResult& result : results) {
+        result.items_per_second = events / result.seconds;
+        result.ns_per_item = result.seconds * 1e9 / events;
+    }
+    size_t size = bytes.size();
+    bytes.close();
+    lazy.loadTracks();  // releases the mapping before the file is removed
+    filesystem::remove(file);
+
+    cout << "Read " << events << " events in " << streamed.getTrackCount() << " tracks ("
+         << size / 1024 << " KiB) of " << mood << endl;
+    printBench(results, "event");
+    printf("%-28s %11.3f ms\n", tempo_only.name.c_str(), tempo_only.seconds * 1e3);
+    bool ok = streamed.status() && sameMidi(streamed, mapped) && sameMidi(streamed, memory) &&
+              sameMidi(streamed, parallel) && sameMidi(streamed, lazy) && views_match && valid &&
+              pulled == events;
+    cout << "In-place events " << (ok ? "match" : "DIFFER FROM") << " the istream reader" << endl;
+    return ok ? 0 : 1;
+}
+
+// ⏱️ Benchmark: playback timing through a headless MIDI sink
+void receiveLoopback(double, vector<unsigned char>*, void* recorder) {
+    static_cast<JitterRecorder*>(recorder)->markReceived();
+}
+
+int runJitterBench(const string& mood, long long length, bool loopback) {
+    MelodyStream stream(mood_models[mood], rhythm_pattern, melodySeed(mood, 1, 0), length);
+    auto next = [&](NoteEvent& event) { return stream.next(event); };
+    JitterRecorder recorder;
+    vector<DispatchRecord> trace;
+    cout << "Playing " << length << " notes of " << mood << " (spin " << playback_spin_us
+         << " us)" << endl;
+
+    if (loopback) {
+        try {
+            const string name = "moodplayer jitter";
+            RtMidiOut midiOut;
+            midiOut.openVirtualPort(name);
+            RtMidiIn midiIn;
+            int port = -1;
+            for (unsigned int i = 0; i < midiIn.getPortCount(); i++) {
+                if (midiIn.getPortName(i).find(name) != string::npos) port = static_cast<int>(i);
+            }
+            if (port < 0) {
+                cout << "Virtual port is not visible to RtMidiIn" << endl;
+                return 1;
+            }
+            midiIn.setCallback(&receiveLoopback, &recorder);
+            midiIn.openPort(port);
+            runPlayback(next, [&](const unsigned char* bytes, size_t size) {
+                recorder.markSent();
+                midiOut.sendMessage(bytes, size);
+            }, mood_tempo[mood], &trace);
+            recorder.waitForAll(chrono::milliseconds(1000));
+            midiIn.closePort();
+        } catch (RtMidiError& error) {
+            cout << "MIDI loopback unavailable: " << error.getMessage() << endl;
+            return 1;
+        }
+        printJitterReport("virtual port loopback", makeJitterReport(trace, recorder));
+    } else {
+        {
+            RecordingSink sink(recorder);
+            runPlayback(next, [&](const unsigned char* bytes, size_t size) {
+                sink.send(bytes, size);
+            }, mood_tempo[mood], &trace);
+            recorder.waitForAll(chrono::milliseconds(1000));
+        }
+        printJitterReport("recording sink", makeJitterReport(trace, recorder));
+    }
+    return 0;
+}
+
+// ⏱️ Benchmark: request latency through an in-process daemon
+// `seeds` distinct seeds are cycled through, so with the cache on most
+// requests repeat an earlier one.
+int runDaemonBench(const string& mood, const string& path, int length, int workers, int seeds) {
+    const int clients = 8;
+    const int requests = 2000;
+    MoodDaemon<decltype(&serveRequest)> daemon(&serveRequest, workers);
+    string error;
+    if (!daemon.listen(path, error)) {
+        cout << "Cannot listen on " << path << ": " << error << endl;
+        return 1;
+    }
+    thread server([&]() { daemon.run(); });
+
+    vector<vector<double>> latencies(clients);
+    vector<thread> pool;
+    auto start = chrono::steady_clock::now();
+    for (int c = 0; c < clients; c++) {
+        pool.emplace_back([&, c]() {
+            DaemonClient client;
+            if (!client.connect(path)) return;
+            vector<uint8_t> payload;
+            string failure;
+            for (int r = 0; r < requests; r++) {
+                string line = mood + " " + to_string(length) + " " + to_string((c * requests + r) % seeds) + " smf";
+                auto sent = chrono::steady_clock::now();
+                if (!client.request(line, payload, failure)) return;
+                latencies[c].push_back(
+                    chrono::duration<double, micro>(chrono::steady_clock::now() - sent).count());
+            }
+        });
+    }
+    for (auto& client : pool) {
+        client.join();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    daemon.stop();
+    server.join();
+
+    vector<double> all;
+    for (const auto& list : latencies) {
+        all.insert(all.end(), list.begin(), list.end());
+    }
+    if (all.empty()) {
+        cout << "No requests completed" << endl;
+        return 1;
+    }
+    sort(all.begin(), all.end());
+    cout << clients << " clients x " << requests << " requests (" << mood << ", " << length
+         << " notes, smf) on " << daemon.workers() << " workers" << endl;
+    cout << "Latency p50 " << all[(all.size() - 1) / 2] << " us, p99 "
+         << all[static_cast<size_t>((all.size() - 1) * 0.99)] << " us, max " << all.back()
+         << " us; " << static_cast<long long>(all.size() / seconds) << " requests/s, "
+         << static_cast<double>(daemon.stats().requests) / max(1LL, daemon.stats().batches.load())
+         << " requests per batch" << endl;
+    printCacheStats();
+    return 0;
 }
 
 // 🎤 Main Function
-int main() {
-    srand(time(0));
-    string mood;
-    cout << "Enter mood (joyful, melancholy, powerful, calm, tense, dreamy): ";
-    cin >> mood;
+int main(int argc, char** argv) {
+    Options options;
+    options.define("b|batch=i:0", "generate this many melodies and exit");
+    options.define("m|mood=s", "mood for batch and benchmark modes");
+    options.define("s|seed=i:1", "catalog seed for batch mode");
+    options.define("l|length=i:16", "notes per melody in batch mode");
+    options.define("t|threads=i:0", "worker threads for batch and training (0 = all cores)");
+    options.define("o|output=s", "catalog file written by batch mode");
+    options.define("midi-dir=s", "batch mode also writes each melody as a .mid file here");
+    options.define("simd=b", "batch mode samples many melodies in lock-step with AVX2/AVX-512");
+    options.define("bench=s", "run a benchmark (model, kernels, simd, counter, beam, synth, notes, smf, jitter, daemon) and exit");
+    options.define("loopback=b", "jitter benchmark through a virtual port into RtMidiIn");
+    options.define("validate=b", "check the structure of the MIDI files named as arguments and exit");
+    options.define("strict=b", "--validate also requires each track to fill its MTrk chunk exactly");
+    options.define("train=s", "train the mood's n-gram model from a directory of MIDI files");
+    options.define("order=i:3", "n-gram order used by --train (0-7)");
+    options.define("min-count=i:1", "drop trained contexts seen fewer times than this");
+    options.define("arrange=d:0", "write a multi-part arrangement of this many seconds and exit");
+    options.define("stream=b", "play generated notes endlessly (or --length notes)");
+    options.define("morph=s", "stream --mood, morphing into this mood over --bars bars");
+    options.define("bars=i:8", "bars a --morph takes");
+    options.define("swing=i:50", "swing: off-beat eighths start this far into the beat (50-75 %)");
+    options.define("meter=s:4/4", "meter for bar lines, arrangements and morphs");
+    options.define("beam=i:0", "pick the melody by beam search with this many beams (first-order table only)");
+    options.define("wav=s", "render to this WAV file with the built-in synthesizer instead of playing");
+    options.define("bits=i:16", "WAV sample size for --wav (16 or 24)");
+    options.define("rate=i:44100", "WAV sample rate for --wav");
+    options.define("spin=i:500", "microseconds to busy-wait before each playback deadline");
+    options.define("model=s", "map mood models from a binary model file");
+    options.define("save-model=s", "write all mood models to a binary model file and exit");
+    options.define("daemon=s", "serve generation requests on this Unix domain socket");
+    options.define("cache-mb=i:64", "daemon output cache size in MiB (0 = off)");
+    options.define("cache-dir=s", "also keep daemon output cached on disk in this directory");
+    options.define("cache-disk-mb=i:1024", "disk cache size in MiB; the oldest files are deleted first");
+    options.process(argc, argv);
+
+    if (options.getBoolean("validate")) {
+        vector<string> files;
+        for (int i = 1; i <= options.getArgCount(); i++) {
+            files.push_back(options.getArg(i));
+        }
+        return runValidate(files, options.getBoolean("strict"));
+    }
+
+    Meter meter;
+    if (!parseMeter(options.getString("meter"), meter)) {
+        cout << "Invalid meter: " << options.getString("meter") << endl;
+        return 1;
+    }
+    rhythm_pattern.setMeter(meter);
+    rhythm_pattern.setSwing(options.getInt("swing"));
+
+    compiled_moods = compileMoods(mood_scales, mood_transitions);
+    for (const auto& model : compiled_moods) {
+        mood_models[model.first] = model.second.view();
+    }
+    if (options.getBoolean("model") && !loadModelFile(options.getString("model"))) {
+        return 1;
+    }
+
+    wav_rate = max(8000, options.getInt("rate"));
+    wav_bits = options.getInt("bits") == 24 ? 24 : 16;
+
+    if (options.getBoolean("bench")) {
+        string bench_mood = options.getString("mood");
+        if (bench_mood.empty()) bench_mood = "joyful";
+        if (mood_scales.find(bench_mood) == mood_scales.end()) {
+            cout << "Invalid mood! Choose from: joyful, melancholy, powerful, calm, tense, dreamy." << endl;
+            return 1;
+        }
+        string bench = options.getString("bench");
+        if (bench == "model") return runModelBench(bench_mood);
+        if (bench == "kernels") return runKernelBench(bench_mood);
+        if (bench == "simd") return runSimdBench(bench_mood);
+        if (bench == "beam") {
+            return runBeamBench(bench_mood, options.getBoolean("length") ? max(1, options.getInt("length")) : 32,
+                                options.getInt("threads"));
+        }
+        if (bench == "notes") {
+            return runNotesBench(bench_mood, options.getInt("batch") > 0 ? options.getInt("batch") : 1000000,
+                                 max(1, options.getInt("length")));
+        }
+        if (bench == "synth") {
+            double seconds = options.getDouble("arrange") > 0 ? options.getDouble("arrange") : 120.0;
+            return runSynthBench(bench_mood, seconds, options.getInt("threads"));
+        }
+        if (bench == "smf") {
+            double seconds = options.getDouble("arrange") > 0 ? options.getDouble("arrange") : 7200.0;
+            return runSmfBench(bench_mood, seconds, options.getInt("threads"));
+        }
+        if (bench == "counter") {
+            long long length = options.getBoolean("length") ? max(2, options.getInt("length")) : 1 << 24;
+            return runCounterBench(bench_mood, length, options.getInt("threads"));
+        }
+        if (bench == "daemon") {
+            string path = options.getBoolean("daemon") ? options.getString("daemon")
+                                                       : "/tmp/moodplayer-bench.sock";
+            configureCache(options.getInt("cache-mb"), options.getString("cache-dir"),
+                           options.getInt("cache-disk-mb"));
+            return runDaemonBench(bench_mood, path, max(1, options.getInt("length")),
+                                  options.getInt("threads"),
+                                  options.getBoolean("seed") ? max(1, options.getInt("seed")) : 1 << 30);
+        }
+        if (bench == "jitter") {
+            playback_spin_us = max(0, options.getInt("spin"));
+            return runJitterBench(bench_mood, max(1, options.getInt("length")),
+                                  options.getBoolean("loopback"));
+        }
+        cout << "Unknown benchmark: " << bench << endl;
+        return 1;
+    }
+
+    if (options.getBoolean("daemon")) {
+        configureCache(options.getInt("cache-mb"), options.getString("cache-dir"),
+                       options.getInt("cache-disk-mb"));
+        return runDaemon(options.getString("daemon"), options.getInt("threads"));
+    }
+
+    playback_spin_us = max(0, options.getInt("spin"));
+
+    string mood = options.getString("mood");
+    if (mood.empty()) {
+        cout << "Enter mood (joyful, melancholy, powerful, calm, tense, dreamy): ";
+        cin >> mood;
+    }
 
     if (mood_scales.find(mood) == mood_scales.end()) {
         cout << "Invalid mood! Choose from: joyful, melancholy, powerful, calm, tense, dreamy." << endl;
         return 1;
     }
 
-    vector<int> melody = generateMelody(mood, 16);
-    playMelody(melody, mood);
-    exportToMidiText(melody, "output_melody.txt");
+    if (options.getBoolean("train") &&
+        !trainMood(mood, options.getString("train"), options.getInt("order"),
+                   options.getInt("min-count"), options.getInt("threads"))) {
+        return 1;
+    }
+
+    if (options.getBoolean("save-model")) {
+        if (!saveModelFile(options.getString("save-model"))) return 1;
+        if (options.getInt("batch") <= 0) return 0;
+    }
+
+    if (options.getInt("batch") > 0) {
+        return runBatch(mood, static_cast<uint64_t>(options.getInt("seed")),
+                        options.getInt("batch"), max(1, options.getInt("length")),
+                        options.getInt("threads"), options.getString("output"),
+                        options.getString("midi-dir"), options.getBoolean("simd"));
+    }
+
+    if (options.getDouble("arrange") > 0) {
+        string filename = options.getString("output");
+        return runArrangement(mood, options.getDouble("arrange"),
+                              static_cast<uint64_t>(options.getInt("seed")),
+                              filename.empty() ? "arrangement.mid" : filename,
+                              options.getString("wav"));
+    }
+
+    if (options.getBoolean("morph")) {
+        string target = options.getString("morph");
+        if (!mood_models.count(target)) {
+            cout << "Invalid morph target: " << target << endl;
+            return 1;
+        }
+        if (ngram_models.count(mood) || ngram_models.count(target)) {
+            cout << "--morph blends the first-order tables; it cannot be used with an n-gram model"
+                 << " (--train or --model)" << endl;
+            return 1;
+        }
+        uint64_t seed = options.getBoolean("seed") ? static_cast<uint64_t>(options.getInt("seed"))
+                                                   : static_cast<uint64_t>(time(0));
+        long long length = options.getBoolean("length") ? options.getInt("length") : -1;
+        playMorph(mood, target, max(0, options.getInt("bars")), seed, length);
+        return 0;
+    }
+
+    if (options.getBoolean("stream")) {
+        uint64_t seed = options.getBoolean("seed") ? static_cast<uint64_t>(options.getInt("seed"))
+                                                   : static_cast<uint64_t>(time(0));
+        long long length = options.getBoolean("length") ? options.getInt("length") : -1;
+        if (ngram_models.count(mood)) {
+            MelodyStream stream(ngram_models[mood], rhythm_pattern, melodySeed(mood, seed, 0), length);
+            playStream(stream, mood);
+        } else {
+            MelodyStream stream(mood_models[mood], rhythm_pattern, melodySeed(mood, seed, 0), length);
+            playStream(stream, mood);
+        }
+        return 0;
+    }
+
+    if (options.getInt("beam") > 0 && ngram_models.count(mood)) {
+        cout << "--beam searches the first-order table; it cannot be used with an n-gram model"
+             << " (--train or --model)" << endl;
+        return 1;
+    }
+
+    // Every draw is a function of (seed, note), so --seed replays a melody exactly.
+    uint64_t seed = options.getBoolean("seed") ? static_cast<uint64_t>(options.getInt("seed"))
+                                               : static_cast<uint64_t>(time(0));
+    int length = max(1, options.getInt("length"));
+    vector<int> melody(static_cast<size_t>(length));
+    CounterRng rng(melodySeed(mood, seed, 0), 0);
+    if (options.getInt("beam") > 0) {
+        ShapeScorer scorer;
+        scorer.tonic = mood_scales[mood][0];
+        StepPool pool(options.getInt("threads"));
+        BeamStats stats = beamSearch(mood_models[mood], scorer, length, options.getInt("beam"),
+                                     melodySeed(mood, seed, 0), melody.data(), pool);
+        cout << "Beam search kept " << options.getInt("beam") << " melodies, best score "
+             << stats.best_score << endl;
+    } else if (ngram_models.count(mood)) {
+        ngram_models[mood].generate(melody.data(), length, rng);
+    } else {
+        mood_models[mood].generate(melody.data(), length, rng);
+    }
+    cout << "Seed " << seed << " (replay with --seed " << seed << ")" << endl;
+    if (options.getBoolean("wav")) {
+        if (!renderWav(melodySynthNotes(melody, mood), options.getString("wav"))) return 1;
+    } else {
+        playMelody(melody, mood);
+    }
+    exportNoteStream(melody, "output_melody.notes", mood);
     saveAsMIDI(melody, "output.mid", mood);
 
     return 0;
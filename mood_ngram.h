@@ -0,0 +1,316 @@
+// 📚 Variable-Order Markov Models
+//
+// Trains weighted n-gram models (orders 0..MAX_ORDER) from Standard MIDI
+// Files and compiles them into a compact open-addressing context index.
+// A context is the packed history of up to `order` previous notes; every
+// context owns an alias row over its observed successors, so sampling is
+// one hash probe per tried order plus one RNG draw.  Unseen contexts back
+// off to shorter ones, ending at the order-0 note distribution.
+
+#ifndef MOOD_NGRAM_H
+#define MOOD_NGRAM_H
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "midifile/include/MidiFile.h"
+#include "mood_model.h"
+
+// Packed context: 7 bits per note (newest lowest), order in the top bits.
+inline uint64_t ngramContext(const int* history, int order) {
+    uint64_t key = static_cast<uint64_t>(order) << 49;
+    for (int i = 1; i <= order; i++) {
+        key |= static_cast<uint64_t>(history[-i] & 0x7F) << (7 * (i - 1));
+    }
+    return key;
+}
+
+inline uint64_t ngramHash(uint64_t key) {
+    key = (key ^ (key >> 31)) * 0x7FB5D329728EA185ULL;
+    key = (key ^ (key >> 27)) * 0x81DADEF4BC2DD44DULL;
+    return key ^ (key >> 33);
+}
+
+// 🧾 Training counts, keyed by (context << 7 | next note).
+struct NgramCounts {
+    static constexpr int MAX_ORDER = 7;
+
+    int order = 1;
+    std::unordered_map<uint64_t, uint32_t> counts;
+    long long files = 0;
+    long long sequences = 0;
+    long long notes = 0;
+    long long events = 0;  // MIDI events parsed, notes or not
+
+    explicit NgramCounts(int model_order = 1)
+        : order(std::max(0, std::min(model_order, MAX_ORDER))) {}
+
+    void addSequence(const std::vector<int>& sequence) {
+        const int* data = sequence.data();
+        for (size_t i = 0; i < sequence.size(); i++) {
+            int max_order = std::min(order, static_cast<int>(i));
+            for (int o = 0; o <= max_order; o++) {
+                counts[(ngramContext(data + i, o) << 7) | (data[i] & 0x7F)]++;
+            }
+        }
+        sequences++;
+        notes += static_cast<long long>(sequence.size());
+    }
+
+    void merge(const NgramCounts& other) {
+        for (const auto& entry : other.counts) {
+            counts[entry.first] += entry.second;
+        }
+        files += other.files;
+        sequences += other.sequences;
+        notes += other.notes;
+        events += other.events;
+    }
+};
+
+// 🎼 One melodic line per track: note-ons that are later released, in
+// onset order, keeping the highest key of simultaneous onsets.  Releases
+// are paired first-in first-out per channel and key, as
+// MidiFile::linkNotePairs() pairs them.  Percussion (channel 10) is
+// skipped.  Events are streamed straight from the SMF bytes without
+// building a MidiFile; `events` counts every event read.  Returns false
+// for data readSmf() would reject.
+inline bool extractNoteSequences(const uint8_t* data, size_t size,
+                                 std::vector<std::vector<int>>& sequences, long long& events) {
+    struct Onset {
+        int tick;
+        int key;
+        int next;             // next pending onset of the same channel and key
+        bool released;
+    };
+    std::vector<Onset> onsets;
+    int head[16][128], tail[16][128];
+    smf::SmfEventReader reader(data, size);
+    int track = -1;
+
+    auto finishTrack = [&]() {
+        std::vector<int> line;
+        int last_tick = -1;
+        for (const Onset& onset : onsets) {
+            if (!onset.released) continue;
+            if (onset.tick == last_tick && !line.empty()) {
+                line.back() = std::max(line.back(), onset.key);
+            } else {
+                line.push_back(onset.key);
+                last_tick = onset.tick;
+            }
+        }
+        if (line.size() > 1) {
+            sequences.push_back(std::move(line));
+        }
+    };
+
+    for (const smf::SmfEvent& event : reader) {
+        if (event.track != track) {
+            if (track >= 0) finishTrack();
+            track = event.track;
+            onsets.clear();
+            std::fill(&head[0][0], &head[0][0] + 16 * 128, -1);
+        }
+        events++;
+        int channel = event.getChannel();
+        if (channel == 9) continue;
+        if (event.isNoteOn()) {
+            int key = event.getP1();
+            int index = static_cast<int>(onsets.size());
+            onsets.push_back({event.tick, key, -1, false});
+            if (head[channel][key] < 0) {
+                head[channel][key] = index;
+            } else {
+                onsets[tail[channel][key]].next = index;
+            }
+            tail[channel][key] = index;
+        } else if (event.isNoteOff()) {
+            int key = event.getP1();
+            int first = head[channel][key];
+            if (first >= 0) {
+                onsets[first].released = true;
+                head[channel][key] = onsets[first].next;
+            }
+        }
+    }
+    if (track >= 0) finishTrack();
+    return reader.status();
+}
+
+inline bool addMidiFile(NgramCounts& counts, const std::string& filename) {
+    smf::SmfData data;
+    std::vector<std::vector<int>> sequences;
+    long long events = 0;
+    if (!data.open(filename) || !extractNoteSequences(data.data(), data.size(), sequences, events)) {
+        return false;
+    }
+    counts.events += events;
+    for (const auto& line : sequences) {
+        counts.addSequence(line);
+    }
+    counts.files++;
+    return true;
+}
+
+// All .mid/.midi files below `directory`, sorted so training is repeatable.
+inline std::vector<std::string> listMidiFiles(const std::string& directory) {
+    std::vector<std::string> files;
+    std::error_code error;
+    for (std::filesystem::recursive_directory_iterator it(directory, error), end;
+         !error && it != end; it.increment(error)) {
+        if (!it->is_regular_file()) continue;
+        std::string ext = it->path().extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        if (ext == ".mid" || ext == ".midi") {
+            files.push_back(it->path().string());
+        }
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+// 🧠 Compiled variable-order model.
+struct NgramSlot {
+    static constexpr uint64_t EMPTY = ~0ULL;
+
+    uint64_t key;     // packed context, EMPTY when unused
+    uint32_t offset;  // first alias cell
+    uint32_t count;   // successors of the context
+};
+
+// Read-only view of a compiled n-gram model; points into an NgramModel
+// or straight into a memory-mapped model file.
+struct NgramView {
+    int order = 0;
+    uint64_t mask = 0;               // slot count - 1 (a power of two)
+    const NgramSlot* slots = nullptr;
+    const AliasCell* cells = nullptr;
+    uint64_t cell_count = 0;
+
+    uint64_t slotCount() const { return slots ? mask + 1 : 0; }
+
+    const NgramSlot* find(uint64_t context) const {
+        if (!slots) return nullptr;
+        for (size_t pos = ngramHash(context) & mask;; pos = (pos + 1) & mask) {
+            const NgramSlot& slot = slots[pos];
+            if (slot.key == context) return &slot;
+            if (slot.key == NgramSlot::EMPTY) return nullptr;
+        }
+    }
+
+    // Next note after `history[-filled..-1]`, backing off to shorter contexts.
+    int sample(const int* history, int filled, uint64_t draw) const {
+        for (int o = std::min(order, filled); o >= 0; o--) {
+            const NgramSlot* slot = find(ngramContext(history, o));
+            if (slot) {
+                return sampleAliasRow(cells + slot->offset, slot->count, draw);
+            }
+        }
+        return 60;
+    }
+
+    template <class Rng>
+    void generate(int* out, int length, Rng& rng) const {
+        for (int i = 0; i < length; i++) {
+            out[i] = sample(out + i, i, rng.next());
+        }
+    }
+};
+
+struct NgramModel {
+    using Slot = NgramSlot;
+    static constexpr uint64_t EMPTY = NgramSlot::EMPTY;
+
+    int order = 0;
+    uint64_t mask = 0;
+    std::vector<Slot> slots;
+    std::vector<AliasCell> cells;
+
+    // Contexts of order >= 1 seen fewer than `min_count` times are
+    // dropped to bound memory; order 0 is always kept.
+    void build(const NgramCounts& trained, uint32_t min_count = 1) {
+        order = trained.order;
+
+        std::vector<std::pair<uint64_t, uint32_t>> entries(trained.counts.begin(),
+                                                            trained.counts.end());
+        std::sort(entries.begin(), entries.end());
+
+        struct Group { uint64_t context; size_t begin, end; };
+        std::vector<Group> groups;
+        for (size_t i = 0; i < entries.size();) {
+            uint64_t context = entries[i].first >> 7;
+            size_t j = i;
+            uint64_t total = 0;
+            while (j < entries.size() && (entries[j].first >> 7) == context) {
+                total += entries[j].second;
+                j++;
+            }
+            if ((context >> 49) == 0 || total >= min_count) {
+                groups.push_back({context, i, j});
+            }
+            i = j;
+        }
+
+        size_t capacity = 16;
+        while (capacity < groups.size() * 2) capacity <<= 1;
+        mask = capacity - 1;
+        slots.assign(capacity, Slot{EMPTY, 0, 0});
+        cells.clear();
+
+        std::vector<int> notes;
+        std::vector<double> weights;
+        for (const Group& group : groups) {
+            notes.clear();
+            weights.clear();
+            for (size_t i = group.begin; i < group.end; i++) {
+                notes.push_back(static_cast<int>(entries[i].first & 0x7F));
+                weights.push_back(entries[i].second);
+            }
+            size_t pos = ngramHash(group.context) & mask;
+            while (slots[pos].key != EMPTY) pos = (pos + 1) & mask;
+            slots[pos].key = group.context;
+            slots[pos].offset = static_cast<uint32_t>(cells.size());
+            slots[pos].count = static_cast<uint32_t>(notes.size());
+            appendAliasRow(cells, notes.data(), weights.data(), static_cast<int>(notes.size()));
+        }
+    }
+
+    bool empty() const { return cells.empty(); }
+
+    NgramView view() const {
+        NgramView v;
+        v.order = order;
+        v.mask = mask;
+        v.slots = slots.empty() ? nullptr : slots.data();
+        v.cells = cells.data();
+        v.cell_count = cells.size();
+        return v;
+    }
+
+    int sample(const int* history, int filled, uint64_t draw) const {
+        return view().sample(history, filled, draw);
+    }
+
+    template <class Rng>
+    void generate(int* out, int length, Rng& rng) const {
+        view().generate(out, length, rng);
+    }
+
+    size_t contextCount() const {
+        size_t used = 0;
+        for (const Slot& slot : slots) used += slot.key != EMPTY;
+        return used;
+    }
+
+    size_t memoryBytes() const {
+        return slots.size() * sizeof(Slot) + cells.size() * sizeof(AliasCell);
+    }
+};
+
+#endif // MOOD_NGRAM_H
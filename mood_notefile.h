@@ -0,0 +1,248 @@
+// 🗒️ Binary Note-Stream Files
+//
+// A compact, little-endian stream of fixed 6-byte note records (delta
+// time, duration, key, velocity) for any number of melodies, followed by
+// an index of where each melody starts.  The writer streams records
+// through a small buffer, so a catalog of any size is written in constant
+// memory apart from the index; the reader maps the file and hands out
+// record spans in place, so a scan over millions of melodies runs at
+// memory bandwidth with no parsing.
+//
+// Layout:
+//   NoteFileHeader
+//   NoteRecord  records[record_count]
+//   uint64_t    melody_start[melody_count + 1]  (record indices, 8-byte aligned)
+//
+// Times are in units of time_unit_us microseconds (1000: milliseconds).
+// A delta too large for 16 bits is carried by spacer records with
+// velocity 0, which are not notes.
+
+#ifndef MOOD_NOTEFILE_H
+#define MOOD_NOTEFILE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "mood_modelfile.h"
+#include "mood_rhythm.h"
+
+static const char MOOD_NOTES_MAGIC[8] = {'M', 'O', 'O', 'D', 'N', 'T', 'S', '\0'};
+static const uint32_t MOOD_NOTES_VERSION = 1;
+
+struct NoteFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;     // sizeof(NoteFileHeader), for sanity checks
+    uint64_t file_size;
+    uint64_t record_count;
+    uint64_t melody_count;
+    uint64_t index_offset;
+    uint32_t time_unit_us;
+    uint32_t reserved;
+};
+
+struct NoteRecord {
+    uint16_t delta;           // since the previous record's onset
+    uint16_t duration;
+    uint8_t key;
+    uint8_t velocity;         // 0: spacer, not a note
+
+    bool isNote() const { return velocity != 0; }
+};
+
+static_assert(sizeof(NoteRecord) == 6, "note records are packed to 6 bytes");
+
+// ✍️ Streaming writer.  Call beginMelody() before each melody's notes;
+// nothing is valid on disk until close() returns true.
+class NoteStreamWriter {
+public:
+    NoteStreamWriter() = default;
+    NoteStreamWriter(const NoteStreamWriter&) = delete;
+    NoteStreamWriter& operator=(const NoteStreamWriter&) = delete;
+    ~NoteStreamWriter() { close(); }
+
+    bool open(const std::string& filename, uint32_t time_unit_us = 1000) {
+        close();
+        m_file = std::fopen(filename.c_str(), "wb");
+        if (!m_file) return false;
+        std::memset(&m_header, 0, sizeof(m_header));
+        std::memcpy(m_header.magic, MOOD_NOTES_MAGIC, sizeof(MOOD_NOTES_MAGIC));
+        m_header.version = MOOD_NOTES_VERSION;
+        m_header.header_size = sizeof(NoteFileHeader);
+        m_header.time_unit_us = time_unit_us;
+        m_starts.clear();
+        m_buffer.clear();
+        m_buffer.reserve(BUFFER_RECORDS);
+        m_ok = std::fwrite(&m_header, sizeof(m_header), 1, m_file) == 1;
+        return m_ok;
+    }
+
+    void beginMelody() { m_starts.push_back(m_header.record_count); }
+
+    void add(uint32_t delta, int key, int velocity, uint32_t duration) {
+        while (delta > 0xFFFF) {
+            push({0xFFFF, 0, 0, 0});
+            delta -= 0xFFFF;
+        }
+        push({static_cast<uint16_t>(delta), static_cast<uint16_t>(std::min<uint32_t>(duration, 0xFFFF)),
+              static_cast<uint8_t>(key & 0x7F), static_cast<uint8_t>(std::max(1, std::min(velocity, 127)))});
+    }
+
+    // Notes of `melody` timed by `rhythm` at `tempo`, in the file's time
+    // unit, rounded from absolute times so deltas never drift.
+    void addMelody(const int* melody, size_t length, const RhythmPattern& rhythm, const TempoMap& tempo,
+                   int velocity = 100) {
+        beginMelody();
+        RhythmClock clock(rhythm);
+        long long unit = std::max<uint32_t>(1, m_header.time_unit_us);
+        long long previous = 0;
+        for (size_t i = 0; i < length; i++) {
+            NoteTiming timing = clock.next();
+            long long on = (tempo.micros(timing.on) + unit / 2) / unit;
+            long long off = (tempo.micros(timing.off) + unit / 2) / unit;
+            add(static_cast<uint32_t>(on - previous), melody[i], velocity,
+                static_cast<uint32_t>(off - on));
+            previous = on;
+        }
+    }
+
+    // Flush, append the melody index and fill in the header.
+    bool close() {
+        if (!m_file) return m_ok;
+        flush();
+        m_starts.push_back(m_header.record_count);
+        uint64_t end = sizeof(NoteFileHeader) + m_header.record_count * sizeof(NoteRecord);
+        static const uint8_t padding[8] = {};
+        size_t pad = static_cast<size_t>((8 - end % 8) % 8);
+        if (m_ok && pad > 0) m_ok = std::fwrite(padding, 1, pad, m_file) == pad;
+        m_header.melody_count = m_starts.size() - 1;
+        m_header.index_offset = end + pad;
+        if (m_ok) {
+            m_ok = std::fwrite(m_starts.data(), sizeof(uint64_t), m_starts.size(), m_file) == m_starts.size();
+        }
+        m_header.file_size = m_header.index_offset + m_starts.size() * sizeof(uint64_t);
+        if (m_ok) {
+            m_ok = std::fseek(m_file, 0, SEEK_SET) == 0 &&
+                   std::fwrite(&m_header, sizeof(m_header), 1, m_file) == 1;
+        }
+        m_ok = std::fclose(m_file) == 0 && m_ok;
+        m_file = nullptr;
+        return m_ok;
+    }
+
+    uint64_t records() const { return m_header.record_count; }
+
+private:
+    static constexpr size_t BUFFER_RECORDS = 1 << 14;
+
+    void push(const NoteRecord& record) {
+        m_buffer.push_back(record);
+        m_header.record_count++;
+        if (m_buffer.size() == BUFFER_RECORDS) flush();
+    }
+
+    void flush() {
+        if (m_ok && !m_buffer.empty()) {
+            m_ok = std::fwrite(m_buffer.data(), sizeof(NoteRecord), m_buffer.size(), m_file) == m_buffer.size();
+        }
+        m_buffer.clear();
+    }
+
+    FILE* m_file = nullptr;
+    bool m_ok = false;
+    NoteFileHeader m_header = {};
+    std::vector<NoteRecord> m_buffer;
+    std::vector<uint64_t> m_starts;
+};
+
+struct NoteSpan {
+    const NoteRecord* first = nullptr;
+    const NoteRecord* last = nullptr;
+
+    const NoteRecord* begin() const { return first; }
+    const NoteRecord* end() const { return last; }
+    size_t size() const { return static_cast<size_t>(last - first); }
+};
+
+// 📖 A mapped note-stream file.  Spans stay valid while it is open.
+class NoteStreamFile {
+public:
+    // Map `filename` and check its header and index.  Returns false with
+    // a reason in `error` for missing, foreign or truncated files.
+    bool open(const std::string& filename, std::string& error) {
+        m_header = nullptr;
+        if (!m_map.open(filename)) {
+            error = "cannot map " + filename;
+            return false;
+        }
+        uint64_t size = m_map.size();
+        if (size < sizeof(NoteFileHeader)) {
+            return fail("file too small for a note-stream header", error);
+        }
+        const NoteFileHeader* header = reinterpret_cast<const NoteFileHeader*>(m_map.data());
+        if (std::memcmp(header->magic, MOOD_NOTES_MAGIC, sizeof(MOOD_NOTES_MAGIC)) != 0) {
+            return fail("not a note-stream file", error);
+        }
+        if (header->version != MOOD_NOTES_VERSION || header->header_size != sizeof(NoteFileHeader)) {
+            return fail("unsupported note-stream version " + std::to_string(header->version), error);
+        }
+        if (header->file_size != size) {
+            return fail("note-stream file is truncated", error);
+        }
+        uint64_t records_end = sizeof(NoteFileHeader) + header->record_count * sizeof(NoteRecord);
+        // The index runs from index_offset exactly to the end of the file.
+        if (header->record_count > size / sizeof(NoteRecord) || records_end > header->index_offset ||
+            header->index_offset > size || header->index_offset % 8 != 0 ||
+            header->melody_count >= size / sizeof(uint64_t) ||
+            size - header->index_offset != (header->melody_count + 1) * sizeof(uint64_t)) {
+            return fail("note-stream sections out of range", error);
+        }
+        const uint64_t* starts = reinterpret_cast<const uint64_t*>(m_map.data() + header->index_offset);
+        for (uint64_t m = 0; m < header->melody_count; m++) {
+            if (starts[m] > starts[m + 1]) return fail("note-stream index is not sorted", error);
+        }
+        if (starts[header->melody_count] != header->record_count) {
+            return fail("note-stream index does not cover the records", error);
+        }
+        m_header = header;
+        m_starts = starts;
+        return true;
+    }
+
+    uint64_t melodyCount() const { return m_header ? m_header->melody_count : 0; }
+    uint64_t recordCount() const { return m_header ? m_header->record_count : 0; }
+    uint32_t timeUnitUs() const { return m_header ? m_header->time_unit_us : 0; }
+
+    // Every record in the file.
+    NoteSpan records() const {
+        const NoteRecord* base = recordBase();
+        return {base, base + recordCount()};
+    }
+
+    // Records of melody `m` (spacers included).
+    NoteSpan melody(uint64_t m) const {
+        const NoteRecord* base = recordBase();
+        return {base + m_starts[m], base + m_starts[m + 1]};
+    }
+
+private:
+    const NoteRecord* recordBase() const {
+        return reinterpret_cast<const NoteRecord*>(m_map.data() + sizeof(NoteFileHeader));
+    }
+
+    bool fail(const std::string& reason, std::string& error) {
+        error = reason;
+        m_map.close();
+        return false;
+    }
+
+    MappedFile m_map;
+    const NoteFileHeader* m_header = nullptr;
+    const uint64_t* m_starts = nullptr;
+};
+
+#endif // MOOD_NOTEFILE_H
@@ -0,0 +1,193 @@
+// 🧬 Built-in Mood Profiles
+//
+// The stock moods as constexpr data, plus a melody kernel instantiated
+// once per mood.  Each kernel's successor table (transition fan-out or
+// scale fallback for every key) is folded at compile time, so the walk
+// needs no map lookups and no branch per note.  A single
+// switch on MoodId picks the kernel at run time.  For the same RNG the
+// kernels produce exactly the notes of generateMelodyInto() over the
+// tables built from these profiles.
+
+#ifndef MOOD_PROFILES_H
+#define MOOD_PROFILES_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+enum MoodId {
+    MOOD_NONE = -1,
+    MOOD_JOYFUL,
+    MOOD_MELANCHOLY,
+    MOOD_POWERFUL,
+    MOOD_CALM,
+    MOOD_TENSE,
+    MOOD_DREAMY,
+    MOOD_COUNT
+};
+
+// 🎵 Markov Chain for Melody Generation (shared by every mood)
+constexpr int TRANSITION_FANOUT = 3;
+
+struct MoodTransition {
+    int key;
+    int next[TRANSITION_FANOUT];
+};
+
+constexpr MoodTransition builtin_transitions[] = {
+    {60, {62, 64, 67}}, {62, {64, 60, 65}}, {64, {65, 67, 60}},
+    {65, {67, 69, 60}}, {67, {69, 71, 60}}, {69, {71, 72, 60}},
+    {71, {72, 74, 60}}
+};
+
+constexpr int TRANSITION_COUNT = sizeof(builtin_transitions) / sizeof(builtin_transitions[0]);
+
+// 🎼 Scale, 🎚️ tempo and 🎹 instrument of each mood
+struct MoodProfile {
+    static constexpr int MAX_SCALE = 8;
+
+    const char* name;
+    int tempo;
+    int instrument;
+    int scale_size;
+    int scale[MAX_SCALE];
+};
+
+constexpr MoodProfile builtin_moods[MOOD_COUNT] = {
+    {"joyful", 120, 0, 8, {60, 62, 64, 65, 67, 69, 71, 72}},
+    {"melancholy", 60, 40, 8, {60, 62, 63, 65, 67, 68, 70, 72}},
+    {"powerful", 150, 81, 6, {60, 62, 65, 67, 70, 72}},
+    {"calm", 80, 14, 7, {60, 62, 64, 65, 67, 69, 71}},
+    {"tense", 100, 48, 7, {60, 61, 64, 65, 68, 69, 72}},
+    {"dreamy", 90, 89, 6, {60, 62, 64, 66, 69, 71}}
+};
+
+// Transition row of every MIDI key (-1: no transitions, use the scale).
+struct TransitionIndex {
+    int8_t row[128];
+};
+
+constexpr TransitionIndex makeTransitionIndex() {
+    TransitionIndex index{};
+    for (int key = 0; key < 128; key++) {
+        index.row[key] = -1;
+    }
+    for (int i = 0; i < TRANSITION_COUNT; i++) {
+        index.row[builtin_transitions[i].key] = static_cast<int8_t>(i);
+    }
+    return index;
+}
+
+constexpr TransitionIndex transition_index = makeTransitionIndex();
+
+inline MoodId builtinMoodId(const std::string& name) {
+    for (int i = 0; i < MOOD_COUNT; i++) {
+        if (name == builtin_moods[i].name) return static_cast<MoodId>(i);
+    }
+    return MOOD_NONE;
+}
+
+// 🗺️ The profiles as the runtime tables used everywhere else.
+inline std::map<int, std::vector<int>> builtinTransitionTable() {
+    std::map<int, std::vector<int>> table;
+    for (const MoodTransition& t : builtin_transitions) {
+        table[t.key].assign(t.next, t.next + TRANSITION_FANOUT);
+    }
+    return table;
+}
+
+inline std::map<std::string, std::vector<int>> builtinScaleTable() {
+    std::map<std::string, std::vector<int>> table;
+    for (const MoodProfile& p : builtin_moods) {
+        table[p.name].assign(p.scale, p.scale + p.scale_size);
+    }
+    return table;
+}
+
+inline std::map<std::string, int> builtinTempoTable() {
+    std::map<std::string, int> table;
+    for (const MoodProfile& p : builtin_moods) {
+        table[p.name] = p.tempo;
+    }
+    return table;
+}
+
+inline std::map<std::string, int> builtinInstrumentTable() {
+    std::map<std::string, int> table;
+    for (const MoodProfile& p : builtin_moods) {
+        table[p.name] = p.instrument;
+    }
+    return table;
+}
+
+// Successors of every key for one mood, folded at compile time: the
+// transition row where there is one, else the mood's scale.
+struct MoodKernelTable {
+    uint8_t count[128];
+    uint8_t next[128][MoodProfile::MAX_SCALE];
+};
+
+template <MoodId M>
+constexpr MoodKernelTable makeMoodKernelTable() {
+    constexpr const MoodProfile& profile = builtin_moods[M];
+    MoodKernelTable table{};
+    for (int key = 0; key < 128; key++) {
+        int row = transition_index.row[key];
+        const int* next = row >= 0 ? builtin_transitions[row].next : profile.scale;
+        int count = row >= 0 ? TRANSITION_FANOUT : profile.scale_size;
+        table.count[key] = static_cast<uint8_t>(count);
+        for (int i = 0; i < count; i++) {
+            table.next[key][i] = static_cast<uint8_t>(next[i]);
+        }
+    }
+    return table;
+}
+
+template <MoodId M>
+struct MoodKernelData {
+    static constexpr MoodKernelTable table = makeMoodKernelTable<M>();
+};
+
+// ⚙️ Melody kernel specialized for mood M: the first note comes from the
+// constant-size scale, then each step is one table load and one draw.
+template <MoodId M, class Rng>
+void generateBuiltinMelody(int* out, int length, Rng& rng) {
+    constexpr const MoodProfile& profile = builtin_moods[M];
+    constexpr uint32_t scale_size = static_cast<uint32_t>(profile.scale_size);
+    static_assert(scale_size > 0 && scale_size <= MoodProfile::MAX_SCALE, "bad scale size");
+    const MoodKernelTable& table = MoodKernelData<M>::table;
+
+    int note = profile.scale[rng.below(scale_size)];
+    for (int i = 0; i < length; i++) {
+        out[i] = note;
+        note = table.next[note][rng.below(table.count[note])];
+    }
+}
+
+// Run-time entry point: one switch into the specialized kernel.
+template <class Rng>
+void generateBuiltinMelody(MoodId mood, int* out, int length, Rng& rng) {
+    switch (mood) {
+        case MOOD_JOYFUL:     generateBuiltinMelody<MOOD_JOYFUL>(out, length, rng); break;
+        case MOOD_MELANCHOLY: generateBuiltinMelody<MOOD_MELANCHOLY>(out, length, rng); break;
+        case MOOD_POWERFUL:   generateBuiltinMelody<MOOD_POWERFUL>(out, length, rng); break;
+        case MOOD_CALM:       generateBuiltinMelody<MOOD_CALM>(out, length, rng); break;
+        case MOOD_TENSE:      generateBuiltinMelody<MOOD_TENSE>(out, length, rng); break;
+        case MOOD_DREAMY:     generateBuiltinMelody<MOOD_DREAMY>(out, length, rng); break;
+        default: break;
+    }
+}
+
+// Model-shaped wrapper, so batch code written against CompiledMood or
+// NgramModel (anything with generate()) can run the kernels too.
+struct BuiltinMoodKernel {
+    MoodId mood = MOOD_NONE;
+
+    template <class Rng>
+    void generate(int* out, int length, Rng& rng) const {
+        generateBuiltinMelody(mood, out, length, rng);
+    }
+};
+
+#endif // MOOD_PROFILES_H
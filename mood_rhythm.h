@@ -0,0 +1,170 @@
+// 🥁 Rhythm Engine
+//
+// All note timing in musical ticks (RHYTHM_TPQ per quarter note): a
+// pattern of step lengths cycled over the notes, a meter for bar lines,
+// and swing that pushes every off-beat eighth later.  A tempo map turns
+// ticks into microseconds with integer math only: each segment holds the
+// microseconds per quarter exactly as an SMF tempo event stores them,
+// and a tick is converted from its segment start with one multiply and
+// one divide.  Playback, SMF export, the synthesizer and note-stream
+// files all take their times from here, so nothing is truncated note by
+// note, nothing drifts, and what plays is what a MIDI player would play
+// from the exported file.
+
+#ifndef MOOD_RHYTHM_H
+#define MOOD_RHYTHM_H
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+static constexpr int RHYTHM_TPQ = 480;
+
+struct Meter {
+    int beats = 4;            // per bar
+    int unit = 4;             // note value of a beat: 4 quarter, 8 eighth
+
+    int beatTicks() const { return RHYTHM_TPQ * 4 / unit; }
+    int barTicks() const { return beats * beatTicks(); }
+};
+
+// "3/4", "6/8", ... (unit 1, 2, 4, 8 or 16).
+inline bool parseMeter(const std::string& text, Meter& meter) {
+    size_t slash = text.find('/');
+    if (slash == std::string::npos) return false;
+    int beats = std::atoi(text.substr(0, slash).c_str());
+    int unit = std::atoi(text.substr(slash + 1).c_str());
+    if (beats < 1 || beats > 32 || unit < 1 || unit > 16 || (unit & (unit - 1)) != 0) return false;
+    meter.beats = beats;
+    meter.unit = unit;
+    return true;
+}
+
+// Onset and release of one note, in ticks, swing applied.
+struct NoteTiming {
+    long long on = 0;
+    long long off = 0;
+};
+
+class RhythmPattern {
+public:
+    RhythmPattern() : RhythmPattern(std::vector<int>{RHYTHM_TPQ}) {}
+
+    // `steps` in ticks (each at least 1); `swing` is where the off-beat
+    // eighth starts, in percent of a quarter (50 straight .. 75 dotted).
+    explicit RhythmPattern(const std::vector<int>& steps, const Meter& meter = Meter(), int swing = 50)
+        : m_steps(steps), m_meter(meter) {
+        if (m_steps.empty()) m_steps.push_back(RHYTHM_TPQ);
+        for (int& step : m_steps) step = std::max(1, step);
+        setSwing(swing);
+    }
+
+    void setMeter(const Meter& meter) {
+        m_meter = meter;
+        setSwing(m_swing);
+    }
+
+    void setSwing(int swing) {
+        m_swing = std::min(75, std::max(50, swing));
+        // Swing pairs eighths within a quarter, whatever the meter's beat.
+        m_split = RHYTHM_TPQ * m_swing / 100;
+    }
+
+    const std::vector<int>& steps() const { return m_steps; }
+    const Meter& meter() const { return m_meter; }
+    int swing() const { return m_swing; }
+
+    int step(long long index) const { return m_steps[static_cast<size_t>(index % m_steps.size())]; }
+
+    // Where straight tick `tick` lands after swing: the second eighth of
+    // each quarter moves to m_split and the grid between is stretched, so
+    // notes keep their order and the quarter lines stay put.
+    long long swung(long long tick) const {
+        if (m_swing == 50) return tick;
+        static constexpr int HALF = RHYTHM_TPQ / 2;
+        long long quarter = tick - tick % RHYTHM_TPQ;
+        long long pos = tick - quarter;
+        return quarter + (pos < HALF ? pos * m_split / HALF
+                                     : m_split + (pos - HALF) * (RHYTHM_TPQ - m_split) / HALF);
+    }
+
+private:
+    std::vector<int> m_steps;
+    Meter m_meter;
+    int m_swing = 50;
+    int m_split = RHYTHM_TPQ / 2;
+};
+
+// ⏱️ Walks a pattern from tick 0: each note starts where the previous one
+// ended on the straight grid.
+class RhythmClock {
+public:
+    explicit RhythmClock(const RhythmPattern& pattern) : m_pattern(pattern) {}
+
+    NoteTiming next() {
+        int step = m_pattern.step(m_index++);
+        NoteTiming timing{m_pattern.swung(m_tick), m_pattern.swung(m_tick + step)};
+        m_tick += step;
+        return timing;
+    }
+
+    // Straight (unswung) onset of the next note.
+    long long tick() const { return m_tick; }
+    const RhythmPattern& pattern() const { return m_pattern; }
+
+private:
+    RhythmPattern m_pattern;
+    long long m_tick = 0;
+    long long m_index = 0;
+};
+
+struct TempoSegment {
+    long long tick = 0;
+    long long micros = 0;           // time of `tick`
+    long long us_per_quarter = 500000;
+};
+
+// 🗺️ Piecewise-constant tempo.  Changes are appended in tick order.
+class TempoMap {
+public:
+    explicit TempoMap(double bpm = 120.0) { m_segments.push_back({0, 0, quarterMicros(bpm)}); }
+
+    // Rounded like an SMF tempo meta event (SmfWriter::tempo, MidiFile::addTempo).
+    static long long quarterMicros(double bpm) {
+        return static_cast<long long>(60.0 / bpm * 1000000.0 + 0.5);
+    }
+
+    // Tempo `bpm` from `tick` on; earlier ticks move up to the last change.
+    void set(long long tick, double bpm) {
+        TempoSegment& last = m_segments.back();
+        tick = std::max(tick, last.tick);
+        long long us_per_quarter = quarterMicros(bpm);
+        if (tick == last.tick) {
+            last.us_per_quarter = us_per_quarter;
+        } else {
+            m_segments.push_back({tick, micros(tick), us_per_quarter});
+        }
+    }
+
+    long long micros(long long tick) const {
+        auto after = std::upper_bound(m_segments.begin(), m_segments.end(), tick,
+                                      [](long long t, const TempoSegment& s) { return t < s.tick; });
+        const TempoSegment& segment = after == m_segments.begin() ? m_segments.front() : *(after - 1);
+        return segment.micros + (tick - segment.tick) * segment.us_per_quarter / RHYTHM_TPQ;
+    }
+
+    double bpm(long long tick) const {
+        auto after = std::upper_bound(m_segments.begin(), m_segments.end(), tick,
+                                      [](long long t, const TempoSegment& s) { return t < s.tick; });
+        const TempoSegment& segment = after == m_segments.begin() ? m_segments.front() : *(after - 1);
+        return 60000000.0 / segment.us_per_quarter;
+    }
+
+    const std::vector<TempoSegment>& segments() const { return m_segments; }
+
+private:
+    std::vector<TempoSegment> m_segments;
+};
+
+#endif // MOOD_RHYTHM_H
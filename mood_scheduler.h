@@ -0,0 +1,152 @@
+// ⏰ Drift-Free Event Scheduler
+//
+// Sends short MIDI messages at absolute deadlines measured from one
+// monotonic origin, instead of sleeping a relative duration after each
+// send.  Send cost and oversleep therefore never accumulate: every event
+// aims at origin + its nominal offset.  The scheduler sleeps until shortly
+// before a deadline and optionally spins the rest of the way, and keeps
+// lateness statistics in a fixed histogram so endless sessions stay
+// constant-memory.
+
+#ifndef MOOD_SCHEDULER_H
+#define MOOD_SCHEDULER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// 📊 Lateness of sent events (send time minus deadline).
+struct LatenessStats {
+    static constexpr int BUCKETS = 4096;  // 1 us buckets, last one is overflow
+
+    long long count = 0;
+    double sum_us = 0.0;
+    double max_us = 0.0;
+    double last_us = 0.0;                // lateness of the final event = session drift
+    std::vector<uint32_t> histogram = std::vector<uint32_t>(BUCKETS, 0);
+
+    void add(double late_us) {
+        late_us = std::max(0.0, late_us);
+        count++;
+        sum_us += late_us;
+        max_us = std::max(max_us, late_us);
+        last_us = late_us;
+        histogram[std::min(BUCKETS - 1, static_cast<int>(late_us))]++;
+    }
+
+    double mean() const { return count ? sum_us / count : 0.0; }
+
+    // Upper bound of the bucket holding quantile q (0..1), in microseconds.
+    double percentile(double q) const {
+        if (count == 0) return 0.0;
+        long long target = static_cast<long long>(q * (count - 1)) + 1;
+        long long seen = 0;
+        for (int i = 0; i < BUCKETS; i++) {
+            seen += histogram[i];
+            if (seen >= target) return i + 1 < BUCKETS ? i + 1.0 : max_us;
+        }
+        return max_us;
+    }
+};
+
+// Deadline and actual send time of one dispatched message, in
+// microseconds from the scheduler origin.
+struct DispatchRecord {
+    double deadline_us;
+    double sent_us;
+};
+
+// Dispatches messages in deadline order through `send(bytes, size)`.
+template <class Send>
+class EventScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // `spin` is how long before each deadline the scheduler stops
+    // sleeping and busy-waits; zero relies on sleep_until alone.
+    explicit EventScheduler(Send send, Clock::duration spin = std::chrono::microseconds(500))
+        : m_send(send), m_spin(spin), m_origin(Clock::now()) {}
+
+    // Restart the timeline at the current instant.
+    void start() { m_origin = Clock::now(); }
+
+    Clock::time_point origin() const { return m_origin; }
+    Clock::duration elapsed() const { return Clock::now() - m_origin; }
+
+    // Queue a message (up to 3 bytes) at `offset` from the origin.
+    void at(Clock::duration offset, unsigned char status, unsigned char data1 = 0,
+            unsigned char data2 = 0, int size = 3) {
+        Event event;
+        event.deadline = m_origin + offset;
+        event.sequence = m_sequence++;
+        event.bytes[0] = status;
+        event.bytes[1] = data1;
+        event.bytes[2] = data2;
+        event.size = static_cast<unsigned char>(size);
+        m_queue.push(event);
+    }
+
+    bool empty() const { return m_queue.empty(); }
+    size_t pending() const { return m_queue.size(); }
+
+    // Wait for the earliest deadline, send that message and record its lateness.
+    void dispatchNext() {
+        if (m_queue.empty()) return;
+        Event event = m_queue.top();
+        m_queue.pop();
+        waitUntil(event.deadline);
+        m_send(event.bytes, static_cast<size_t>(event.size));
+        auto sent = Clock::now();
+        m_stats.add(std::chrono::duration<double, std::micro>(sent - event.deadline).count());
+        if (m_trace) {
+            m_trace->push_back({std::chrono::duration<double, std::micro>(event.deadline - m_origin).count(),
+                                std::chrono::duration<double, std::micro>(sent - m_origin).count()});
+        }
+    }
+
+    const LatenessStats& stats() const { return m_stats; }
+
+    // Also append a DispatchRecord per sent message to `records` (null: off).
+    void trace(std::vector<DispatchRecord>* records) { m_trace = records; }
+
+private:
+    struct Event {
+        Clock::time_point deadline;
+        uint64_t sequence;            // keeps equal deadlines in queue order
+        unsigned char bytes[3];
+        unsigned char size;
+
+        bool operator>(const Event& other) const {
+            return deadline != other.deadline ? deadline > other.deadline
+                                              : sequence > other.sequence;
+        }
+    };
+
+    void waitUntil(Clock::time_point deadline) {
+        if (Clock::now() < deadline - m_spin) {
+            std::this_thread::sleep_until(deadline - m_spin);
+        }
+        while (Clock::now() < deadline) {
+            // spin out the remainder
+        }
+    }
+
+    Send m_send;
+    Clock::duration m_spin;
+    Clock::time_point m_origin;
+    uint64_t m_sequence = 0;
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> m_queue;
+    LatenessStats m_stats;
+    std::vector<DispatchRecord>* m_trace = nullptr;
+};
+
+template <class Send>
+EventScheduler<Send> makeScheduler(Send send,
+                                   std::chrono::steady_clock::duration spin = std::chrono::microseconds(500)) {
+    return EventScheduler<Send>(send, spin);
+}
+
+#endif // MOOD_SCHEDULER_H
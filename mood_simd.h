@@ -0,0 +1,230 @@
+// 🚀 Lock-Step Chain Sampling
+//
+// Advances many independent melodies over one compiled mood at once:
+// each 64-bit vector lane carries one chain's xorshift64* state and
+// current note, the row and alias cell are fetched with gathers, and the
+// keep-or-alias choice is a vector compare.  AVX-512 runs 16 chains (two
+// registers), AVX2 runs 8; anything else falls back to the scalar loop.
+// Every lane performs exactly the draws of CompiledMoodView::generate()
+// with a MelodyRng, so each chain matches the scalar batch for its seed.
+//
+// The SIMD paths are compiled with per-function target attributes and
+// picked at run time, so the binary needs no -mavx flags and still runs
+// on older CPUs.
+
+#ifndef MOOD_SIMD_H
+#define MOOD_SIMD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "mood_batch.h"
+#include "mood_model.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MOOD_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+enum SimdLevel { SIMD_SCALAR, SIMD_AVX2, SIMD_AVX512 };
+
+inline SimdLevel detectSimd() {
+#ifdef MOOD_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")) {
+        return SIMD_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")) return SIMD_AVX2;
+#endif
+    return SIMD_SCALAR;
+}
+
+inline const char* simdName(SimdLevel level) {
+    switch (level) {
+        case SIMD_AVX512: return "AVX-512";
+        case SIMD_AVX2:   return "AVX2";
+        default:          return "scalar";
+    }
+}
+
+// Chains advanced together by one call at `level`.
+inline int simdLanes(SimdLevel level) {
+    return level == SIMD_AVX512 ? 16 : level == SIMD_AVX2 ? 8 : 1;
+}
+
+// 🐢 Reference: chain c draws from MelodyRng(seeds[c]) into out + c * stride.
+inline void sampleChainsScalar(const CompiledMoodView& model, const uint64_t* seeds, int chains,
+                               int length, int* out, size_t stride) {
+    for (int c = 0; c < chains; c++) {
+        MelodyRng rng(seeds[c]);
+        model.generate(out + c * stride, length, rng);
+    }
+}
+
+#ifdef MOOD_SIMD_X86
+
+// One xorshift64* step and alias sample for four chains.
+__attribute__((target("avx2")))
+inline __m256i stepChainsAvx2(const CompiledMoodView& model, __m256i& state, __m256i row_index) {
+    const __m256i low32 = _mm256_set1_epi64x(0xFFFFFFFFLL);
+    const __m256i multiplier_lo = _mm256_set1_epi64x(0x4F6CDD1DLL);
+    const __m256i multiplier_hi = _mm256_set1_epi64x(0x2545F491LL);
+    const __m256i byte = _mm256_set1_epi64x(0xFF);
+
+    state = _mm256_xor_si256(state, _mm256_srli_epi64(state, 12));
+    state = _mm256_xor_si256(state, _mm256_slli_epi64(state, 25));
+    state = _mm256_xor_si256(state, _mm256_srli_epi64(state, 27));
+    // 64-bit multiply from three 32x32 products (AVX2 has no vpmullq).
+    __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(state, 32), multiplier_lo),
+                                     _mm256_mul_epu32(state, multiplier_hi));
+    __m256i draw = _mm256_add_epi64(_mm256_mul_epu32(state, multiplier_lo),
+                                    _mm256_slli_epi64(cross, 32));
+
+    __m256i row = _mm256_i64gather_epi64(reinterpret_cast<const long long*>(model.rows), row_index, 8);
+    __m256i column = _mm256_srli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(draw, 32),
+                                                        _mm256_srli_epi64(row, 32)), 32);
+    __m256i cell_index = _mm256_add_epi64(_mm256_and_si256(row, low32), column);
+    __m256i cell = _mm256_i64gather_epi64(reinterpret_cast<const long long*>(model.cells), cell_index, 8);
+
+    __m256i keep = _mm256_cmpgt_epi64(_mm256_and_si256(cell, low32), _mm256_and_si256(draw, low32));
+    __m256i note = _mm256_and_si256(_mm256_srli_epi64(cell, 32), byte);
+    __m256i alias = _mm256_and_si256(_mm256_srli_epi64(cell, 40), byte);
+    return _mm256_blendv_epi8(alias, note, keep);
+}
+
+__attribute__((target("avx2")))
+inline void storeChainsAvx2(__m256i notes, int* out, size_t stride) {
+    alignas(32) long long lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), notes);
+    for (int lane = 0; lane < 4; lane++) {
+        out[lane * stride] = static_cast<int>(lanes[lane]);
+    }
+}
+
+// Eight chains: two registers in flight to hide gather latency.
+__attribute__((target("avx2")))
+inline void sampleChainsAvx2(const CompiledMoodView& model, const uint64_t* seeds,
+                             int length, int* out, size_t stride) {
+    alignas(32) long long states[8];
+    for (int c = 0; c < 8; c++) {
+        states[c] = static_cast<long long>(MelodyRng(seeds[c]).state);
+    }
+    __m256i state0 = _mm256_load_si256(reinterpret_cast<const __m256i*>(states));
+    __m256i state1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(states + 4));
+    __m256i start = _mm256_set1_epi64x(CompiledMoodView::START_ROW);
+    __m256i note0 = stepChainsAvx2(model, state0, start);
+    __m256i note1 = stepChainsAvx2(model, state1, start);
+    for (int i = 0; i < length; i++) {
+        storeChainsAvx2(note0, out + i, stride);
+        storeChainsAvx2(note1, out + 4 * stride + i, stride);
+        note0 = stepChainsAvx2(model, state0, note0);
+        note1 = stepChainsAvx2(model, state1, note1);
+    }
+}
+
+// GCC 12's AVX-512 headers trip -Wuninitialized on _mm512_undefined_*().
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+// One xorshift64* step and alias sample for eight chains.
+__attribute__((target("avx512f,avx512dq")))
+inline __m512i stepChainsAvx512(const CompiledMoodView& model, __m512i& state, __m512i row_index) {
+    const __m512i low32 = _mm512_set1_epi64(0xFFFFFFFFLL);
+    const __m512i multiplier = _mm512_set1_epi64(0x2545F4914F6CDD1DLL);
+    const __m512i byte = _mm512_set1_epi64(0xFF);
+
+    state = _mm512_xor_si512(state, _mm512_srli_epi64(state, 12));
+    state = _mm512_xor_si512(state, _mm512_slli_epi64(state, 25));
+    state = _mm512_xor_si512(state, _mm512_srli_epi64(state, 27));
+    __m512i draw = _mm512_mullo_epi64(state, multiplier);
+
+    __m512i row = _mm512_i64gather_epi64(row_index, model.rows, 8);
+    __m512i column = _mm512_srli_epi64(_mm512_mul_epu32(_mm512_srli_epi64(draw, 32),
+                                                        _mm512_srli_epi64(row, 32)), 32);
+    __m512i cell_index = _mm512_add_epi64(_mm512_and_si512(row, low32), column);
+    __m512i cell = _mm512_i64gather_epi64(cell_index, model.cells, 8);
+
+    __mmask8 keep = _mm512_cmpgt_epu64_mask(_mm512_and_si512(cell, low32),
+                                            _mm512_and_si512(draw, low32));
+    __m512i note = _mm512_and_si512(_mm512_srli_epi64(cell, 32), byte);
+    __m512i alias = _mm512_and_si512(_mm512_srli_epi64(cell, 40), byte);
+    return _mm512_mask_blend_epi64(keep, alias, note);
+}
+
+// Sixteen chains; results are scattered straight into each melody.
+__attribute__((target("avx512f,avx512dq")))
+inline void sampleChainsAvx512(const CompiledMoodView& model, const uint64_t* seeds,
+                               int length, int* out, size_t stride) {
+    alignas(64) long long states[16];
+    alignas(64) long long offsets[8];
+    for (int c = 0; c < 16; c++) {
+        states[c] = static_cast<long long>(MelodyRng(seeds[c]).state);
+    }
+    for (int lane = 0; lane < 8; lane++) {
+        offsets[lane] = static_cast<long long>(lane * stride);
+    }
+    __m512i state0 = _mm512_load_si512(states);
+    __m512i state1 = _mm512_load_si512(states + 8);
+    __m512i where = _mm512_load_si512(offsets);
+    __m512i start = _mm512_set1_epi64(CompiledMoodView::START_ROW);
+    __m512i note0 = stepChainsAvx512(model, state0, start);
+    __m512i note1 = stepChainsAvx512(model, state1, start);
+    int* second = out + 8 * stride;
+    for (int i = 0; i < length; i++) {
+        _mm512_i64scatter_epi32(out + i, where, _mm512_cvtepi64_epi32(note0), 4);
+        _mm512_i64scatter_epi32(second + i, where, _mm512_cvtepi64_epi32(note1), 4);
+        note0 = stepChainsAvx512(model, state0, note0);
+        note1 = stepChainsAvx512(model, state1, note1);
+    }
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif // MOOD_SIMD_X86
+
+// 🧮 Chains c = 0..chains-1 from MelodyRng(seeds[c]) into out + c *
+// stride, in groups of simdLanes(level) with a scalar tail.
+inline void sampleChains(const CompiledMoodView& model, const uint64_t* seeds, int chains,
+                         int length, int* out, size_t stride, SimdLevel level) {
+    int c = 0;
+#ifdef MOOD_SIMD_X86
+    if (level == SIMD_AVX512) {
+        for (; c + 16 <= chains; c += 16) {
+            sampleChainsAvx512(model, seeds + c, length, out + c * stride, stride);
+        }
+    } else if (level == SIMD_AVX2) {
+        for (; c + 8 <= chains; c += 8) {
+            sampleChainsAvx2(model, seeds + c, length, out + c * stride, stride);
+        }
+    }
+#else
+    (void)level;
+#endif
+    sampleChainsScalar(model, seeds + c, chains - c, length, out + c * stride, stride);
+}
+
+// 🏭 Catalog of (mood, seed) in lock-step groups; the same catalog as
+// generateMelodyBatch() over the same compiled model.
+inline BatchStats generateLockstepBatch(const std::string& mood, uint64_t seed, int count,
+                                        int length, int* out, const CompiledMoodView& model,
+                                        int threads = 0, SimdLevel level = detectSimd()) {
+    return runMelodyBlocks(count, length, out, threads, [&](int first, int n, int* melodies) {
+        uint64_t seeds[256];
+        for (int done = 0; done < n; done += 256) {
+            int group = n - done < 256 ? n - done : 256;
+            for (int j = 0; j < group; j++) {
+                seeds[j] = melodySeed(mood, seed, static_cast<uint64_t>(first + done + j));
+            }
+            sampleChains(model, seeds, group, length, melodies + static_cast<size_t>(done) * length,
+                         static_cast<size_t>(length), level);
+        }
+    });
+}
+
+#endif // MOOD_SIMD_H
@@ -0,0 +1,142 @@
+// 📝 Forward-Only SMF Writer
+//
+// Encodes Standard MIDI File bytes directly into a growing byte buffer:
+// delta times become VLVs as events arrive, each track's length is
+// patched when the track ends, and nothing is allocated per event or
+// sorted.  Events must be written in time order within a track.
+
+#ifndef MOOD_SMFWRITER_H
+#define MOOD_SMFWRITER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+class SmfWriter {
+public:
+    // Start a file with `tracks` tracks (format 0 for one track, else 1),
+    // appending to `out`.
+    SmfWriter(std::vector<uint8_t>& out, int tracks, int tpq) : m_out(out) {
+        const uint8_t header[14] = {
+            'M', 'T', 'h', 'd', 0, 0, 0, 6,
+            0, static_cast<uint8_t>(tracks == 1 ? 0 : 1),
+            static_cast<uint8_t>(tracks >> 8), static_cast<uint8_t>(tracks),
+            static_cast<uint8_t>(tpq >> 8), static_cast<uint8_t>(tpq)};
+        m_out.insert(m_out.end(), header, header + 14);
+    }
+
+    void beginTrack() {
+        const uint8_t chunk[8] = {'M', 'T', 'r', 'k', 0, 0, 0, 0};
+        m_out.insert(m_out.end(), chunk, chunk + 8);
+        m_track_start = m_out.size();
+        m_tick = 0;
+    }
+
+    // Close the track with an end-of-track meta event at `tick` (or at
+    // the last event) and patch the chunk length.
+    void endTrack(int tick = -1) {
+        delta(tick < 0 ? m_tick : tick);
+        put(0xFF);
+        put(0x2F);
+        put(0x00);
+        uint32_t size = static_cast<uint32_t>(m_out.size() - m_track_start);
+        uint8_t* length = &m_out[m_track_start - 4];
+        length[0] = static_cast<uint8_t>(size >> 24);
+        length[1] = static_cast<uint8_t>(size >> 16);
+        length[2] = static_cast<uint8_t>(size >> 8);
+        length[3] = static_cast<uint8_t>(size);
+    }
+
+    // Tempo meta event, rounded to microseconds like MidiFile::addTempo().
+    void tempo(int tick, double bpm) {
+        int us = static_cast<int>(60.0 / bpm * 1000000.0 + 0.5);
+        delta(tick);
+        put(0xFF);
+        put(0x51);
+        put(0x03);
+        put(static_cast<uint8_t>(us >> 16));
+        put(static_cast<uint8_t>(us >> 8));
+        put(static_cast<uint8_t>(us));
+    }
+
+    void program(int tick, int channel, int patch) {
+        delta(tick);
+        put(static_cast<uint8_t>(0xC0 | (channel & 0x0F)));
+        put(static_cast<uint8_t>(patch & 0x7F));
+    }
+
+    void controller(int tick, int channel, int number, int value) {
+        message(tick, 0xB0 | (channel & 0x0F), number, value);
+    }
+
+    void noteOn(int tick, int channel, int key, int velocity) {
+        message(tick, 0x90 | (channel & 0x0F), key, velocity);
+    }
+
+    // Note-off as a zero-velocity note-on, like MidiFile::addNoteOff(track, tick, channel, key).
+    void noteOff(int tick, int channel, int key) {
+        message(tick, 0x90 | (channel & 0x0F), key, 0);
+    }
+
+private:
+    void message(int tick, int status, int data1, int data2) {
+        delta(tick);
+        put(static_cast<uint8_t>(status));
+        put(static_cast<uint8_t>(data1 & 0x7F));
+        put(static_cast<uint8_t>(data2 & 0x7F));
+    }
+
+    void delta(int tick) {
+        uint32_t value = static_cast<uint32_t>(tick > m_tick ? tick - m_tick : 0);
+        m_tick = tick > m_tick ? tick : m_tick;
+        uint8_t bytes[5];
+        int count = 0;
+        bytes[count++] = static_cast<uint8_t>(value & 0x7F);
+        while (value >>= 7) {
+            bytes[count++] = static_cast<uint8_t>(0x80 | (value & 0x7F));
+        }
+        while (count > 0) {
+            put(bytes[--count]);
+        }
+    }
+
+    void put(uint8_t byte) { m_out.push_back(byte); }
+
+    std::vector<uint8_t>& m_out;
+    size_t m_track_start = 0;
+    int m_tick = 0;
+};
+
+// 🎼 Encode a generated melody exactly as saveAsMIDI() lays it out:
+// tempo and program on track 0, each note-on written before the previous
+// note's off at the same tick, and an empty second track.
+template <class DurationTicks>
+void encodeMelodySmf(std::vector<uint8_t>& out, const int* melody, size_t length,
+                     int tpq, int tempo, int instrument, DurationTicks duration_ticks) {
+    SmfWriter writer(out, 2, tpq);
+    writer.beginTrack();
+    writer.tempo(0, tempo);
+    writer.program(0, 0, instrument);
+    int tick = 0;
+    int pending_key = -1;
+    for (size_t i = 0; i < length; i++) {
+        writer.noteOn(tick, 0, melody[i], 100);
+        if (pending_key >= 0) writer.noteOff(tick, 0, pending_key);
+        pending_key = melody[i];
+        tick += duration_ticks(i);
+    }
+    if (pending_key >= 0) writer.noteOff(tick, 0, pending_key);
+    writer.endTrack();
+    writer.beginTrack();
+    writer.endTrack();
+}
+
+inline bool writeBytes(const std::string& filename, const std::vector<uint8_t>& bytes) {
+    FILE* file = std::fopen(filename.c_str(), "wb");
+    if (!file) return false;
+    bool ok = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    return std::fclose(file) == 0 && ok;
+}
+
+#endif // MOOD_SMFWRITER_H
@@ -0,0 +1,98 @@
+// 🌊 Streaming Melody Generation
+//
+// A pull-based generator that yields one note event at a time with
+// constant memory, for endless sessions.  Only the last few notes are
+// kept (enough for the longest n-gram context), so playback can start
+// as soon as the first note is drawn.  Note times come from the rhythm
+// engine in ticks; the player maps them through its tempo map.
+
+#ifndef MOOD_STREAM_H
+#define MOOD_STREAM_H
+
+#include <cstdint>
+#include <vector>
+
+#include "mood_batch.h"
+#include "mood_model.h"
+#include "mood_ngram.h"
+#include "mood_rhythm.h"
+
+struct NoteEvent {
+    long long index = 0;  // position in the stream
+    int key = 60;
+    int velocity = 100;
+    long long tick = 0;   // onset, in RHYTHM_TPQ ticks from the start
+    int duration = 0;     // ticks
+    int channel = 0;
+    int program = -1;     // program change sent on `channel` just before the note
+    double tempo = 0.0;   // > 0: tempo (BPM) from this note's onset on
+
+    long long offTick() const { return tick + duration; }
+};
+
+class MelodyStream {
+public:
+    // Stream from a compiled mood (first-order table).  `length` < 0
+    // never ends.
+    MelodyStream(const CompiledMoodView& model, const RhythmPattern& rhythm,
+                 uint64_t seed, long long length = -1)
+        : m_compiled(model), m_clock(rhythm), m_rng(seed), m_length(length) {}
+
+    // Stream from a trained n-gram model.
+    MelodyStream(const NgramView& model, const RhythmPattern& rhythm,
+                 uint64_t seed, long long length = -1)
+        : m_ngram(model), m_clock(rhythm), m_rng(seed), m_length(length) {}
+
+    // Draw the next note; false once `length` notes have been produced.
+    bool next(NoteEvent& event) {
+        if (m_length >= 0 && m_index >= m_length) {
+            return false;
+        }
+        int key;
+        if (m_ngram.slots) {
+            key = m_ngram.sample(m_history + m_filled, m_filled, m_rng.next());
+            push(key);
+        } else {
+            int row = m_index == 0 ? CompiledMoodView::START_ROW : m_history[m_filled - 1];
+            key = m_compiled.sample(row, m_rng.next());
+            m_history[0] = key;
+            m_filled = 1;
+        }
+        event.index = m_index;
+        event.key = key;
+        event.velocity = 100;
+        NoteTiming timing = m_clock.next();
+        event.tick = timing.on;
+        event.duration = static_cast<int>(timing.off - timing.on);
+        event.channel = 0;
+        event.program = -1;
+        event.tempo = 0.0;
+        m_index++;
+        return true;
+    }
+
+    long long position() const { return m_index; }
+
+private:
+    static constexpr int HISTORY = NgramCounts::MAX_ORDER;
+
+    // Keep the newest HISTORY notes contiguous for ngramContext().
+    void push(int key) {
+        if (m_filled == HISTORY) {
+            for (int i = 1; i < HISTORY; i++) m_history[i - 1] = m_history[i];
+            m_filled--;
+        }
+        m_history[m_filled++] = key;
+    }
+
+    CompiledMoodView m_compiled;
+    NgramView m_ngram;
+    RhythmClock m_clock;
+    MelodyRng m_rng;
+    long long m_length;
+    long long m_index = 0;
+    int m_history[HISTORY] = {};
+    int m_filled = 0;
+};
+
+#endif // MOOD_STREAM_H
@@ -0,0 +1,464 @@
+// 🔊 Offline Software Synthesizer
+//
+// Renders notes to PCM for machines without a MIDI port.  A voice is up
+// to eight additive harmonics (or noise, for percussion) under a linear
+// ADSR envelope; the patch is picked by General MIDI program family, so
+// every entry of mood_instruments gets its own colour.  Audio is made in
+// blocks of BLOCK_FRAMES frames that stay in L1: within a block each
+// sounding voice runs its oscillator and envelope eight frames at a time
+// on compiler vector types (SSE, AVX or NEON, whatever the target has).
+// The piece is cut into time slices that all cores render at once, each
+// mixing the voices that sound in it straight into its own part of the
+// output, so threads never share a buffer.  The result is
+// peak-normalized and written as 16- or 24-bit mono WAV.
+
+#ifndef MOOD_SYNTH_H
+#define MOOD_SYNTH_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "midifile/include/MidiFile.h"
+#include "mood_rhythm.h"
+#include "mood_smfwriter.h"
+#include "mood_stream.h"
+
+#if defined(__GNUC__) || defined(__clang__)
+#define MOOD_SYNTH_VECTOR 1
+#define MOOD_SYNTH_INLINE inline __attribute__((always_inline))
+// Where ifuncs exist, the voice kernel is also built for AVX2 + FMA and
+// picked at load time; the helper is force-inlined into each clone.
+#if defined(__linux__) && defined(__x86_64__) && !defined(__clang__)
+#define MOOD_SYNTH_CLONES __attribute__((target_clones("avx2,fma", "default")))
+#else
+#define MOOD_SYNTH_CLONES
+#endif
+#endif
+
+struct SynthNote {
+    double start = 0.0;       // seconds
+    double duration = 0.0;    // seconds until note-off
+    int key = 60;
+    int velocity = 100;
+    int channel = 0;
+    int program = 0;
+};
+
+static constexpr int SYNTH_HARMONICS = 8;
+static constexpr int SYNTH_LANES = 8;
+
+struct SynthPatch {
+    float harmonics[SYNTH_HARMONICS] = {1.0f};  // amplitude of partials 1..8
+    float attack = 0.01f;     // seconds
+    float decay = 0.2f;       // seconds from peak to sustain
+    float sustain = 0.8f;     // level
+    float release = 0.2f;     // seconds after note-off
+    float pitch_hz = 0.0f;    // fixed pitch (drums), 0: from the key
+    bool noise = false;       // white noise instead of harmonics
+};
+
+// 🎛️ Patch for GM `program` on `channel` (channel 10 is percussion).
+inline SynthPatch synthPatch(int program, int channel, int key) {
+    struct Family {
+        float harmonics[SYNTH_HARMONICS];
+        float attack, decay, sustain, release;
+    };
+    static const Family families[16] = {
+        {{1, .50f, .33f, .25f, .20f, .12f, .08f, .05f}, .005f, 1.2f, .15f, .30f},  // piano
+        {{1, 0, .60f, 0, .40f, 0, .25f, 0},               .002f, 2.0f, 0,    1.0f},  // chromatic perc.
+        {{1, .80f, .60f, 0, .50f, 0, 0, .40f},            .010f, .05f, 1,    .08f},  // organ
+        {{1, .60f, .40f, .30f, .20f, .10f, .05f, .03f},   .003f, .80f, .10f, .20f},  // guitar
+        {{1, .50f, .20f, .10f, 0, 0, 0, 0},               .005f, .30f, .60f, .10f},  // bass
+        {{1, .50f, .33f, .25f, .20f, .17f, .14f, .12f},   .120f, .20f, .85f, .30f},  // strings
+        {{1, .40f, .25f, .15f, .10f, .08f, .06f, .05f},   .300f, .30f, .90f, .60f},  // ensemble
+        {{1, .80f, .60f, .50f, .40f, .30f, .20f, .10f},   .050f, .20f, .80f, .15f},  // brass
+        {{1, 0, .33f, 0, .20f, 0, .14f, 0},               .040f, .10f, .90f, .10f},  // reed
+        {{1, .10f, .05f, 0, 0, 0, 0, 0},                  .040f, .10f, .90f, .15f},  // pipe
+        {{1, .50f, .33f, .25f, .20f, .17f, .14f, .12f},   .010f, .10f, .90f, .10f},  // synth lead
+        {{1, .30f, .15f, .05f, .03f, 0, 0, 0},            .600f, .50f, .80f, 1.2f},  // synth pad
+        {{1, .40f, 0, .20f, 0, .10f, 0, 0},               .200f, .50f, .70f, .80f},  // synth effects
+        {{1, .50f, .30f, .20f, .10f, 0, 0, 0},            .005f, .60f, .20f, .30f},  // ethnic
+        {{1, 0, .50f, 0, .30f, 0, 0, 0},                  .002f, .30f, 0,    .20f},  // percussive
+        {{1, 0, 0, 0, 0, 0, 0, 0},                        .100f, .20f, .50f, .30f},  // sound effects
+    };
+
+    SynthPatch patch;
+    if (channel == 9) {
+        // Kicks are a low sine thump, everything else a noise burst.
+        patch.attack = 0.001f;
+        patch.sustain = 0.0f;
+        patch.release = 0.01f;
+        if (key <= 36) {
+            patch.pitch_hz = 55.0f;
+            patch.decay = 0.25f;
+        } else {
+            patch.noise = true;
+            patch.decay = key == 42 || key == 44 ? 0.05f : 0.15f;
+        }
+        return patch;
+    }
+    const Family& family = families[(program & 0x7F) / 8];
+    std::copy(family.harmonics, family.harmonics + SYNTH_HARMONICS, patch.harmonics);
+    patch.attack = family.attack;
+    patch.decay = family.decay;
+    patch.sustain = family.sustain;
+    patch.release = family.release;
+    return patch;
+}
+
+// A note prepared for rendering; times are in frames.
+struct SynthVoice {
+    long long start = 0;
+    long long stop = 0;       // end of the release tail
+    double cycles = 0.0;      // oscillator cycles per frame
+    float gain = 0.0f;
+    float off = 0.0f;         // note-off, seconds after start
+    float harmonics[SYNTH_HARMONICS] = {};
+    int partials = 0;         // harmonics below Nyquist
+    float attack = 0.0f, decay = 0.0f, sustain = 0.0f, release = 0.0f;
+    uint32_t noise_seed = 0;  // nonzero: noise voice
+};
+
+inline SynthVoice makeVoice(const SynthNote& note, int rate, uint32_t index) {
+    SynthPatch patch = synthPatch(note.program, note.channel, note.key);
+    SynthVoice voice;
+    voice.start = static_cast<long long>(std::llround(note.start * rate));
+    voice.off = static_cast<float>(std::max(0.0, note.duration));
+    voice.stop = voice.start + static_cast<long long>(std::ceil((voice.off + patch.release) * rate)) + 1;
+    double hz = patch.pitch_hz > 0.0f ? patch.pitch_hz : 440.0 * std::pow(2.0, (note.key - 69) / 12.0);
+    voice.cycles = hz / rate;
+    voice.attack = std::max(patch.attack, 1e-4f);
+    voice.decay = std::max(patch.decay, 1e-4f);
+    voice.sustain = patch.sustain;
+    voice.release = std::max(patch.release, 1e-4f);
+
+    float total = 0.0f;
+    for (int h = 0; h < SYNTH_HARMONICS && (h + 1) * voice.cycles < 0.5; h++) {
+        voice.harmonics[h] = patch.harmonics[h];
+        total += patch.harmonics[h];
+        voice.partials = h + 1;
+    }
+    if (patch.noise) {
+        voice.noise_seed = index * 0x9E3779B1u | 1u;
+        total = 1.0f;
+    }
+    voice.gain = total > 0.0f ? (note.velocity / 127.0f) / total : 0.0f;
+    return voice;
+}
+
+// Scalar reference: adds voice frames [begin, begin + frames) into mix.
+inline void renderVoiceScalar(const SynthVoice& voice, long long begin, int frames, float* mix,
+                              int rate) {
+    const double two_pi = 6.283185307179586;
+    for (int i = 0; i < frames; i++) {
+        long long rel = begin + i - voice.start;
+        if (rel < 0 || begin + i >= voice.stop) continue;
+        float t = static_cast<float>(rel) / rate;
+        float a = std::min(t / voice.attack, 1.0f);
+        float d = std::max(voice.sustain, 1.0f - (1.0f - voice.sustain) * (t - voice.attack) / voice.decay);
+        float r = std::min(std::max(1.0f - (t - voice.off) / voice.release, 0.0f), 1.0f);
+        float env = std::max(std::min(a, d), 0.0f) * r;
+        float sample = 0.0f;
+        if (voice.noise_seed) {
+            uint32_t h = (static_cast<uint32_t>(rel) ^ voice.noise_seed) * 0x85EBCA6Bu;
+            h ^= h >> 13;
+            h *= 0xC2B2AE35u;
+            h ^= h >> 16;
+            sample = static_cast<float>(static_cast<int32_t>(h)) * (1.0f / 2147483648.0f);
+        } else {
+            double phase = rel * voice.cycles;
+            phase -= std::floor(phase);
+            for (int h = 0; h < voice.partials; h++) {
+                sample += voice.harmonics[h] * static_cast<float>(std::sin(two_pi * phase * (h + 1)));
+            }
+        }
+        mix[i] += voice.gain * env * sample;
+    }
+}
+
+#ifdef MOOD_SYNTH_VECTOR
+
+typedef float SynthVec __attribute__((vector_size(4 * SYNTH_LANES)));
+typedef int32_t SynthIntVec __attribute__((vector_size(4 * SYNTH_LANES)));
+typedef uint32_t SynthUintVec __attribute__((vector_size(4 * SYNTH_LANES)));
+
+// sum += amplitude * sin(2 pi x) for x >= 0: reduce to a quarter wave,
+// then a degree-7 polynomial (error below 2e-4, about -74 dB).  Vectors
+// go by reference, which keeps GCC's 32-byte vector ABI out of the way.
+MOOD_SYNTH_INLINE void addSinCycles(SynthVec& sum, const SynthVec& x, float amplitude) {
+    SynthVec whole = __builtin_convertvector(__builtin_convertvector(x + 0.5f, SynthIntVec), SynthVec);
+    SynthVec t = x - whole;  // [-0.5, 0.5]
+    SynthVec quarter = SynthVec{} + 0.25f;
+    t = t > quarter ? 0.5f - t : t;
+    t = t < -quarter ? -0.5f - t : t;
+    SynthVec y = t * 6.2831853f;
+    SynthVec y2 = y * y;
+    sum += amplitude * y * (1.0f + y2 * (-1.0f / 6.0f + y2 * (1.0f / 120.0f + y2 * (-1.0f / 5040.0f))));
+}
+
+// Eight frames at a time over a whole BLOCK_FRAMES block buffer; frames
+// of a group that fall before the note start get a zero envelope.
+MOOD_SYNTH_CLONES
+inline void renderVoiceVector(const SynthVoice& voice, long long begin, int frames, float* mix,
+                              int rate) {
+    long long first = begin + (std::max(voice.start, begin) - begin) / SYNTH_LANES * SYNTH_LANES;
+    long long last = std::min(begin + frames, voice.stop);
+
+    SynthVec lane;
+    for (int i = 0; i < SYNTH_LANES; i++) lane[i] = static_cast<float>(i);
+    const float inv_rate = 1.0f / rate;
+    const SynthVec sustain = SynthVec{} + voice.sustain;
+    const SynthVec zero = SynthVec{};
+    const SynthVec one = zero + 1.0f;
+    const SynthVec step = lane * static_cast<float>(voice.cycles);
+
+    for (long long f = first; f < last; f += SYNTH_LANES) {
+        long long rel = f - voice.start;
+        SynthVec t = (lane + static_cast<float>(rel)) * inv_rate;
+        SynthVec a = t * (1.0f / voice.attack);
+        a = a < one ? a : one;
+        SynthVec d = 1.0f - (t - voice.attack) * ((1.0f - voice.sustain) / voice.decay);
+        d = d > sustain ? d : sustain;
+        SynthVec r = 1.0f - (t - voice.off) * (1.0f / voice.release);
+        r = r > zero ? r : zero;
+        r = r < one ? r : one;
+        SynthVec env = a < d ? a : d;
+        env = env > zero ? env * r : zero;
+
+        SynthVec sample = zero;
+        if (voice.noise_seed) {
+            SynthUintVec h = (__builtin_convertvector(lane, SynthUintVec) + static_cast<uint32_t>(rel)) ^
+                             voice.noise_seed;
+            h *= 0x85EBCA6Bu;
+            h ^= h >> 13;
+            h *= 0xC2B2AE35u;
+            h ^= h >> 16;
+            sample = __builtin_convertvector((SynthIntVec)h, SynthVec) *
+                     (1.0f / 2147483648.0f);
+        } else {
+            double phase = rel * voice.cycles;
+            phase -= std::floor(phase);
+            SynthVec p = step + static_cast<float>(phase);
+            for (int h = 0; h < voice.partials; h++) {
+                if (voice.harmonics[h] != 0.0f) {
+                    addSinCycles(sample, p * static_cast<float>(h + 1), voice.harmonics[h]);
+                }
+            }
+        }
+
+        SynthVec out;
+        float* target = mix + (f - begin);
+        std::memcpy(&out, target, sizeof(out));
+        out += (voice.gain * env) * sample;
+        std::memcpy(target, &out, sizeof(out));
+    }
+}
+
+#endif // MOOD_SYNTH_VECTOR
+
+struct SynthStats {
+    long long voices = 0;
+    long long frames = 0;
+    int threads = 1;
+    double seconds = 0.0;     // wall time
+    double realtime = 0.0;    // audio seconds per wall second
+};
+
+// 🎚️ Mix `notes` at `rate` Hz into `out` (mono, not yet normalized).
+// `simd` false uses the scalar reference kernel.
+inline SynthStats renderSynth(const std::vector<SynthNote>& notes, int rate, std::vector<float>& out,
+                              int threads = 0, bool simd = true) {
+    static constexpr int BLOCK_FRAMES = 256;
+    static constexpr int SLICE_BLOCKS = 128;   // about 0.75 s at 44.1 kHz
+    auto clock_start = std::chrono::steady_clock::now();
+
+    std::vector<SynthVoice> voices;
+    voices.reserve(notes.size());
+    for (size_t i = 0; i < notes.size(); i++) {
+        if (notes[i].velocity > 0) voices.push_back(makeVoice(notes[i], rate, static_cast<uint32_t>(i)));
+    }
+    std::sort(voices.begin(), voices.end(),
+              [](const SynthVoice& a, const SynthVoice& b) { return a.start < b.start; });
+    long long total = 0;
+    long long longest = 0;
+    for (const SynthVoice& voice : voices) {
+        total = std::max(total, voice.stop);
+        longest = std::max(longest, voice.stop - voice.start);
+    }
+    out.assign(static_cast<size_t>(total), 0.0f);
+
+    const long long slice_frames = static_cast<long long>(BLOCK_FRAMES) * SLICE_BLOCKS;
+    long long slices = (total + slice_frames - 1) / slice_frames;
+    if (threads <= 0) {
+        threads = static_cast<int>(std::thread::hardware_concurrency());
+        if (threads <= 0) threads = 1;
+    }
+    threads = static_cast<int>(std::max(1LL, std::min<long long>(threads, slices)));
+
+    std::atomic<long long> next_slice(0);
+    auto worker = [&]() {
+        alignas(32) float block[BLOCK_FRAMES];
+        std::vector<const SynthVoice*> active;
+        for (;;) {
+            long long s = next_slice.fetch_add(1, std::memory_order_relaxed);
+            if (s >= slices) break;
+            long long slice_begin = s * slice_frames;
+            long long slice_end = std::min(slice_begin + slice_frames, total);
+
+            // Voices that can sound here started at most `longest` before.
+            auto by_start = [](const SynthVoice& voice, long long frame) { return voice.start < frame; };
+            auto lo = std::lower_bound(voices.begin(), voices.end(), slice_begin - longest, by_start);
+            auto hi = std::lower_bound(lo, voices.end(), slice_end, by_start);
+            active.clear();
+            for (auto it = lo; it != hi; ++it) {
+                if (it->stop > slice_begin) active.push_back(&*it);
+            }
+
+            for (long long b = slice_begin; b < slice_end; b += BLOCK_FRAMES) {
+                int frames = static_cast<int>(std::min<long long>(BLOCK_FRAMES, slice_end - b));
+                std::fill(block, block + BLOCK_FRAMES, 0.0f);
+                for (const SynthVoice* voice : active) {
+                    if (voice->start >= b + frames || voice->stop <= b) continue;
+#ifdef MOOD_SYNTH_VECTOR
+                    if (simd) {
+                        renderVoiceVector(*voice, b, BLOCK_FRAMES, block, rate);
+                        continue;
+                    }
+#endif
+                    renderVoiceScalar(*voice, b, frames, block, rate);
+                }
+                std::copy(block, block + frames, out.begin() + b);
+            }
+        }
+    };
+#ifndef MOOD_SYNTH_VECTOR
+    (void)simd;
+#endif
+
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; t++) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& th : pool) {
+        th.join();
+    }
+
+    SynthStats stats;
+    stats.voices = static_cast<long long>(voices.size());
+    stats.frames = total;
+    stats.threads = threads;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - clock_start).count();
+    stats.realtime = stats.seconds > 0.0 ? (static_cast<double>(total) / rate) / stats.seconds : 0.0;
+    return stats;
+}
+
+// Scale so the loudest sample sits at -1 dBFS.
+inline void normalizePeak(std::vector<float>& samples) {
+    float peak = 0.0f;
+    for (float sample : samples) {
+        peak = std::max(peak, std::fabs(sample));
+    }
+    if (peak <= 0.0f) return;
+    float gain = 0.891f / peak;
+    for (float& sample : samples) {
+        sample *= gain;
+    }
+}
+
+// 💾 Mono PCM WAV, `bits` 16 or 24.
+inline bool writeWav(const std::string& filename, const std::vector<float>& samples, int rate, int bits) {
+    int bytes_per_sample = bits == 24 ? 3 : 2;
+    uint32_t data_size = static_cast<uint32_t>(samples.size() * bytes_per_sample);
+    std::vector<uint8_t> bytes;
+    bytes.reserve(44 + data_size);
+    auto text = [&](const char* tag) { bytes.insert(bytes.end(), tag, tag + 4); };
+    auto le = [&](uint32_t value, int size) {
+        for (int i = 0; i < size; i++) bytes.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    };
+    text("RIFF");
+    le(36 + data_size, 4);
+    text("WAVE");
+    text("fmt ");
+    le(16, 4);
+    le(1, 2);                                             // PCM
+    le(1, 2);                                             // mono
+    le(static_cast<uint32_t>(rate), 4);
+    le(static_cast<uint32_t>(rate * bytes_per_sample), 4);
+    le(static_cast<uint32_t>(bytes_per_sample), 2);
+    le(static_cast<uint32_t>(bytes_per_sample * 8), 2);
+    text("data");
+    le(data_size, 4);
+
+    double full_scale = bits == 24 ? 8388607.0 : 32767.0;
+    for (float sample : samples) {
+        double clipped = std::min(1.0, std::max(-1.0, static_cast<double>(sample)));
+        int32_t value = static_cast<int32_t>(std::lround(clipped * full_scale));
+        le(static_cast<uint32_t>(value), bytes_per_sample);
+    }
+    return writeBytes(filename, bytes);
+}
+
+// 🎼 Notes of a MIDI file, timed through its tempo map, with each note
+// taking the program last set on its channel.
+inline std::vector<SynthNote> synthNotesFromMidi(smf::MidiFile midi) {
+    midi.joinTracks();
+    midi.doTimeAnalysis();
+    midi.linkNotePairs();
+    std::vector<SynthNote> notes;
+    int programs[16] = {};
+    for (int i = 0; i < midi[0].size(); i++) {
+        const smf::MidiEvent& event = midi[0][i];
+        if (event.isPatchChange()) {
+            programs[event.getChannel()] = event.getP1();
+        } else if (event.isNoteOn() && event.isLinked()) {
+            SynthNote note;
+            note.start = event.seconds;
+            note.duration = event.getDurationInSeconds();
+            note.key = event.getKeyNumber();
+            note.velocity = event.getVelocity();
+            note.channel = event.getChannel();
+            note.program = programs[note.channel];
+            notes.push_back(note);
+        }
+    }
+    return notes;
+}
+
+// 🌊 Notes pulled from a NoteEvent source (as played by runPlayback),
+// timed through a tempo map starting at `bpm`, channel c starting on
+// programs[c].  The source must end.
+template <class Source>
+std::vector<SynthNote> synthNotesFromStream(Source next, const std::vector<int>& programs, double bpm) {
+    int channel_programs[16] = {};
+    for (size_t c = 0; c < programs.size() && c < 16; c++) {
+        channel_programs[c] = programs[c];
+    }
+    TempoMap tempo(bpm);
+    std::vector<SynthNote> notes;
+    NoteEvent event;
+    while (next(event)) {
+        int channel = event.channel & 0x0F;
+        if (event.program >= 0) channel_programs[channel] = event.program;
+        if (event.tempo > 0.0) tempo.set(event.tick, event.tempo);
+        long long on = tempo.micros(event.tick);
+        SynthNote note;
+        note.start = on / 1000000.0;
+        note.duration = (tempo.micros(event.offTick()) - on) / 1000000.0;
+        note.key = event.key;
+        note.velocity = event.velocity;
+        note.channel = channel;
+        note.program = channel_programs[channel];
+        notes.push_back(note);
+    }
+    return notes;
+}
+
+#endif // MOOD_SYNTH_H